@@ -0,0 +1,51 @@
+#include "attackmap.h"
+
+#include "bits.h"
+#include "movegen.h"
+#include "position.h"
+
+static always_inline
+void side_attack_info(struct Position pos, enum Color c, bitboard occ, struct AttackInfo *info) {
+	bitboard us = side(pos, c);
+	bitboard all = 0, twice = 0;
+
+	bitboard pawns = extract(pos, Pawn) & us;
+	bitboard east = forward(c, shift(E, pawns));
+	bitboard west = forward(c, shift(W, pawns));
+
+	info->by_type[c][Pawn] = east | west;
+	info->mobility[c][Pawn] = popcount(east & ~us) + popcount(west & ~us);
+
+	all = east | west;
+	twice = east & west;
+
+	for (enum PieceType T = Knight; T <= King; T++) {
+		bitboard pieces = extract(pos, T) & us;
+		bitboard attacks = 0;
+		unsigned mobility = 0;
+
+		while (pieces) {
+			bitboard piece = generic_attacks(T, lsb(pieces), occ);
+
+			mobility += popcount(piece & ~us);
+			twice |= all & piece;
+			all |= piece;
+			attacks |= piece;
+
+			pieces &= pieces - 1;
+		}
+
+		info->by_type[c][T] = attacks;
+		info->mobility[c][T] = mobility;
+	}
+
+	info->by_type[c][None] = all;
+	info->twice[c] = twice;
+}
+
+void attack_info(struct Position pos, struct AttackInfo *info) {
+	bitboard occ = occupied(pos);
+
+	side_attack_info(pos, WHITE, occ, info);
+	side_attack_info(pos, BLACK, occ, info);
+}
@@ -0,0 +1,23 @@
+#ifndef ATTACKMAP_H_
+#define ATTACKMAP_H_
+
+#include <stdint.h>
+
+#include "bits.h"
+#include "movegen.h"
+#include "position.h"
+
+// Attacks of both sides for evaluation, indexed by color (in the rotated
+// representation WHITE is the side to move). Entry None of `by_type` holds the
+// union of all piece types.
+struct AttackInfo {
+	bitboard by_type[2][King + 1];
+	bitboard twice[2]; // squares attacked at least twice
+
+	// attacked squares not occupied by own pieces, summed per piece type
+	uint8_t mobility[2][King + 1];
+};
+
+void attack_info(struct Position pos, struct AttackInfo *info);
+
+#endif /*ATTACKMAP_H_*/
@@ -0,0 +1,334 @@
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include "bits.h"
+#include "movegen.h"
+#include "movetext.h"
+#include "position.h"
+#include "text.h"
+#include "timer.h"
+
+// Microbenchmarks:
+// each library function over a fixed corpus of positions, repeated to give
+// the spread of ns/call, with hardware counters where perf_event_open is
+// allowed, written as JSON for comparing builds
+
+enum { CORPUS = 2048, MAX_WALK = 80, REPEATS = 31, COUNTERS = 4 };
+
+static struct State corpus[CORPUS];
+static struct MoveList corpus_moves[CORPUS];
+static char corpus_fens[CORPUS][128];
+
+// sum of the results of every call, printed so nothing is optimised away
+static uint64_t sink;
+
+static inline
+uint64_t next_random(uint64_t *seed) {
+	*seed ^= *seed >> 12, *seed ^= *seed << 25, *seed ^= *seed >> 27;
+	return *seed * 0x2545f4914f6cdd1d;
+}
+
+// positions from random walks out of the perft positions, the same for every build
+static
+void build_corpus() {
+	uint64_t seed = 0x9e3779b97f4a7c15;
+	
+	for (size_t i = 0; i < CORPUS; i++) {
+		bool ok;
+		struct State state = parse_fen(perft_positions[i % PERFT_POSITIONS], &ok, stderr);
+		size_t plies = next_random(&seed) % MAX_WALK;
+
+		for (size_t ply = 0; ply < plies; ply++) {
+			struct MoveList list = generate_moves(state.pos);
+			if (list.length == 0) break;
+
+			state = play_move(state, list.moves[next_random(&seed) % list.length]);
+		}
+
+		corpus[i] = state;
+		corpus_moves[i] = generate_moves(state.pos);
+		corpus_fens[i][generate_fen(state, corpus_fens[i])] = '\0';
+	}
+}
+
+// Each benchmark makes one pass over the corpus and returns the number of
+// calls it made.
+
+static
+size_t bench_generate_moves() {
+	for (size_t i = 0; i < CORPUS; i++)
+		sink += generate_moves(corpus[i].pos).length;
+
+	return CORPUS;
+}
+
+static
+size_t bench_generate_move_set() {
+	for (size_t i = 0; i < CORPUS; i++) {
+		struct MoveSet set = generate_move_set(corpus[i].pos);
+		sink += count_moves(&set);
+	}
+
+	return CORPUS;
+}
+
+static
+size_t bench_make_move() {
+	size_t calls = 0;
+
+	for (size_t i = 0; i < CORPUS; i++) {
+		for (size_t j = 0; j < corpus_moves[i].length; j++)
+			sink += make_move(corpus[i].pos, corpus_moves[i].moves[j]).white;
+
+		calls += corpus_moves[i].length;
+	}
+
+	return calls;
+}
+
+static
+size_t bench_enemy_checks() {
+	for (size_t i = 0; i < CORPUS; i++)
+		sink += enemy_checks(corpus[i].pos);
+
+	return CORPUS;
+}
+
+static
+size_t bench_parse_fen() {
+	for (size_t i = 0; i < CORPUS; i++) {
+		bool ok;
+		sink += parse_fen(corpus_fens[i], &ok, NULL).pos.white;
+	}
+
+	return CORPUS;
+}
+
+static
+size_t bench_generate_fen() {
+	char buffer[128];
+
+	for (size_t i = 0; i < CORPUS; i++)
+		sink += generate_fen(corpus[i], buffer);
+
+	return CORPUS;
+}
+
+static
+size_t bench_generate_san() {
+	char buffer[16];
+	size_t calls = 0;
+
+	for (size_t i = 0; i < CORPUS; i++) {
+		for (size_t j = 0; j < corpus_moves[i].length; j++)
+			sink += generate_san(corpus_moves[i].moves[j], corpus[i], buffer, true);
+
+		calls += corpus_moves[i].length;
+	}
+
+	return calls;
+}
+
+static const struct {
+	const char *name;
+	size_t (*run)();
+} benchmarks[] = {
+	{ "generate_moves",    bench_generate_moves },
+	{ "generate_move_set", bench_generate_move_set },
+	{ "make_move",         bench_make_move },
+	{ "enemy_checks",      bench_enemy_checks },
+	{ "parse_fen",         bench_parse_fen },
+	{ "generate_fen",      bench_generate_fen },
+	{ "generate_san",      bench_generate_san },
+};
+
+// Hardware counters of this thread in user space, one event each so a
+// counter the cpu lacks doesn't lose the others. fd is -1 when unavailable,
+// e.g. in containers, virtual machines or with perf_event_paranoid > 2.
+
+static const char *counter_names[COUNTERS] = { "cycles", "instructions", "branch_misses", "cache_misses" };
+static int counter_fds[COUNTERS];
+
+static
+void open_counters() {
+#ifdef __linux__
+	static const uint64_t configs[COUNTERS] = {
+		PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES,
+	};
+
+	for (int i = 0; i < COUNTERS; i++) {
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof attr);
+
+		attr.size = sizeof attr;
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = configs[i];
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+
+		counter_fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+	}
+#else
+	for (int i = 0; i < COUNTERS; i++) counter_fds[i] = -1;
+#endif
+}
+
+static
+void start_counters() {
+#ifdef __linux__
+	for (int i = 0; i < COUNTERS; i++) {
+		if (counter_fds[i] < 0) continue;
+		ioctl(counter_fds[i], PERF_EVENT_IOC_RESET, 0);
+		ioctl(counter_fds[i], PERF_EVENT_IOC_ENABLE, 0);
+	}
+#endif
+}
+
+static
+void stop_counters(double counts[COUNTERS]) {
+	for (int i = 0; i < COUNTERS; i++) {
+		uint64_t value = 0;
+		counts[i] = -1;
+
+		if (counter_fds[i] < 0) continue;
+#ifdef __linux__
+		ioctl(counter_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+#endif
+		if (read(counter_fds[i], &value, sizeof value) == sizeof value)
+			counts[i] = value;
+	}
+}
+
+static
+int compare_doubles(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+// nearest-rank percentile of sorted values
+static inline
+double percentile(const double *sorted, size_t n, unsigned p) {
+	return sorted[(n - 1) * p / 100];
+}
+
+static
+void print_json_number(FILE *file, double value) {
+	if (value < 0) fprintf(file, "null");
+	else fprintf(file, "%.4f", value);
+}
+
+static
+void run_benchmarks(FILE *json) {
+	int count = sizeof benchmarks / sizeof benchmarks[0];
+
+	fprintf(json, "{\n\t\"corpus\": %d,\n\t\"repeats\": %d,\n", CORPUS, REPEATS);
+#ifdef ABSOLUTE_COLORS
+	fprintf(json, "\t\"absolute_colors\": true,\n");
+#else
+	fprintf(json, "\t\"absolute_colors\": false,\n");
+#endif
+#ifdef GENERIC_MOVEGEN
+	fprintf(json, "\t\"generic_movegen\": true,\n");
+#else
+	fprintf(json, "\t\"generic_movegen\": false,\n");
+#endif
+	fprintf(json, "\t\"benchmarks\": [\n");
+
+	printf("function\t\t| calls\t\t| ns/call p10\t| median\t| p90\t\t| cycles\t| instructions\t"
+	       "| branch misses\t| cache misses\n");
+
+	for (int b = 0; b < count; b++) {
+		double ns[REPEATS], counts[COUNTERS][REPEATS];
+		size_t calls = benchmarks[b].run(); // warm up the caches and branch predictors
+
+		for (int r = 0; r < REPEATS; r++) {
+			double run_counts[COUNTERS];
+
+			start_counters();
+			double start = wall_time();
+			calls = benchmarks[b].run();
+			double seconds = wall_time() - start;
+			stop_counters(run_counts);
+
+			ns[r] = seconds * 1e9 / calls;
+
+			for (int i = 0; i < COUNTERS; i++)
+				counts[i][r] = (run_counts[i] < 0) ? -1 : run_counts[i] / calls;
+		}
+
+		double median[COUNTERS];
+		qsort(ns, REPEATS, sizeof ns[0], compare_doubles);
+
+		for (int i = 0; i < COUNTERS; i++) {
+			qsort(counts[i], REPEATS, sizeof counts[i][0], compare_doubles);
+			median[i] = (counts[i][0] < 0) ? -1 : percentile(counts[i], REPEATS, 50);
+		}
+
+		printf("%-18s\t| %-10zu\t| %-8.2f\t| %-8.2f\t| %-8.2f", benchmarks[b].name, calls,
+		       percentile(ns, REPEATS, 10), percentile(ns, REPEATS, 50), percentile(ns, REPEATS, 90));
+
+		for (int i = 0; i < COUNTERS; i++) {
+			if (median[i] < 0) printf("\t| -\t");
+			else printf("\t| %-8.2f", median[i]);
+		}
+
+		printf("\n");
+
+		fprintf(json, "\t\t{\n\t\t\t\"name\": \"%s\",\n\t\t\t\"calls\": %zu,\n", benchmarks[b].name, calls);
+		fprintf(json, "\t\t\t\"ns_per_call\": { \"min\": %.4f, \"p10\": %.4f, \"median\": %.4f, \"p90\": %.4f, "
+		        "\"max\": %.4f }", ns[0], percentile(ns, REPEATS, 10), percentile(ns, REPEATS, 50),
+		        percentile(ns, REPEATS, 90), ns[REPEATS - 1]);
+
+		// counters per call, the median of the runs
+		for (int i = 0; i < COUNTERS; i++) {
+			fprintf(json, ",\n\t\t\t\"%s_per_call\": ", counter_names[i]);
+			print_json_number(json, median[i]);
+		}
+
+		fprintf(json, "\n\t\t}%s\n", (b + 1 < count) ? "," : "");
+	}
+
+	fprintf(json, "\t]\n}\n");
+}
+
+int main(int argc, char **argv) {
+	// bench [output.json]
+	const char *path = (argc > 1) ? argv[1] : "bench.json";
+
+	init_bitbase();
+	build_corpus();
+	open_counters();
+
+	FILE *json = fopen(path, "w");
+
+	if (!json) {
+		perror(path);
+		return 1;
+	}
+
+	int available = 0;
+	for (int i = 0; i < COUNTERS; i++) available += counter_fds[i] >= 0;
+
+	if (available < COUNTERS)
+		fprintf(stderr, "%d of %d hardware counters available, the others are null\n", available, COUNTERS);
+
+	run_benchmarks(json);
+	printf("checksum %016llx, written to %s\n", (unsigned long long)sink, path);
+
+	fclose(json);
+	return 0;
+}
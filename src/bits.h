@@ -6,6 +6,9 @@
 #include <string.h>
 #include <x86intrin.h>
 
+// forces specialisation of functions taking compile-time constant arguments
+#define always_inline inline __attribute__((always_inline))
+
 typedef uint8_t square;
 typedef uint64_t bitboard;
 
@@ -15,6 +18,7 @@ static const bitboard AFILE = 0x0101010101010101;
 static const bitboard HFILE = 0x8080808080808080;
 static const bitboard RANK1 = 0x00000000000000ff;
 static const bitboard RANK3 = 0x0000000000ff0000;
+static const bitboard RANK7 = 0x00ff000000000000;
 static const bitboard RANK8 = 0xff00000000000000;
 
 static inline bitboard shiftN(bitboard bb) { return bb << 8; }
@@ -38,6 +42,10 @@ static inline square lsb(bitboard bb) {
 	return __builtin_ctzll(bb);
 }
 
+static inline int popcount(bitboard bb) {
+	return __builtin_popcountll(bb);
+}
+
 static inline int clz(bitboard bb) {
 	assert(bb != 0 && "bitboard cannot be zero");
 	return __builtin_clzll(bb);
@@ -89,4 +97,21 @@ static inline bitboard king_attacks(square sq) {
 	return bitbase[sq].king;
 }
 
+// the squares strictly between two squares on a line, or 0
+static inline bitboard line_between(bitboard a, bitboard b) {
+	assert(a && b && "bitboards must be populated");
+
+	square sqa = lsb(a);
+	square sqb = lsb(b);
+
+	bitboard diag = bishop_attacks(sqa, b);
+	bitboard orth = rook_attacks(sqa, b);
+
+	bitboard line = 0;
+	if (diag & b) line |= bishop_attacks(sqb, a) & diag;
+	if (orth & b) line |= rook_attacks(sqb, a) & orth;
+
+	return line;
+}
+
 #endif /*BITS_H_*/
@@ -0,0 +1,62 @@
+#ifndef BOOK_H_
+#define BOOK_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "movegen.h"
+#include "state.h"
+
+#define POLYGLOT_RANDOM_LENGTH 781
+
+// Polyglot opening books: 16-byte big-endian entries of (key, move, weight,
+// learn) sorted by key, with moves as from, to and promotion in 6+6+3 bits and
+// castling written as the king taking its own rook.
+struct BookEntry {
+	uint64_t key;
+	uint16_t move;
+	uint16_t weight;
+	uint32_t learn;
+};
+
+// Keys hash the pieces, castling rights, the en-passant file (only when a
+// pawn of the side to move stands next to the pushed pawn) and the side to
+// move with the 781 constants of the Polyglot Random64 array.
+uint64_t polyglot_key(struct State state);
+
+uint16_t encode_book_move(struct Move move, struct State state);
+// false unless the book move is legal in the state
+bool decode_book_move(uint16_t move, struct State state, struct Move *decoded);
+
+// a book mapped read-only
+struct Book {
+	const uint8_t *data;
+	size_t length; // entries
+};
+
+bool open_book(struct Book *book, const char *path, FILE *stream);
+void close_book(struct Book *book);
+
+// entries of a key, by interpolation search; returns the total number of
+// entries for the key and writes at most `max` of them
+size_t probe_book(const struct Book *book, uint64_t key, struct BookEntry *entries, size_t max);
+
+// collects weighted moves from replayed games, merged and sorted on write
+struct BookBuilder {
+	struct BookEntry *entries;
+	size_t length;
+	size_t capacity;
+};
+
+void init_book_builder(struct BookBuilder *builder);
+void free_book_builder(struct BookBuilder *builder);
+
+bool add_book_move(struct BookBuilder *builder, struct State state, struct Move move, uint16_t weight);
+
+// sums the weights of equal moves, scaling the moves of a position down
+// together when a sum exceeds 16 bits
+bool write_book(struct BookBuilder *builder, const char *path, FILE *stream);
+
+#endif /*BOOK_H_*/
@@ -0,0 +1,216 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bits.h"
+#include "book.h"
+#include "movegen.h"
+#include "movetext.h"
+#include "position.h"
+#include "state.h"
+#include "text.h"
+#include "timer.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { DEFAULT_MAX_PLIES = 40, DEFAULT_PROBES = 10000000, MAX_LINE = 4096, MAX_BOOK_MOVES = 256 };
+enum { BENCH_KEYS = 1 << 16 };
+
+// Each move of the first `max_plies` of a game is weighted 2 for a win of the
+// side playing it, 1 for a draw, else 0. Games without a result are skipped.
+static
+void build(const char *path, unsigned max_plies) {
+	static struct Game game;
+
+	struct BookBuilder builder;
+	init_book_builder(&builder);
+
+	bool ok;
+	struct State start = parse_fen(STARTPOS, &ok, stderr);
+
+	size_t games = 0;
+	double begin = wall_time();
+
+	while (read_game(stdin, &game, stderr)) {
+		if (game.result == RESULT_UNKNOWN)
+			continue;
+
+		struct State state = start;
+
+		for (size_t i = 0; i < game.length && i < max_plies; i++) {
+			uint16_t weight = (state.side_to_move == WHITE) ? game.result : 2 - game.result;
+
+			if (!add_book_move(&builder, state, game.moves[i], weight)) {
+				fprintf(stderr, "failed to allocate book entries\n");
+				free_book_builder(&builder);
+				return;
+			}
+
+			state = play_move(state, game.moves[i]);
+		}
+
+		games++;
+	}
+
+	size_t entries = builder.length;
+
+	if (write_book(&builder, path, stderr)) {
+		printf("%zu games, %zu moves, %.3fs\n", games, entries, wall_time() - begin);
+	}
+
+	free_book_builder(&builder);
+}
+
+static
+void probe(const struct Book *book, const char *fen) {
+	bool ok;
+	struct State state = parse_fen(fen, &ok, stderr);
+	if (!ok) return;
+
+	struct BookEntry entries[MAX_BOOK_MOVES];
+	uint64_t key = polyglot_key(state);
+	size_t count = probe_book(book, key, entries, MAX_BOOK_MOVES);
+
+	if (count > MAX_BOOK_MOVES) count = MAX_BOOK_MOVES;
+
+	unsigned total = 0;
+
+	for (size_t i = 0; i < count; i++)
+		total += entries[i].weight;
+
+	printf("%s; key %016llx", fen, (unsigned long long)key);
+
+	for (size_t i = 0; i < count; i++) {
+		struct Move move;
+		char buffer[16];
+
+		if (!decode_book_move(entries[i].move, state, &move))
+			continue;
+
+		buffer[generate_san(move, state, buffer, true)] = '\0';
+		printf("; %s %u (%.1f%%)", buffer, entries[i].weight, total ? 100.0 * entries[i].weight / total : 0);
+	}
+
+	printf("\n");
+}
+
+// the test keys of the Polyglot book format, after e4 d5 e5 f5 Ke2 Kf7 and
+// a4 b5 h4 b4 c4 bxc3 Ra2
+static const struct {
+	const char *fen;
+	uint64_t key;
+} test_keys[] = {
+	{ "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 0x463b96181691fc9c },
+	{ "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1", 0x823c9b50fd114196 },
+	{ "rnbqkbnr/ppp1pppp/8/3p4/4P3/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 2", 0x0756b94461c50fb0 },
+	{ "rnbqkbnr/ppp1pppp/8/3pP3/8/8/PPPP1PPP/RNBQKBNR b KQkq - 0 2", 0x662fafb965db29d4 },
+	{ "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3", 0x22a48b5a8e47ff78 },
+	{ "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR b kq - 0 3", 0x652a607ca3f242c1 },
+	{ "rnbq1bnr/ppp1pkpp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR w - - 0 4", 0x00fdd303c946bdd9 },
+	{ "rnbqkbnr/p1pppppp/8/8/PpP4P/8/1P1PPPP1/RNBQKBNR b KQkq c3 0 3", 0x3c8123ea7b067637 },
+	{ "rnbqkbnr/p1pppppp/8/8/P6P/R1p5/1P1PPPP1/1NBQKBNR b Kkq - 0 4", 0x5c3f9b829b279560 },
+};
+
+// checks the test keys, then probes keys present in the book and random
+// (missing) keys
+static
+void bench(const struct Book *book, uint64_t probes) {
+	static uint64_t keys[2][BENCH_KEYS];
+	uint64_t seed = 0x9e3779b97f4a7c15;
+
+	size_t count = sizeof test_keys / sizeof test_keys[0], matched = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		bool ok;
+		matched += polyglot_key(parse_fen(test_keys[i].fen, &ok, stderr)) == test_keys[i].key;
+	}
+
+	printf("test keys %s\n\n", (matched == count) ? "ok" : "MISMATCH");
+
+	if (book->length == 0) {
+		fprintf(stderr, "empty book\n");
+		return;
+	}
+
+	for (size_t i = 0; i < BENCH_KEYS; i++) {
+		seed ^= seed >> 12, seed ^= seed << 25, seed ^= seed >> 27;
+		uint64_t random = seed * 0x2545f4914f6cdd1d;
+
+		// the key of a random entry
+		const uint8_t *bytes = book->data + 16 * (random % book->length);
+		keys[0][i] = 0;
+
+		for (int b = 0; b < 8; b++)
+			keys[0][i] = keys[0][i] << 8 | bytes[b];
+
+		keys[1][i] = random;
+	}
+
+	printf("keys\t| probes\t| entries\t| ms\t\t| probes/s\n");
+
+	for (int miss = 0; miss < 2; miss++) {
+		struct BookEntry entries[MAX_BOOK_MOVES];
+		uint64_t found = 0;
+		double start = wall_time();
+
+		for (uint64_t i = 0; i < probes; i++)
+			found += probe_book(book, keys[miss][i % BENCH_KEYS], entries, MAX_BOOK_MOVES);
+
+		double seconds = wall_time() - start;
+
+		printf("%s\t| %llu\t| %llu\t| %-10.3f\t| %.0f\n", miss ? "random" : "book",
+		       (unsigned long long)probes, (unsigned long long)found, seconds * 1e3, probes / seconds);
+	}
+}
+
+int main(int argc, char **argv) {
+	init_bitbase();
+
+	if (argc < 3) {
+		fprintf(stderr, "usage: uchess-book build <book.bin> [max plies] < games\n"
+		                "       uchess-book probe <book.bin> [fen | -]\n"
+		                "       uchess-book bench <book.bin> [probes]\n");
+		return 1;
+	}
+
+	// uchess-book build <book.bin> [max plies], reading games from stdin
+	if (strcmp(argv[1], "build") == 0) {
+		build(argv[2], (argc > 3) ? (unsigned)atoi(argv[3]) : DEFAULT_MAX_PLIES);
+		return 0;
+	}
+
+	struct Book book;
+
+	if (!open_book(&book, argv[2], stderr))
+		return 1;
+
+	// uchess-book probe <book.bin> [fen | -], reading one fen per line from
+	// stdin for -
+	if (strcmp(argv[1], "probe") == 0) {
+		if (argc > 3 && strcmp(argv[3], "-") != 0) {
+			probe(&book, argv[3]);
+		}
+
+		else if (argc > 3) {
+			static char line[MAX_LINE];
+
+			while (fgets(line, sizeof line, stdin)) {
+				line[strcspn(line, "\r\n")] = '\0';
+				if (line[0]) probe(&book, line);
+			}
+		}
+
+		else {
+			probe(&book, STARTPOS);
+		}
+	}
+
+	// uchess-book bench <book.bin> [probes]
+	else if (strcmp(argv[1], "bench") == 0) {
+		bench(&book, (argc > 3) ? strtoull(argv[3], NULL, 10) : DEFAULT_PROBES);
+	}
+
+	close_book(&book);
+	return 0;
+}
@@ -0,0 +1,257 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "dedup.h"
+
+#include "bits.h"
+
+#include <stdlib.h>
+
+// A tag is 0 for an empty slot, else the hash with the flag bits replaced and
+// bit 2 set, so it is never 0. READY is published once the key is written,
+// MOVED freezes the slot (empty or not) while a generation is moved.
+enum { READY = 1, MOVED = 2, FLAGS = READY | MOVED, CHUNK = 4096 };
+
+enum Probe { PROBE_INSERTED, PROBE_PRESENT, PROBE_ABSENT, PROBE_MOVED };
+
+static inline
+uint64_t make_tag(uint64_t hash) {
+	return (hash & ~(uint64_t)FLAGS) | 4;
+}
+
+// keys in the table are 32-byte aligned
+static inline
+bool equal_keys(const struct Position *key, const struct Position *pos) {
+#ifdef __AVX2__
+	__m256i a = _mm256_load_si256((const __m256i *)key);
+	__m256i b = _mm256_loadu_si256((const __m256i *)pos);
+	__m256i difference = _mm256_xor_si256(a, b);
+
+	return _mm256_testz_si256(difference, difference);
+#else
+	return same_position(*key, *pos);
+#endif
+}
+
+static inline
+uint64_t wait_until_ready(uint64_t *tag, uint64_t current) {
+	while (!(current & READY)) {
+		_mm_pause();
+		current = __atomic_load_n(tag, __ATOMIC_ACQUIRE);
+	}
+
+	return current;
+}
+
+static
+struct PositionTable *new_table(size_t slots, unsigned generation) {
+	struct PositionTable *table = calloc(1, sizeof *table);
+	void *keys = NULL;
+
+	if (!table || posix_memalign(&keys, 32, slots * sizeof(struct Position)) != 0) {
+		free(table);
+		return NULL;
+	}
+
+	table->tags = calloc(slots, sizeof *table->tags);
+
+	if (!table->tags) {
+		free(keys);
+		free(table);
+		return NULL;
+	}
+
+	table->keys = keys;
+	table->mask = slots - 1;
+	table->limit = slots / 2;
+	table->generation = generation;
+	return table;
+}
+
+static
+void free_table(struct PositionTable *table) {
+	free(table->tags);
+	free(table->keys);
+	free(table);
+}
+
+bool init_position_set(struct PositionSet *set, size_t capacity) {
+	size_t slots = CHUNK;
+
+	while (slots / 2 < capacity)
+		slots *= 2;
+
+	set->first = set->table = new_table(slots, 0);
+	return set->first != NULL;
+}
+
+void free_position_set(struct PositionSet *set) {
+	for (struct PositionTable *table = set->first, *next; table; table = next) {
+		next = table->next;
+		free_table(table);
+	}
+
+	set->first = set->table = NULL;
+}
+
+// Probes from the home slot of the hash, claiming the first empty slot. Only
+// the keys moved into a new generation skip the load limit.
+static
+enum Probe probe_insert(struct PositionTable *table, const struct Position *pos, uint64_t hash, bool limited) {
+	uint64_t tag = make_tag(hash);
+
+	for (size_t i = hash & table->mask, probes = 0; probes <= table->mask; i = (i + 1) & table->mask, probes++) {
+		uint64_t current = __atomic_load_n(&table->tags[i], __ATOMIC_ACQUIRE);
+
+		if (current == 0) {
+			if (limited && __atomic_load_n(&table->count, __ATOMIC_RELAXED) >= table->limit)
+				return PROBE_MOVED;
+
+			if (__atomic_compare_exchange_n(&table->tags[i], &current, tag, false,
+			                                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+				table->keys[i] = *pos;
+				__atomic_store_n(&table->tags[i], tag | READY, __ATOMIC_RELEASE);
+				__atomic_fetch_add(&table->count, 1, __ATOMIC_RELAXED);
+				return PROBE_INSERTED;
+			}
+
+			// lost the slot, `current` is now the tag of the winner
+		}
+
+		if (current & MOVED)
+			return PROBE_MOVED;
+
+		if ((current & ~(uint64_t)FLAGS) == tag) {
+			wait_until_ready(&table->tags[i], current);
+
+			if (equal_keys(&table->keys[i], pos))
+				return PROBE_PRESENT;
+		}
+	}
+
+	return PROBE_MOVED;
+}
+
+// freezes every slot of the chunk and inserts its keys into the next generation
+static
+void move_chunk(struct PositionTable *table, size_t chunk) {
+	for (size_t i = chunk * CHUNK; i < (chunk + 1) * CHUNK; i++) {
+		uint64_t current = __atomic_load_n(&table->tags[i], __ATOMIC_ACQUIRE);
+
+		for (;;) {
+			if (current != 0 && !(current & READY))
+				current = wait_until_ready(&table->tags[i], current);
+
+			else if (__atomic_compare_exchange_n(&table->tags[i], &current, current | MOVED, true,
+			                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+				break;
+		}
+
+		if (current & READY)
+			probe_insert(table->next, &table->keys[i], hash_position(table->keys[i]), false);
+	}
+}
+
+// Moves the table into the next generation, allocated by the first thread to
+// get here, with every thread taking chunks until none are left. Returns the
+// next generation once all of it has been moved, or NULL without memory.
+static
+struct PositionTable *resize(struct PositionSet *set, struct PositionTable *table) {
+	struct PositionTable *next = __atomic_load_n(&table->next, __ATOMIC_ACQUIRE);
+
+	if (!next) {
+		struct PositionTable *created = new_table(2 * (table->mask + 1), table->generation + 1);
+
+		if (created && __atomic_compare_exchange_n(&table->next, &next, created, false,
+		                                           __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			next = created;
+
+		else if (created)
+			free_table(created);
+
+		if (!next)
+			return NULL;
+	}
+
+	size_t chunks = (table->mask + 1) / CHUNK;
+	size_t chunk;
+
+	while ((chunk = __atomic_fetch_add(&table->next_chunk, 1, __ATOMIC_RELAXED)) < chunks) {
+		move_chunk(table, chunk);
+		__atomic_fetch_add(&table->moved_chunks, 1, __ATOMIC_RELEASE);
+	}
+
+	while (__atomic_load_n(&table->moved_chunks, __ATOMIC_ACQUIRE) < chunks)
+		_mm_pause();
+
+	struct PositionTable *expected = table;
+	__atomic_compare_exchange_n(&set->table, &expected, next, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+
+	return next;
+}
+
+enum InsertResult insert_position(struct PositionSet *set, struct Position pos) {
+	uint64_t hash = hash_position(pos);
+	struct PositionTable *table = __atomic_load_n(&set->table, __ATOMIC_ACQUIRE);
+
+	for (;;) {
+		switch (probe_insert(table, &pos, hash, true)) {
+			case PROBE_INSERTED: return INSERTED;
+			case PROBE_PRESENT:  return ALREADY_PRESENT;
+			default:             break;
+		}
+
+		if (!(table = resize(set, table)))
+			return INSERT_FAILED;
+	}
+}
+
+// looks in the next generation after meeting a frozen empty slot, once the
+// move has finished
+static
+enum Probe probe_contains(struct PositionTable *table, const struct Position *pos, uint64_t hash) {
+	uint64_t tag = make_tag(hash);
+
+	for (size_t i = hash & table->mask, probes = 0; probes <= table->mask; i = (i + 1) & table->mask, probes++) {
+		uint64_t current = __atomic_load_n(&table->tags[i], __ATOMIC_ACQUIRE);
+
+		if (current == 0)
+			return PROBE_ABSENT;
+
+		if (current == MOVED)
+			return PROBE_MOVED;
+
+		if ((current & ~(uint64_t)FLAGS) == tag) {
+			wait_until_ready(&table->tags[i], current);
+
+			if (equal_keys(&table->keys[i], pos))
+				return PROBE_PRESENT;
+		}
+	}
+
+	return __atomic_load_n(&table->next, __ATOMIC_ACQUIRE) ? PROBE_MOVED : PROBE_ABSENT;
+}
+
+bool contains_position(const struct PositionSet *set, struct Position pos) {
+	uint64_t hash = hash_position(pos);
+	struct PositionTable *table = __atomic_load_n(&set->table, __ATOMIC_ACQUIRE);
+
+	for (;;) {
+		switch (probe_contains(table, &pos, hash)) {
+			case PROBE_PRESENT: return true;
+			case PROBE_ABSENT:  return false;
+			default:            break;
+		}
+
+		size_t chunks = (table->mask + 1) / CHUNK;
+
+		while (__atomic_load_n(&table->moved_chunks, __ATOMIC_ACQUIRE) < chunks)
+			_mm_pause();
+
+		table = __atomic_load_n(&table->next, __ATOMIC_ACQUIRE);
+	}
+}
+
+size_t position_set_size(const struct PositionSet *set) {
+	struct PositionTable *table = __atomic_load_n(&set->table, __ATOMIC_ACQUIRE);
+	return __atomic_load_n(&table->count, __ATOMIC_RELAXED);
+}
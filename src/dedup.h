@@ -0,0 +1,49 @@
+#ifndef DEDUP_H_
+#define DEDUP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "position.h"
+
+// One generation of the set: open addressing with linear probing, where the
+// tag of a slot is claimed by compare-and-swap before its key is written and
+// published. Once a generation fills up its slots are frozen and moved into
+// the next one, twice the size, by all the threads that try to insert.
+struct PositionTable {
+	uint64_t *tags;
+	struct Position *keys;
+	size_t mask;
+	size_t limit;      // resized past this many keys
+	size_t count;
+
+	size_t next_chunk; // chunks of slots claimed and moved to `next`
+	size_t moved_chunks;
+	struct PositionTable *next;
+	unsigned generation;
+};
+
+// Concurrent set of full 32-byte positions. Inserting is lock-free, except
+// that a thread meeting a resize helps to move the slots and then waits for
+// the other movers to finish. Old generations are only freed with the set.
+struct PositionSet {
+	struct PositionTable *first;
+	struct PositionTable *table;
+};
+
+enum InsertResult {
+	INSERT_FAILED,
+	INSERTED,
+	ALREADY_PRESENT,
+};
+
+bool init_position_set(struct PositionSet *set, size_t capacity);
+void free_position_set(struct PositionSet *set);
+
+enum InsertResult insert_position(struct PositionSet *set, struct Position pos);
+bool contains_position(const struct PositionSet *set, struct Position pos);
+
+size_t position_set_size(const struct PositionSet *set);
+
+#endif /*DEDUP_H_*/
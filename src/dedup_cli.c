@@ -0,0 +1,252 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bits.h"
+#include "dedup.h"
+#include "movegen.h"
+#include "position.h"
+#include "state.h"
+#include "text.h"
+#include "timer.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+enum { DEFAULT_DEPTH = 4, BENCH_POSITIONS = 2, MAX_THREADS = 256, MAX_LINE = 4096, INITIAL_CAPACITY = 1024 };
+
+struct Worker {
+	struct PositionSet *set;
+	const struct Position *positions;
+	bool *inserted;
+	size_t length;
+	size_t first, step;
+	bool ok;
+};
+
+static
+void *run_worker(void *arg) {
+	struct Worker *w = arg;
+
+	for (size_t i = w->first; i < w->length && w->ok; i += w->step) {
+		enum InsertResult result = insert_position(w->set, w->positions[i]);
+
+		if (w->inserted) w->inserted[i] = result == INSERTED;
+		w->ok = result != INSERT_FAILED;
+	}
+
+	return NULL;
+}
+
+// inserts every position from `threads` threads, each taking every nth one
+static
+bool insert_all(struct PositionSet *set, const struct Position *positions, bool *inserted, size_t length, unsigned threads) {
+	pthread_t handles[MAX_THREADS];
+	struct Worker workers[MAX_THREADS];
+	bool started[MAX_THREADS];
+	bool ok = true;
+
+	for (unsigned i = 0; i < threads; i++) {
+		workers[i] = (struct Worker){ set, positions, inserted, length, i, threads, true };
+
+		// without a thread of its own the share is inserted here
+		started[i] = pthread_create(&handles[i], NULL, run_worker, &workers[i]) == 0;
+		if (!started[i]) run_worker(&workers[i]);
+	}
+
+	for (unsigned i = 0; i < threads; i++) {
+		if (started[i]) pthread_join(handles[i], NULL);
+		ok &= workers[i].ok;
+	}
+
+	return ok;
+}
+
+// prints one line of each distinct position, in input order, false when out
+// of memory
+static
+bool dedup(unsigned threads) {
+	static char line[MAX_LINE];
+
+	char **lines = NULL;
+	struct Position *positions = NULL;
+	size_t length = 0, capacity = 0;
+	bool ok = true;
+
+	while (ok && fgets(line, sizeof line, stdin)) {
+		line[strcspn(line, "\r\n")] = '\0';
+
+		bool parsed;
+		struct State state = parse_fen(line, &parsed, stderr);
+		if (!line[0] || !parsed) continue;
+
+		if (length == capacity) {
+			size_t grown = capacity ? 2 * capacity : 1024;
+
+			// the old arrays stay valid, and freed below, when either fails
+			char **grown_lines = realloc(lines, grown * sizeof *lines);
+			if (grown_lines) lines = grown_lines;
+
+			struct Position *grown_positions = realloc(positions, grown * sizeof *positions);
+			if (grown_positions) positions = grown_positions;
+
+			if (!grown_lines || !grown_positions) {
+				fprintf(stderr, "failed to allocate %zu positions\n", grown);
+				ok = false;
+				break;
+			}
+
+			capacity = grown;
+		}
+
+		if (!(lines[length] = strdup(line))) {
+			fprintf(stderr, "failed to allocate line %zu\n", length + 1);
+			ok = false;
+			break;
+		}
+
+		positions[length++] = state.pos;
+	}
+
+	struct PositionSet set = {0};
+	bool *inserted = ok ? calloc(length ? length : 1, sizeof *inserted) : NULL;
+
+	// with a single thread the first of the duplicates is kept
+	if (ok && (!inserted || !init_position_set(&set, length) || !insert_all(&set, positions, inserted, length, threads))) {
+		fprintf(stderr, "failed to allocate position set\n");
+		ok = false;
+	}
+
+	for (size_t i = 0; ok && i < length; i++) {
+		if (inserted[i]) printf("%s\n", lines[i]);
+	}
+
+	for (size_t i = 0; i < length; i++)
+		free(lines[i]);
+
+	free_position_set(&set);
+	free(inserted);
+	free(positions);
+	free(lines);
+	return ok;
+}
+
+struct Collector {
+	struct Position *positions;
+	size_t length;
+	size_t capacity;
+};
+
+static
+bool collect(struct Collector *c, struct Position pos, unsigned depth) {
+	if (c->length == c->capacity) {
+		size_t capacity = c->capacity ? 2 * c->capacity : 1 << 20;
+		struct Position *positions = realloc(c->positions, capacity * sizeof *positions);
+
+		if (!positions)
+			return false;
+
+		c->positions = positions;
+		c->capacity = capacity;
+	}
+
+	c->positions[c->length++] = pos;
+
+	if (depth == 0)
+		return true;
+
+	struct MoveList list = generate_moves(pos);
+
+	for (size_t i = 0; i < list.length; i++) {
+		if (!collect(c, make_move(pos, list.moves[i]), depth - 1))
+			return false;
+	}
+
+	return true;
+}
+
+// inserts every node of the perft trees of the bench positions, transpositions
+// included, into a set starting small enough to resize several times, false
+// when out of memory
+static
+bool bench(unsigned depth, unsigned max_threads) {
+	struct Collector c = {0};
+	bool ok = true;
+
+	// the start position and kiwipete
+	for (size_t i = 0; i < BENCH_POSITIONS; i++) {
+		bool ok;
+		struct State state = parse_fen(perft_positions[i], &ok, stderr);
+
+		if (!collect(&c, state.pos, depth)) {
+			fprintf(stderr, "failed to allocate positions\n");
+			free(c.positions);
+			return false;
+		}
+	}
+
+	printf("threads\t| insertions\t| unique\t| generation\t| ms\t\t| insertions/s\n");
+
+	// doubling, with max_threads as the last row
+	for (unsigned threads = 1; threads <= max_threads;
+	     threads = (threads < max_threads && 2 * threads > max_threads) ? max_threads : 2 * threads) {
+		struct PositionSet set;
+
+		if (!init_position_set(&set, INITIAL_CAPACITY)) {
+			fprintf(stderr, "failed to allocate position set\n");
+			ok = false;
+			break;
+		}
+
+		double start = wall_time();
+		bool inserted = insert_all(&set, c.positions, NULL, c.length, threads);
+		double seconds = wall_time() - start;
+
+		if (inserted) {
+			printf("%u\t| %zu\t| %zu\t| %u\t\t| %-10.3f\t| %.0f\n", threads, c.length, position_set_size(&set),
+			       set.table->generation, seconds * 1e3, c.length / seconds);
+		}
+
+		else {
+			fprintf(stderr, "failed to allocate position set\n");
+			ok = false;
+		}
+
+		free_position_set(&set);
+	}
+
+	free(c.positions);
+	return ok;
+}
+
+int main(int argc, char **argv) {
+	init_bitbase();
+
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned default_threads = (cores > 0) ? cores : 1;
+
+	// uchess-dedup bench [depth] [max threads]
+	if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+		unsigned depth = (argc > 2) ? (unsigned)atoi(argv[2]) : DEFAULT_DEPTH;
+		unsigned threads = (argc > 3) ? (unsigned)atoi(argv[3]) : default_threads;
+
+		return !bench(depth, (threads > MAX_THREADS) ? MAX_THREADS : threads);
+	}
+
+	// uchess-dedup [threads], reading one fen per line from stdin
+	else {
+		unsigned threads = (argc > 1) ? (unsigned)atoi(argv[1]) : default_threads;
+
+		if (threads == 0 || threads > MAX_THREADS) {
+			fprintf(stderr, "usage: uchess-dedup [threads] < fens\n"
+			                "       uchess-dedup bench [depth] [max threads]\n");
+			return 1;
+		}
+
+		return !dedup(threads);
+	}
+
+	return 0;
+}
@@ -0,0 +1,344 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bits.h"
+#include "movegen.h"
+#include "movetext.h"
+#include "position.h"
+#include "search.h"
+#include "state.h"
+#include "text.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+enum { DEFAULT_HASH_MB = 16, MAX_LINE = 65536 };
+
+static struct Engine engine;
+static struct State game;
+
+static pthread_t search_thread;
+static bool searching;
+
+static struct SearchLimits limits;
+static bool infinite;
+static bool stop_requested; // accessed atomically, set by the input thread
+
+static
+void *run_search(void *arg) {
+	(void)arg;
+
+	struct SearchResult result = search(&engine, game, limits, stdout);
+
+	// in infinite mode bestmove must wait for the stop command
+	while (infinite && !__atomic_load_n(&stop_requested, __ATOMIC_ACQUIRE)) {
+		nanosleep(&(struct timespec){ .tv_nsec = 1000000 }, NULL);
+	}
+
+	char buffer[8];
+	buffer[generate_uci(result.best, game, buffer)] = '\0';
+
+	printf("bestmove %s\n", buffer);
+	fflush(stdout);
+
+	return NULL;
+}
+
+static
+void stop_search() {
+	if (!searching)
+		return;
+
+	__atomic_store_n(&stop_requested, true, __ATOMIC_RELEASE);
+	request_stop(&engine);
+
+	pthread_join(search_thread, NULL);
+	searching = false;
+
+	// the search may have returned before the request, which would stop the next one
+	__atomic_store_n(&engine.stop, false, __ATOMIC_RELAXED);
+}
+
+// plays a move in uci notation on the game, recording the position it leaves
+static
+bool play_uci_move(const char *uci) {
+	bool ok;
+	struct Move parsed = parse_uci(uci, game, &ok, stderr);
+	if (!ok) return false;
+
+	// use the generated move, so the castling flag and piece are exact
+	struct MoveList list = generate_moves(game.pos);
+
+	for (size_t i = 0; i < list.length; i++) {
+		struct Move move = list.moves[i];
+
+		if (move.start != parsed.start || move.end != parsed.end || move.piece != parsed.piece)
+			continue;
+
+		// play_move resets the clock exactly on captures and pawn moves
+		struct State next = play_move(game, move);
+		push_history(&engine, game.pos, next.fify_move_clock == 0);
+		game = next;
+
+		return true;
+	}
+
+	fprintf(stderr, "illegal move: %s\n", uci);
+	return false;
+}
+
+// position [startpos | fen <fen>] [moves <move>...]
+static
+void set_position(char *args) {
+	char *moves = strstr(args, "moves");
+	if (moves) moves[-1] = '\0', moves += strlen("moves");
+
+	const char *fen = STARTPOS;
+
+	if (strncmp(args, "fen ", 4) == 0) {
+		fen = args + 4;
+	}
+
+	bool ok;
+	struct State state = parse_fen(fen, &ok, stderr);
+	if (!ok) return;
+
+	game = state;
+	engine.history_length = 0;
+
+	if (moves == NULL)
+		return;
+
+	for (char *move = strtok(moves, " \n"); move; move = strtok(NULL, " \n")) {
+		if (!play_uci_move(move)) break;
+	}
+}
+
+// the go parameters followed by a value, anything else (ponder, or the moves
+// of searchmoves) is skipped on its own
+static const char *go_keys[] = { "wtime", "btime", "winc", "binc", "movetime", "movestogo", "depth", "nodes", "mate" };
+
+static
+bool takes_value(const char *token) {
+	for (size_t i = 0; i < sizeof go_keys / sizeof go_keys[0]; i++) {
+		if (strcmp(token, go_keys[i]) == 0) return true;
+	}
+
+	return false;
+}
+
+static
+void go(char *args) {
+	double wtime = 0, btime = 0, winc = 0, binc = 0, movetime = 0;
+	unsigned movestogo = 30;
+
+	limits = (struct SearchLimits){0};
+	infinite = false;
+
+	for (char *token = strtok(args, " \n"); token; token = strtok(NULL, " \n")) {
+		char *value = NULL;
+
+		if (strcmp(token, "infinite") == 0) {
+			infinite = true;
+			continue;
+		}
+
+		if (!takes_value(token))
+			continue;
+
+		if ((value = strtok(NULL, " \n")) == NULL)
+			break;
+
+		if      (strcmp(token, "wtime")     == 0) wtime = atof(value) / 1000;
+		else if (strcmp(token, "btime")     == 0) btime = atof(value) / 1000;
+		else if (strcmp(token, "winc")      == 0) winc = atof(value) / 1000;
+		else if (strcmp(token, "binc")      == 0) binc = atof(value) / 1000;
+		else if (strcmp(token, "movetime")  == 0) movetime = atof(value) / 1000;
+		else if (strcmp(token, "movestogo") == 0) movestogo = atoi(value);
+		else if (strcmp(token, "depth")     == 0) limits.depth = atoi(value);
+		else if (strcmp(token, "nodes")     == 0) limits.nodes = strtoull(value, NULL, 10);
+	}
+
+	double remaining = (game.side_to_move == WHITE) ? wtime : btime;
+	double increment = (game.side_to_move == WHITE) ? winc : binc;
+
+	if (movetime) {
+		limits.time = movetime;
+	}
+
+	else if (remaining) {
+		double time = remaining / (movestogo ? movestogo : 1) + 0.75 * increment;
+		limits.time = (time < 0.5 * remaining) ? time : 0.5 * remaining;
+	}
+
+	__atomic_store_n(&stop_requested, false, __ATOMIC_RELAXED);
+
+	if (pthread_create(&search_thread, NULL, run_search, NULL) != 0) {
+		fprintf(stderr, "failed to start the search thread\n");
+		return;
+	}
+
+	searching = true;
+}
+
+// setoption name <name> value <value>
+static
+void set_option(char *args) {
+	char *name = strstr(args, "name ");
+	char *value = strstr(args, "value ");
+
+	if (name == NULL || value == NULL)
+		return;
+
+	name += strlen("name ");
+	value += strlen("value ");
+
+	if (strncmp(name, "Threads", 7) == 0) {
+		unsigned threads = atoi(value);
+		engine.threads = (threads < 1) ? 1 : (threads > MAX_THREADS) ? MAX_THREADS : threads;
+	}
+
+	else if (strncmp(name, "Hash", 4) == 0) {
+		size_t hash_mb = atoi(value);
+		if (hash_mb < 1 || !resize_hash(&engine, hash_mb)) {
+			fprintf(stderr, "failed to resize hash to %zu MB\n", hash_mb);
+		}
+	}
+}
+
+static
+void uci_loop() {
+	static char line[MAX_LINE];
+
+	while (fgets(line, sizeof line, stdin)) {
+		line[strcspn(line, "\r\n")] = '\0';
+
+		char *args = strchr(line, ' ');
+		if (args) *args++ = '\0';
+		else args = line + strlen(line);
+
+		if (strcmp(line, "uci") == 0) {
+			printf("id name uchess\n");
+			printf("id author uchess contributors\n");
+			printf("option name Threads type spin default 1 min 1 max %d\n", MAX_THREADS);
+			printf("option name Hash type spin default %d min 1 max 65536\n", DEFAULT_HASH_MB);
+			printf("uciok\n");
+		}
+
+		else if (strcmp(line, "isready") == 0) {
+			printf("readyok\n");
+		}
+
+		else if (strcmp(line, "ucinewgame") == 0) {
+			stop_search();
+			clear_engine(&engine);
+		}
+
+		else if (strcmp(line, "position") == 0) {
+			stop_search();
+			set_position(args);
+		}
+
+		else if (strcmp(line, "go") == 0) {
+			stop_search();
+			go(args);
+		}
+
+		else if (strcmp(line, "stop") == 0) {
+			stop_search();
+		}
+
+		else if (strcmp(line, "setoption") == 0) {
+			stop_search();
+			set_option(args);
+		}
+
+		else if (strcmp(line, "d") == 0) {
+			char buffer[128];
+			buffer[generate_fen(game, buffer)] = '\0';
+			printf("%s\n", buffer);
+		}
+
+		else if (strcmp(line, "quit") == 0) {
+			break;
+		}
+
+		fflush(stdout);
+	}
+
+	stop_search();
+}
+
+
+// time-to-depth and nodes/sec scaling by thread count, on the perft positions
+
+static
+void bench(unsigned depth, unsigned max_threads) {
+	int count = PERFT_POSITIONS;
+	double baseline = 0;
+
+	printf("threads\t| position\t| depth\t| nodes\t\t| knps\t\t| seconds\n");
+
+	// doubling, with max_threads as the last row
+	for (unsigned threads = 1; threads <= max_threads;
+	     threads = (threads < max_threads && 2 * threads > max_threads) ? max_threads : 2 * threads) {
+		uint64_t total_nodes = 0;
+		double total_seconds = 0;
+
+		for (int i = 0; i < count; i++) {
+			bool ok;
+			struct State state = parse_fen(perft_positions[i], &ok, stderr);
+
+			clear_engine(&engine);
+			engine.threads = threads;
+
+			struct SearchResult result = search(&engine, state, (struct SearchLimits){ .depth = depth }, NULL);
+
+			printf("%u\t| %d\t\t| %u\t| %-10llu\t| %-10.0f\t| %.3f\n", threads, i + 1, result.depth,
+			       (unsigned long long)result.nodes, result.nodes / result.seconds / 1e3, result.seconds);
+
+			total_nodes += result.nodes;
+			total_seconds += result.seconds;
+		}
+
+		if (threads == 1) baseline = total_seconds;
+
+		printf("%u\t| total\t\t| %u\t| %-10llu\t| %-10.0f\t| %.3f (time-to-depth speedup %.2fx)\n\n",
+		       threads, depth, (unsigned long long)total_nodes, total_nodes / total_seconds / 1e3,
+		       total_seconds, baseline / total_seconds);
+
+		fflush(stdout);
+	}
+}
+
+int main(int argc, char **argv) {
+	init_bitbase();
+
+	if (!init_engine(&engine, DEFAULT_HASH_MB, 1)) {
+		fprintf(stderr, "failed to allocate hash table\n");
+		return 1;
+	}
+
+	bool ok;
+	game = parse_fen(STARTPOS, &ok, stderr);
+
+	// uchess-engine bench [depth] [max threads]
+	if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+		unsigned depth = (argc > 2) ? atoi(argv[2]) : 7;
+		long cores = sysconf(_SC_NPROCESSORS_ONLN);
+		unsigned max_threads = (argc > 3) ? atoi(argv[3]) : (cores > 0 ? cores : 1);
+
+		bench(depth, max_threads);
+	}
+
+	else {
+		uci_loop();
+	}
+
+	free_engine(&engine);
+	return 0;
+}
@@ -0,0 +1,457 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "explorer.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+enum { MERGE_WAYS = 64, RUN_BUFFER = 1 << 16, MAX_PATH = 4096, MIN_RECORDS = 1024 };
+
+static const char MAGIC[8] = "UCEXPL1";
+
+// native byte order, as the records of the runs
+struct ExplorerHeader {
+	char magic[8];
+	uint64_t move_count;
+	uint64_t position_count;
+	uint64_t reserved;
+};
+
+static inline
+unsigned move_key(struct Move move) {
+	return move.start | move.end << 6 | move.piece << 12 | move.castling << 15;
+}
+
+// A double push records its file even when no pawn can take en passant; keep
+// it only if the capture is legal so transpositions share one key.
+static
+struct Position explorer_key(struct Position pos) {
+	bitboard info = extract_info(pos);
+	if (!(info & EP_MASK))
+		return pos;
+
+	bitboard target = relative(turn(pos), (info & EP_MASK) << 40);
+	struct MoveList list = generate_moves(pos);
+
+	for (size_t i = 0; i < list.length; i++) {
+		struct Move move = list.moves[i];
+		if (move.piece == Pawn && (1ULL << move.end & target))
+			return pos;
+	}
+
+	bitboard occ = occupied(pos);
+	info = pdep(info & ~EP_MASK, ~occ);
+
+	return (struct Position){
+		.white = pos.white,
+		.X = (pos.X & occ) | info,
+		.Y = (pos.Y & occ) | info,
+		.Z = (pos.Z & occ) | info,
+	};
+}
+
+static inline
+int compare_records(const struct ExplorerRecord *a, const struct ExplorerRecord *b) {
+	int order = compare_positions(a->pos, b->pos);
+	return order ? order : (int)move_key(a->move) - (int)move_key(b->move);
+}
+
+static
+int compare_record_pointers(const void *a, const void *b) {
+	return compare_records(a, b);
+}
+
+static
+void run_path(const struct ExplorerBuilder *builder, size_t run, char *path) {
+	snprintf(path, MAX_PATH, "%s.run%zu", builder->path, run);
+}
+
+bool init_explorer_builder(struct ExplorerBuilder *builder, const char *path, size_t memory, FILE *stream) {
+	*builder = (struct ExplorerBuilder){
+		.path = path,
+		.stream = stream,
+		.capacity = memory / sizeof(struct ExplorerRecord),
+	};
+
+	if (builder->capacity < MIN_RECORDS)
+		builder->capacity = MIN_RECORDS;
+
+	builder->records = malloc(builder->capacity * sizeof *builder->records);
+
+	if (!builder->records) {
+		fprintf(stream, "failed to allocate %zu explorer records\n", builder->capacity);
+		return false;
+	}
+
+	return true;
+}
+
+void free_explorer_builder(struct ExplorerBuilder *builder) {
+	char path[MAX_PATH];
+
+	// runs left behind by a failed build
+	for (size_t run = builder->first_run; run < builder->runs; run++) {
+		run_path(builder, run, path);
+		remove(path);
+	}
+
+	free(builder->records);
+	*builder = (struct ExplorerBuilder){0};
+}
+
+// sorts the buffered records, sums equal ones and writes them as the next run
+static
+bool spill(struct ExplorerBuilder *builder) {
+	struct ExplorerRecord *records = builder->records;
+	size_t length = 0;
+
+	qsort(records, builder->length, sizeof *records, compare_record_pointers);
+
+	for (size_t i = 0; i < builder->length; i++) {
+		if (length > 0 && compare_records(&records[length - 1], &records[i]) == 0) {
+			records[length - 1].wins += records[i].wins;
+			records[length - 1].draws += records[i].draws;
+			records[length - 1].losses += records[i].losses;
+		}
+
+		else {
+			records[length++] = records[i];
+		}
+	}
+
+	char path[MAX_PATH];
+	run_path(builder, builder->runs, path);
+
+	FILE *file = fopen(path, "wb");
+
+	if (!file) {
+		fprintf(builder->stream, "failed to create %s\n", path);
+		return false;
+	}
+
+	bool ok = fwrite(records, sizeof *records, length, file) == length;
+	ok &= fclose(file) == 0;
+
+	builder->runs++;
+	builder->spilled += length;
+	builder->length = 0;
+
+	if (!ok) fprintf(builder->stream, "failed to write %s\n", path);
+	return ok;
+}
+
+bool add_explorer_record(struct ExplorerBuilder *builder, struct Position pos, struct Move move, unsigned result) {
+	if (builder->length == builder->capacity && !spill(builder))
+		return false;
+
+	builder->records[builder->length++] = (struct ExplorerRecord){
+		.pos = explorer_key(pos),
+		.move = move,
+		.wins = result == 2,
+		.draws = result == 1,
+		.losses = result == 0,
+	};
+
+	builder->added++;
+	return true;
+}
+
+struct RunReader {
+	FILE *file;
+	char *buffer;
+	struct ExplorerRecord record;
+};
+
+// merged records go either to another run, or to the moves of the indexed
+// file with the positions collected separately and appended at the end
+struct Merger {
+	FILE *output;
+	FILE *positions;
+
+	struct ExplorerRecord pending;
+	bool has_pending;
+
+	struct Position last;
+	uint64_t move_count;
+	uint64_t position_count;
+	bool ok;
+};
+
+static
+void flush_pending(struct Merger *merger) {
+	const struct ExplorerRecord *record = &merger->pending;
+
+	if (!merger->has_pending)
+		return;
+
+	if (!merger->positions) {
+		merger->ok &= fwrite(record, sizeof *record, 1, merger->output) == 1;
+		return;
+	}
+
+	if (merger->move_count == 0 || compare_positions(merger->last, record->pos) != 0) {
+		struct ExplorerPosition position = { .pos = record->pos, .first = merger->move_count };
+
+		merger->ok &= fwrite(&position, sizeof position, 1, merger->positions) == 1;
+		merger->last = record->pos;
+		merger->position_count++;
+	}
+
+	struct ExplorerMove move = {
+		.move = record->move,
+		.wins = record->wins,
+		.draws = record->draws,
+		.losses = record->losses,
+	};
+
+	merger->ok &= fwrite(&move, sizeof move, 1, merger->output) == 1;
+	merger->move_count++;
+}
+
+static
+void emit(struct Merger *merger, const struct ExplorerRecord *record) {
+	if (merger->has_pending && compare_records(&merger->pending, record) == 0) {
+		merger->pending.wins += record->wins;
+		merger->pending.draws += record->draws;
+		merger->pending.losses += record->losses;
+		return;
+	}
+
+	flush_pending(merger);
+	merger->pending = *record;
+	merger->has_pending = true;
+}
+
+static inline
+bool read_record(struct RunReader *reader) {
+	return fread(&reader->record, sizeof reader->record, 1, reader->file) == 1;
+}
+
+static
+void sift_down(struct RunReader **heap, size_t length, size_t i) {
+	for (;;) {
+		size_t least = i, left = 2*i + 1, right = 2*i + 2;
+
+		if (left < length && compare_records(&heap[left]->record, &heap[least]->record) < 0) least = left;
+		if (right < length && compare_records(&heap[right]->record, &heap[least]->record) < 0) least = right;
+		if (least == i) return;
+
+		struct RunReader *swap = heap[i];
+		heap[i] = heap[least];
+		heap[least] = swap;
+		i = least;
+	}
+}
+
+// k-way merge of the runs [first, first + count) through a binary heap of
+// their next records, removing the runs afterwards
+static
+bool merge_runs(struct ExplorerBuilder *builder, size_t first, size_t count, struct Merger *merger) {
+	struct RunReader readers[MERGE_WAYS] = {0};
+	struct RunReader *heap[MERGE_WAYS];
+	size_t length = 0;
+	char path[MAX_PATH];
+
+	for (size_t i = 0; i < count && merger->ok; i++) {
+		run_path(builder, first + i, path);
+
+		readers[i].file = fopen(path, "rb");
+		readers[i].buffer = malloc(RUN_BUFFER);
+
+		if (!readers[i].file || !readers[i].buffer) {
+			fprintf(builder->stream, "failed to open %s\n", path);
+			merger->ok = false;
+			break;
+		}
+
+		setvbuf(readers[i].file, readers[i].buffer, _IOFBF, RUN_BUFFER);
+
+		if (read_record(&readers[i]))
+			heap[length++] = &readers[i];
+	}
+
+	for (size_t i = length / 2; i-- > 0;)
+		sift_down(heap, length, i);
+
+	while (length > 0 && merger->ok) {
+		emit(merger, &heap[0]->record);
+
+		if (!read_record(heap[0]))
+			heap[0] = heap[--length];
+
+		sift_down(heap, length, 0);
+	}
+
+	flush_pending(merger);
+	merger->has_pending = false;
+
+	for (size_t i = 0; i < count; i++) {
+		if (readers[i].file) fclose(readers[i].file);
+		free(readers[i].buffer);
+
+		run_path(builder, first + i, path);
+		remove(path);
+	}
+
+	builder->first_run += count;
+	return merger->ok;
+}
+
+static
+bool append_file(FILE *output, FILE *input) {
+	char buffer[RUN_BUFFER];
+	size_t length;
+
+	rewind(input);
+
+	while ((length = fread(buffer, 1, sizeof buffer, input)) > 0) {
+		if (fwrite(buffer, 1, length, output) != length)
+			return false;
+	}
+
+	return !ferror(input);
+}
+
+bool finish_explorer(struct ExplorerBuilder *builder) {
+	if (builder->length > 0 && !spill(builder))
+		return false;
+
+	// the buffer is not needed any more
+	free(builder->records);
+	builder->records = NULL;
+	builder->capacity = 0;
+
+	// intermediate passes while there are too many runs to open together
+	while (builder->runs - builder->first_run > MERGE_WAYS) {
+		char path[MAX_PATH];
+		run_path(builder, builder->runs, path);
+
+		struct Merger merger = { .output = fopen(path, "wb"), .ok = true };
+
+		if (!merger.output) {
+			fprintf(builder->stream, "failed to create %s\n", path);
+			return false;
+		}
+
+		builder->runs++;
+
+		bool ok = merge_runs(builder, builder->first_run, MERGE_WAYS, &merger);
+		ok &= fclose(merger.output) == 0;
+
+		if (!ok) {
+			fprintf(builder->stream, "failed to merge into %s\n", path);
+			return false;
+		}
+	}
+
+	struct Merger merger = {
+		.output = fopen(builder->path, "wb"),
+		.positions = tmpfile(),
+		.ok = true,
+	};
+
+	if (!merger.output || !merger.positions) {
+		fprintf(builder->stream, "failed to create %s\n", builder->path);
+		if (merger.output) fclose(merger.output);
+		if (merger.positions) fclose(merger.positions);
+		return false;
+	}
+
+	struct ExplorerHeader header = {0};
+	merger.ok &= fwrite(&header, sizeof header, 1, merger.output) == 1;
+	merger.ok &= merge_runs(builder, builder->first_run, builder->runs - builder->first_run, &merger);
+
+	// the sentinel ends the continuations of the last position
+	struct ExplorerPosition sentinel = { .first = merger.move_count };
+	merger.ok &= fwrite(&sentinel, sizeof sentinel, 1, merger.positions) == 1;
+	merger.ok &= append_file(merger.output, merger.positions);
+
+	memcpy(header.magic, MAGIC, sizeof MAGIC);
+	header.move_count = merger.move_count;
+	header.position_count = merger.position_count;
+
+	rewind(merger.output);
+	merger.ok &= fwrite(&header, sizeof header, 1, merger.output) == 1;
+	merger.ok &= fclose(merger.output) == 0;
+	fclose(merger.positions);
+
+	if (!merger.ok) fprintf(builder->stream, "failed to write %s\n", builder->path);
+	return merger.ok;
+}
+
+bool open_explorer(struct Explorer *explorer, const char *path, FILE *stream) {
+	*explorer = (struct Explorer){0};
+
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		fprintf(stream, "failed to open %s\n", path);
+		if (fd >= 0) close(fd);
+		return false;
+	}
+
+	struct ExplorerHeader header;
+	bool ok = (size_t)st.st_size >= sizeof header && pread(fd, &header, sizeof header, 0) == sizeof header
+	       && memcmp(header.magic, MAGIC, sizeof MAGIC) == 0
+	       && (size_t)st.st_size == sizeof header + header.move_count * sizeof(struct ExplorerMove)
+	                                + (header.position_count + 1) * sizeof(struct ExplorerPosition);
+
+	if (!ok) {
+		fprintf(stream, "%s is not an explorer file\n", path);
+		close(fd);
+		return false;
+	}
+
+	void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+	// the mapping stays valid without the descriptor
+	close(fd);
+
+	if (data == MAP_FAILED) {
+		fprintf(stream, "failed to map %s\n", path);
+		return false;
+	}
+
+	const char *bytes = data;
+
+	explorer->data = data;
+	explorer->size = st.st_size;
+	explorer->moves = (const struct ExplorerMove *)(bytes + sizeof header);
+	explorer->positions = (const struct ExplorerPosition *)(explorer->moves + header.move_count);
+	explorer->move_count = header.move_count;
+	explorer->position_count = header.position_count;
+	return true;
+}
+
+void close_explorer(struct Explorer *explorer) {
+	if (explorer->data)
+		munmap((void *)explorer->data, explorer->size);
+
+	*explorer = (struct Explorer){0};
+}
+
+size_t probe_explorer(const struct Explorer *explorer, struct Position pos, const struct ExplorerMove **moves) {
+	size_t lo = 0, hi = explorer->position_count;
+	pos = explorer_key(pos);
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		int order = compare_positions(explorer->positions[mid].pos, pos);
+
+		if (order == 0) {
+			*moves = explorer->moves + explorer->positions[mid].first;
+			return explorer->positions[mid + 1].first - explorer->positions[mid].first;
+		}
+
+		if (order < 0) lo = mid + 1;
+		else           hi = mid;
+	}
+
+	*moves = NULL;
+	return 0;
+}
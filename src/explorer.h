@@ -0,0 +1,78 @@
+#ifndef EXPLORER_H_
+#define EXPLORER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "movegen.h"
+#include "position.h"
+
+// Opening explorer: win/draw/loss counts of the side playing each move, per
+// position, keyed by the 32-byte position. In the rotated representation a
+// position and its color flipped mirror share one key, and so their counts.
+// The en-passant file is part of the key only when the capture is legal.
+struct ExplorerRecord {
+	struct Position pos;
+	struct Move move;
+	uint32_t wins, draws, losses;
+};
+
+// Records are collected in memory up to a budget, then sorted, merged and
+// spilled as a run next to the output. Finishing merges the runs (in several
+// passes when there are too many to open at once) into one indexed file.
+struct ExplorerBuilder {
+	const char *path;
+	FILE *stream;
+
+	struct ExplorerRecord *records;
+	size_t length;
+	size_t capacity;
+
+	size_t first_run; // runs still to merge are [first_run, runs)
+	size_t runs;
+
+	uint64_t added;
+	uint64_t spilled;
+};
+
+bool init_explorer_builder(struct ExplorerBuilder *builder, const char *path, size_t memory, FILE *stream);
+void free_explorer_builder(struct ExplorerBuilder *builder);
+
+// `result` is 2 for a win of the side to move, 1 for a draw and 0 for a loss
+bool add_explorer_record(struct ExplorerBuilder *builder, struct Position pos, struct Move move, unsigned result);
+bool finish_explorer(struct ExplorerBuilder *builder);
+
+// The indexed file: a header, the continuations of all positions, then the
+// sorted positions with the index of their first continuation, ended by a
+// sentinel holding the total.
+struct ExplorerMove {
+	struct Move move;
+	uint32_t wins, draws, losses;
+};
+
+struct ExplorerPosition {
+	struct Position pos;
+	uint64_t first;
+};
+
+// an explorer file mapped read-only
+struct Explorer {
+	const void *data;
+	size_t size;
+
+	const struct ExplorerMove *moves;
+	const struct ExplorerPosition *positions;
+	uint64_t move_count;
+	uint64_t position_count;
+};
+
+bool open_explorer(struct Explorer *explorer, const char *path, FILE *stream);
+void close_explorer(struct Explorer *explorer);
+
+// continuations of a position, by binary search; returns their number and
+// points `moves` into the mapping
+size_t probe_explorer(const struct Explorer *explorer, struct Position pos, const struct ExplorerMove **moves);
+
+#endif /*EXPLORER_H_*/
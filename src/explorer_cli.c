@@ -0,0 +1,204 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bits.h"
+#include "explorer.h"
+#include "movegen.h"
+#include "movetext.h"
+#include "position.h"
+#include "state.h"
+#include "text.h"
+#include "timer.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+enum { DEFAULT_MEMORY = 256, DEFAULT_MAX_PLIES = 40, DEFAULT_PROBES = 10000000, MAX_LINE = 4096 };
+enum { BENCH_POSITIONS = 1 << 16 };
+
+// in MiB, ru_maxrss is in KiB on linux
+static
+double peak_memory() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss / 1024.0;
+}
+
+// Records every move of the first `max_plies` of each game with a result,
+// spilling runs of at most `memory` MiB.
+static
+void build(const char *path, size_t memory, unsigned max_plies) {
+	static struct Game game;
+
+	struct ExplorerBuilder builder;
+
+	if (!init_explorer_builder(&builder, path, memory << 20, stderr)) {
+		free_explorer_builder(&builder);
+		return;
+	}
+
+	bool ok;
+	struct State start = parse_fen(STARTPOS, &ok, stderr);
+
+	size_t games = 0;
+	double begin = wall_time();
+
+	while (ok && read_game(stdin, &game, stderr)) {
+		if (game.result == RESULT_UNKNOWN)
+			continue;
+
+		struct State state = start;
+
+		for (size_t i = 0; i < game.length && i < max_plies && ok; i++) {
+			unsigned result = (state.side_to_move == WHITE) ? game.result : 2 - game.result;
+
+			ok = add_explorer_record(&builder, state.pos, game.moves[i], result);
+			state = play_move(state, game.moves[i]);
+		}
+
+		games++;
+	}
+
+	double merge = wall_time();
+	uint64_t added = builder.added;
+
+	ok = ok && finish_explorer(&builder);
+
+	double end = wall_time();
+
+	if (ok) {
+		struct Explorer explorer;
+
+		if (open_explorer(&explorer, path, stderr)) {
+			printf("%zu games, %llu records, %zu runs, %llu spilled\n", games, (unsigned long long)added,
+			       builder.runs, (unsigned long long)builder.spilled);
+			printf("%llu positions, %llu moves, %.1f MiB\n", (unsigned long long)explorer.position_count,
+			       (unsigned long long)explorer.move_count, explorer.size / 1048576.0);
+			printf("collect %.3fs (%.0f records/s), merge %.3fs (%.0f records/s), peak memory %.1f MiB\n",
+			       merge - begin, added / (merge - begin), end - merge, builder.spilled / (end - merge),
+			       peak_memory());
+
+			close_explorer(&explorer);
+		}
+	}
+
+	free_explorer_builder(&builder);
+}
+
+static
+void probe(const struct Explorer *explorer, const char *fen) {
+	bool ok;
+	struct State state = parse_fen(fen, &ok, stderr);
+	if (!ok) return;
+
+	const struct ExplorerMove *moves;
+	size_t count = probe_explorer(explorer, state.pos, &moves);
+
+	printf("%s", fen);
+
+	for (size_t i = 0; i < count; i++) {
+		char buffer[16];
+		double games = (double)moves[i].wins + moves[i].draws + moves[i].losses;
+
+		buffer[generate_san(moves[i].move, state, buffer, true)] = '\0';
+		printf("; %s %.0f (+%.1f%% =%.1f%% -%.1f%%)", buffer, games, 100 * moves[i].wins / games,
+		       100 * moves[i].draws / games, 100 * moves[i].losses / games);
+	}
+
+	printf("\n");
+}
+
+// probes positions present in the file and random (missing) positions
+static
+void bench(const struct Explorer *explorer, uint64_t probes) {
+	static struct Position positions[2][BENCH_POSITIONS];
+	uint64_t seed = 0x9e3779b97f4a7c15;
+
+	if (explorer->position_count == 0) {
+		fprintf(stderr, "empty explorer\n");
+		return;
+	}
+
+	for (size_t i = 0; i < BENCH_POSITIONS; i++) {
+		seed ^= seed >> 12, seed ^= seed << 25, seed ^= seed >> 27;
+		uint64_t random = seed * 0x2545f4914f6cdd1d;
+
+		positions[0][i] = explorer->positions[random % explorer->position_count].pos;
+		positions[1][i] = positions[0][i];
+		positions[1][i].white ^= random;
+	}
+
+	printf("positions\t| probes\t| moves\t\t| ms\t\t| probes/s\n");
+
+	for (int miss = 0; miss < 2; miss++) {
+		uint64_t found = 0;
+		double start = wall_time();
+
+		for (uint64_t i = 0; i < probes; i++) {
+			const struct ExplorerMove *moves;
+			found += probe_explorer(explorer, positions[miss][i % BENCH_POSITIONS], &moves);
+		}
+
+		double seconds = wall_time() - start;
+
+		printf("%s\t| %llu\t| %llu\t| %-10.3f\t| %.0f\n", miss ? "random\t" : "explorer",
+		       (unsigned long long)probes, (unsigned long long)found, seconds * 1e3, probes / seconds);
+	}
+
+	printf("peak memory %.1f MiB\n", peak_memory());
+}
+
+int main(int argc, char **argv) {
+	init_bitbase();
+
+	if (argc < 3) {
+		fprintf(stderr, "usage: uchess-explorer build <explorer.bin> [memory MiB] [max plies] < games\n"
+		                "       uchess-explorer probe <explorer.bin> [fen | -]\n"
+		                "       uchess-explorer bench <explorer.bin> [probes]\n");
+		return 1;
+	}
+
+	// uchess-explorer build <explorer.bin> [memory MiB] [max plies], reading
+	// games from stdin
+	if (strcmp(argv[1], "build") == 0) {
+		build(argv[2], (argc > 3) ? strtoull(argv[3], NULL, 10) : DEFAULT_MEMORY,
+		      (argc > 4) ? (unsigned)atoi(argv[4]) : DEFAULT_MAX_PLIES);
+		return 0;
+	}
+
+	struct Explorer explorer;
+
+	if (!open_explorer(&explorer, argv[2], stderr))
+		return 1;
+
+	// uchess-explorer probe <explorer.bin> [fen | -], reading one fen per line
+	// from stdin for -
+	if (strcmp(argv[1], "probe") == 0) {
+		if (argc > 3 && strcmp(argv[3], "-") != 0) {
+			probe(&explorer, argv[3]);
+		}
+
+		else if (argc > 3) {
+			static char line[MAX_LINE];
+
+			while (fgets(line, sizeof line, stdin)) {
+				line[strcspn(line, "\r\n")] = '\0';
+				if (line[0]) probe(&explorer, line);
+			}
+		}
+
+		else {
+			probe(&explorer, STARTPOS);
+		}
+	}
+
+	// uchess-explorer bench <explorer.bin> [probes]
+	else if (strcmp(argv[1], "bench") == 0) {
+		bench(&explorer, (argc > 3) ? strtoull(argv[3], NULL, 10) : DEFAULT_PROBES);
+	}
+
+	close_explorer(&explorer);
+	return 0;
+}
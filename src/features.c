@@ -0,0 +1,133 @@
+#include "features.h"
+
+#include "bits.h"
+
+#include <string.h>
+
+void encode_planes(const struct Position *positions, size_t length, bitboard *planes) {
+	for (size_t i = 0; i < length; i++)
+		piece_planes(positions[i], planes + PLANES * i);
+}
+
+// 64 bytes of 0 and 1 from the bits of a plane
+static inline
+void expand_bytes(bitboard plane, uint8_t *bytes) {
+#if defined(__AVX512BW__)
+	_mm512_storeu_si512((void *)bytes, _mm512_maskz_set1_epi8(plane, 1));
+#elif defined(__AVX2__)
+	// each byte takes the byte of the plane holding its bit, then tests it
+	const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+	                                        2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+	const __m256i bits = _mm256_set1_epi64x(0x8040201008040201);
+
+	for (int half = 0; half < 2; half++) {
+		__m256i v = _mm256_shuffle_epi8(_mm256_set1_epi32((uint32_t)(plane >> 32 * half)), spread);
+		__m256i set = _mm256_cmpeq_epi8(_mm256_and_si256(v, bits), bits);
+		_mm256_storeu_si256((__m256i *)(bytes + 32 * half), _mm256_and_si256(set, _mm256_set1_epi8(1)));
+	}
+#else
+	for (int sq = 0; sq < 64; sq++)
+		bytes[sq] = (plane >> sq) & 1;
+#endif
+}
+
+// 64 floats of 0 and 1 from the bits of a plane
+static inline
+void expand_floats(bitboard plane, float *floats) {
+#if defined(__AVX512F__)
+	for (int i = 0; i < 4; i++)
+		_mm512_storeu_ps(floats + 16 * i, _mm512_maskz_mov_ps((__mmask16)(plane >> 16 * i), _mm512_set1_ps(1)));
+#elif defined(__AVX2__)
+	const __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+
+	for (int i = 0; i < 8; i++) {
+		__m256i v = _mm256_and_si256(_mm256_set1_epi32((uint32_t)(plane >> 8 * i)), bits);
+		__m256i set = _mm256_cmpeq_epi32(v, bits);
+		_mm256_storeu_ps(floats + 8 * i, _mm256_and_ps(_mm256_castsi256_ps(set), _mm256_set1_ps(1)));
+	}
+#else
+	for (int sq = 0; sq < 64; sq++)
+		floats[sq] = (plane >> sq) & 1;
+#endif
+}
+
+void encode_plane_bytes(const struct Position *positions, size_t length, uint8_t *bytes) {
+	for (size_t i = 0; i < length; i++) {
+		bitboard planes[PLANES];
+		piece_planes(positions[i], planes);
+
+		for (int p = 0; p < PLANES; p++)
+			expand_bytes(planes[p], bytes + DENSE_INPUTS * i + 64 * p);
+	}
+}
+
+void encode_plane_floats(const struct Position *positions, size_t length, float *floats) {
+	for (size_t i = 0; i < length; i++) {
+		bitboard planes[PLANES];
+		piece_planes(positions[i], planes);
+
+		for (int p = 0; p < PLANES; p++)
+			expand_floats(planes[p], floats + DENSE_INPUTS * i + 64 * p);
+	}
+}
+
+// appends the inputs base + sq of the squares of `bb`, up to the limit
+static inline
+size_t append_squares(uint16_t *features, size_t length, bitboard bb, unsigned base) {
+	size_t count = popcount(bb);
+
+	if (count > MAX_HALFKP_ACTIVE - length)
+		count = MAX_HALFKP_ACTIVE - length;
+
+#if defined(__AVX512VBMI2__) && defined(__AVX512BW__)
+	// the squares of the set bits, compressed into the low bytes
+	const __m512i iota = _mm512_set_epi8(
+		63, 62, 61, 60, 59, 58, 57, 56, 55, 54, 53, 52, 51, 50, 49, 48,
+		47, 46, 45, 44, 43, 42, 41, 40, 39, 38, 37, 36, 35, 34, 33, 32,
+		31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16,
+		15, 14, 13, 12, 11, 10,  9,  8,  7,  6,  5,  4,  3,  2,  1,  0);
+
+	__m512i squares = _mm512_maskz_compress_epi8(bb, iota);
+	__m512i inputs = _mm512_add_epi16(_mm512_cvtepu8_epi16(_mm512_castsi512_si256(squares)), _mm512_set1_epi16(base));
+
+	_mm512_mask_storeu_epi16(features + length, (__mmask32)((1ULL << count) - 1), inputs);
+#else
+	for (size_t i = 0; i < count; i++, bb &= bb - 1)
+		features[length + i] = base + lsb(bb);
+#endif
+
+	return length + count;
+}
+
+size_t halfkp_features(struct Position pos, enum Perspective p, uint16_t *features) {
+	bitboard planes[PLANES];
+	piece_planes(pos, planes);
+
+	// from the other side, its pieces come first and the ranks flip
+	if (p == THEIRS) {
+		for (int i = 0; i < 6; i++) {
+			bitboard ours = planes[i];
+			planes[i] = rotate(planes[6 + i]);
+			planes[6 + i] = rotate(ours);
+		}
+	}
+
+	square king = lsb(planes[King - Pawn]);
+	size_t length = 0;
+
+	for (enum PieceType T = Pawn; T <= Queen; T++) {
+		length = append_squares(features, length, planes[T - Pawn], halfkp_index(king, T, false, 0));
+		length = append_squares(features, length, planes[6 + T - Pawn], halfkp_index(king, T, true, 0));
+	}
+
+	return length;
+}
+
+void encode_halfkp(const struct Position *positions, size_t length, uint16_t *features) {
+	memset(features, 0, length * 2 * MAX_HALFKP_ACTIVE * sizeof *features);
+
+	for (size_t i = 0; i < length; i++) {
+		halfkp_features(positions[i], OURS, features + 2 * MAX_HALFKP_ACTIVE * i);
+		halfkp_features(positions[i], THEIRS, features + 2 * MAX_HALFKP_ACTIVE * i + MAX_HALFKP_ACTIVE);
+	}
+}
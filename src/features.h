@@ -0,0 +1,47 @@
+#ifndef FEATURES_H_
+#define FEATURES_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "position.h"
+
+// Dense inputs: 12 one-hot planes of 64 squares, our pawns to kings then
+// theirs, where ours is the side to move (white with ABSOLUTE_COLORS) and
+// squares are as stored.
+enum { PLANES = 12, DENSE_INPUTS = 64 * PLANES };
+
+// The planes as 12 bitboards, or as 768 bytes or floats of 0 and 1, per
+// position in a row of the caller's buffer.
+void encode_planes(const struct Position *positions, size_t length, bitboard *planes);
+void encode_plane_bytes(const struct Position *positions, size_t length, uint8_t *bytes);
+void encode_plane_floats(const struct Position *positions, size_t length, float *floats);
+
+// HalfKP inputs, laid out as in Stockfish: for the king square of each
+// perspective, one input per square of each piece other than the kings, ours
+// and theirs interleaved by type, after an unused input 0. The perspective
+// of the other side flips the ranks (sq ^ 56), as the board itself does.
+enum {
+	HALFKP_PIECES = 10,
+	HALFKP_KING_INPUTS = 64 * HALFKP_PIECES + 1,
+	HALFKP_INPUTS = 64 * HALFKP_KING_INPUTS,
+	MAX_HALFKP_ACTIVE = 32,
+};
+
+// our perspective and theirs
+enum Perspective { OURS, THEIRS };
+
+static inline unsigned halfkp_index(square king, enum PieceType T, bool theirs, square sq) {
+	return HALFKP_KING_INPUTS * king + 1 + 64 * (2 * (T - Pawn) + theirs) + sq;
+}
+
+// The active inputs of one perspective, in ascending order, for positions of
+// at most 32 pieces. Returns their number.
+size_t halfkp_features(struct Position pos, enum Perspective p, uint16_t *features);
+
+// per position a row of MAX_HALFKP_ACTIVE inputs for each perspective,
+// padded with the unused input 0
+void encode_halfkp(const struct Position *positions, size_t length, uint16_t *features);
+
+#endif /*FEATURES_H_*/
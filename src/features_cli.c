@@ -0,0 +1,274 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bits.h"
+#include "features.h"
+#include "position.h"
+#include "sort.h"
+#include "state.h"
+#include "text.h"
+#include "timer.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { BATCH = 4096 };
+
+enum Encoding { BITS, BYTES, FLOATS, HALFKP, ENCODINGS };
+
+static const char *ENCODING_NAMES[] = { "bits", "bytes", "floats", "halfkp" };
+
+// bytes per position of each encoding
+static const size_t ROW_SIZE[] = {
+	PLANES * sizeof(bitboard),
+	DENSE_INPUTS,
+	DENSE_INPUTS * sizeof(float),
+	2 * MAX_HALFKP_ACTIVE * sizeof(uint16_t),
+};
+
+static
+void encode(enum Encoding encoding, const struct Position *positions, size_t length, void *buffer) {
+	switch (encoding) {
+		case BITS:   encode_planes(positions, length, buffer); break;
+		case BYTES:  encode_plane_bytes(positions, length, buffer); break;
+		case FLOATS: encode_plane_floats(positions, length, buffer); break;
+		default:     encode_halfkp(positions, length, buffer); break;
+	}
+}
+
+// the planes with one get_piece per square, to compare against
+static
+void encode_naive(const struct Position *positions, size_t length, uint8_t *bytes) {
+	memset(bytes, 0, length * DENSE_INPUTS);
+
+	for (size_t i = 0; i < length; i++) {
+		for (square sq = 0; sq < 64; sq++) {
+			enum PieceType T = get_piece(positions[i], sq);
+			bool theirs = !((positions[i].white >> sq) & 1);
+
+			if (T != None && T != Info)
+				bytes[DENSE_INPUTS * i + 64 * (6 * theirs + T - Pawn) + sq] = 1;
+		}
+	}
+}
+
+// the inputs of one perspective with one get_piece per square, sorted
+static
+void naive_halfkp(struct Position pos, enum Perspective p, uint16_t *features) {
+	size_t length = 0;
+	square king = 0;
+
+	for (square sq = 0; sq < 64; sq++) {
+		bool theirs = !((pos.white >> sq) & 1) ^ (p == THEIRS);
+
+		if (get_piece(pos, sq) == King && !theirs)
+			king = (p == THEIRS) ? sq ^ 56 : sq;
+	}
+
+	for (square sq = 0; sq < 64; sq++) {
+		enum PieceType T = get_piece(pos, sq);
+		bool theirs = !((pos.white >> sq) & 1) ^ (p == THEIRS);
+
+		if (T == None || T == King || T == Info)
+			continue;
+
+		uint16_t input = halfkp_index(king, T, theirs, (p == THEIRS) ? sq ^ 56 : sq);
+		size_t j = length++;
+
+		for (; j > 0 && features[j - 1] > input; j--)
+			features[j] = features[j - 1];
+
+		features[j] = input;
+	}
+}
+
+// whether every encoding agrees with the naive planes
+static
+bool check(const struct Position *positions, size_t length, const uint8_t *expected, const void *buffer, enum Encoding encoding) {
+	for (size_t i = 0; i < length; i++) {
+		const uint8_t *row = expected + DENSE_INPUTS * i;
+
+		for (int input = 0; input < DENSE_INPUTS; input++) {
+			bool set = (encoding == BITS)  ? (((const bitboard *)buffer)[PLANES * i + input / 64] >> (input % 64)) & 1
+			         : (encoding == BYTES) ? ((const uint8_t *)buffer)[DENSE_INPUTS * i + input]
+			         : (encoding == FLOATS) ? ((const float *)buffer)[DENSE_INPUTS * i + input] == 1
+			         : row[input];
+
+			if (set != row[input])
+				return false;
+		}
+
+		if (encoding != HALFKP)
+			continue;
+
+		const uint16_t *features = (const uint16_t *)buffer + 2 * MAX_HALFKP_ACTIVE * i;
+
+		for (enum Perspective p = OURS; p <= THEIRS; p++) {
+			uint16_t naive[MAX_HALFKP_ACTIVE] = {0};
+			naive_halfkp(positions[i], p, naive);
+
+			if (memcmp(naive, features + MAX_HALFKP_ACTIVE * p, sizeof naive) != 0)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+static
+void show(const char *fen) {
+	bool ok;
+	struct State state = parse_fen(fen, &ok, stderr);
+	if (!ok) return;
+
+	bitboard planes[PLANES];
+	encode_planes(&state.pos, 1, planes);
+
+	for (int p = 0; p < PLANES; p++)
+		printf("plane %2d: %016llx\n", p, (unsigned long long)planes[p]);
+
+	for (enum Perspective p = OURS; p <= THEIRS; p++) {
+		uint16_t features[MAX_HALFKP_ACTIVE];
+		size_t length = halfkp_features(state.pos, p, features);
+
+		printf("%s:", (p == OURS) ? "ours" : "theirs");
+
+		for (size_t i = 0; i < length; i++)
+			printf(" %u", features[i]);
+
+		printf("\n");
+	}
+}
+
+static
+void export(const char *positions, const char *output, enum Encoding encoding) {
+	struct PositionFile file;
+
+	if (!open_position_file(&file, positions, stderr))
+		return;
+
+	FILE *out = fopen(output, "wb");
+	void *buffer = malloc(BATCH * ROW_SIZE[encoding]);
+	bool ok = out && buffer;
+
+	double start = wall_time();
+
+	for (size_t i = 0; i < file.length && ok; i += BATCH) {
+		size_t length = (file.length - i < BATCH) ? file.length - i : BATCH;
+
+		encode(encoding, file.positions + i, length, buffer);
+		ok = fwrite(buffer, ROW_SIZE[encoding], length, out) == length;
+	}
+
+	if (out && fclose(out) != 0) ok = false;
+
+	double seconds = wall_time() - start;
+
+	if (ok) {
+		printf("%zu positions, %.3fs, %.0f positions/s\n", file.length, seconds, file.length / seconds);
+	}
+
+	else {
+		fprintf(stderr, "failed to write %s\n", output);
+	}
+
+	free(buffer);
+	close_position_file(&file);
+}
+
+// every encoding in batches that stay in cache, against the naive planes
+static
+void bench(const char *path) {
+	struct PositionFile file;
+
+	if (!open_position_file(&file, path, stderr))
+		return;
+
+	uint8_t *expected = malloc(BATCH * DENSE_INPUTS);
+	void *buffer = malloc(BATCH * ROW_SIZE[FLOATS]);
+
+	if (!expected || !buffer) {
+		fprintf(stderr, "failed to allocate buffers\n");
+		free(expected);
+		free(buffer);
+		close_position_file(&file);
+		return;
+	}
+
+	double start = wall_time();
+
+	for (size_t i = 0; i < file.length; i += BATCH) {
+		size_t length = (file.length - i < BATCH) ? file.length - i : BATCH;
+		encode_naive(file.positions + i, length, expected);
+	}
+
+	double seconds = wall_time() - start;
+
+	printf("encoding\t| positions\t| ms\t\t| positions/s\n");
+	printf("get_piece\t| %zu\t| %-10.3f\t| %.0f\n", file.length, seconds * 1e3, file.length / seconds);
+
+	for (enum Encoding encoding = BITS; encoding < ENCODINGS; encoding++) {
+		bool same = true;
+		seconds = 0;
+
+		for (size_t i = 0; i < file.length; i += BATCH) {
+			size_t length = (file.length - i < BATCH) ? file.length - i : BATCH;
+
+			start = wall_time();
+			encode(encoding, file.positions + i, length, buffer);
+			seconds += wall_time() - start;
+
+			// spot checks, outside of the timing
+			if (i % (64 * BATCH) == 0) {
+				encode_naive(file.positions + i, length, expected);
+				same &= check(file.positions + i, length, expected, buffer, encoding);
+			}
+		}
+
+		printf("%s\t\t| %zu\t| %-10.3f\t| %.0f%s\n", ENCODING_NAMES[encoding], file.length, seconds * 1e3,
+		       file.length / seconds, same ? "" : "\t(mismatch)");
+	}
+
+	free(expected);
+	free(buffer);
+	close_position_file(&file);
+}
+
+int main(int argc, char **argv) {
+	init_bitbase();
+
+	// uchess-features show <fen>
+	if (argc > 2 && strcmp(argv[1], "show") == 0) {
+		show(argv[2]);
+	}
+
+	// uchess-features export <positions> <output> <bits | bytes | floats | halfkp>
+	else if (argc > 4 && strcmp(argv[1], "export") == 0) {
+		enum Encoding encoding = BITS;
+
+		while (encoding < ENCODINGS && strcmp(argv[4], ENCODING_NAMES[encoding]) != 0)
+			encoding++;
+
+		if (encoding == ENCODINGS) {
+			fprintf(stderr, "unknown encoding: %s\n", argv[4]);
+			return 1;
+		}
+
+		export(argv[2], argv[3], encoding);
+	}
+
+	// uchess-features bench <positions>
+	else if (argc > 2 && strcmp(argv[1], "bench") == 0) {
+		bench(argv[2]);
+	}
+
+	else {
+		fprintf(stderr, "usage: uchess-features show <fen>\n"
+		                "       uchess-features export <positions> <output> <bits | bytes | floats | halfkp>\n"
+		                "       uchess-features bench <positions>\n");
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,177 @@
+#include "heatmap.h"
+
+#include "bits.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { KINDS = 12, BLOCK = 16, PLANES = 16, MAX_THREADS = 256 };
+
+// Per piece kind (6 of ours, then 6 of theirs) the partial sums of the
+// current block of 16 by weight 1, 2, 4 and 8, and the count of carries of
+// weight 16 in bit planes. Laid out kind by kind so that every operation
+// vectorises across the kinds.
+struct SlicedCounters {
+	bitboard ones[KINDS], twos[KINDS], fours[KINDS], eights[KINDS];
+	bitboard planes[PLANES][KINDS];
+	size_t blocks;
+};
+
+// carry-save adder of three bitboards per kind
+static inline
+void csa(bitboard *high, bitboard *low, const bitboard *a, const bitboard *b, const bitboard *c) {
+	for (int k = 0; k < KINDS; k++) {
+		bitboard u = a[k] ^ b[k];
+		bitboard h = (a[k] & b[k]) | (u & c[k]);
+		low[k] = u ^ c[k];
+		high[k] = h;
+	}
+}
+
+// Harley-Seal: 16 bitboards per kind reduce to one carry of weight 16, which
+// is rippled into the planes
+static
+void add_block(struct SlicedCounters *c, bitboard d[BLOCK][KINDS]) {
+	bitboard twos_a[KINDS], twos_b[KINDS], fours_a[KINDS], fours_b[KINDS];
+	bitboard eights_a[KINDS], eights_b[KINDS], carry[KINDS];
+
+	csa(twos_a, c->ones, c->ones, d[0], d[1]);
+	csa(twos_b, c->ones, c->ones, d[2], d[3]);
+	csa(fours_a, c->twos, c->twos, twos_a, twos_b);
+	csa(twos_a, c->ones, c->ones, d[4], d[5]);
+	csa(twos_b, c->ones, c->ones, d[6], d[7]);
+	csa(fours_b, c->twos, c->twos, twos_a, twos_b);
+	csa(eights_a, c->fours, c->fours, fours_a, fours_b);
+
+	csa(twos_a, c->ones, c->ones, d[8], d[9]);
+	csa(twos_b, c->ones, c->ones, d[10], d[11]);
+	csa(fours_a, c->twos, c->twos, twos_a, twos_b);
+	csa(twos_a, c->ones, c->ones, d[12], d[13]);
+	csa(twos_b, c->ones, c->ones, d[14], d[15]);
+	csa(fours_b, c->twos, c->twos, twos_a, twos_b);
+	csa(eights_b, c->fours, c->fours, fours_a, fours_b);
+
+	csa(carry, c->eights, c->eights, eights_a, eights_b);
+
+	for (int j = 0; j < PLANES; j++) {
+		bitboard any = 0;
+
+		for (int k = 0; k < KINDS; k++) {
+			bitboard next = c->planes[j][k] & carry[k];
+			c->planes[j][k] ^= carry[k];
+			carry[k] = next;
+			any |= next;
+		}
+
+		if (!any) break;
+	}
+
+	c->blocks++;
+}
+
+static inline
+void add_weighted(uint64_t totals[64], bitboard bb, uint64_t weight) {
+	for (; bb; bb &= bb - 1)
+		totals[lsb(bb)] += weight;
+}
+
+// adds every counter to the totals and clears them
+static
+void flush(struct SlicedCounters *c, struct SquareCounts *counts) {
+	for (int k = 0; k < KINDS; k++) {
+		uint64_t *totals = counts->pieces[k / 6][k % 6];
+
+		add_weighted(totals, c->ones[k], 1);
+		add_weighted(totals, c->twos[k], 2);
+		add_weighted(totals, c->fours[k], 4);
+		add_weighted(totals, c->eights[k], 8);
+
+		for (int j = 0; j < PLANES; j++)
+			add_weighted(totals, c->planes[j][k], (uint64_t)BLOCK << j);
+	}
+
+	memset(c, 0, sizeof *c);
+}
+
+static
+void count_range(const struct Position *positions, size_t length, struct SquareCounts *counts) {
+	struct SlicedCounters counters = {0};
+	bitboard block[BLOCK][KINDS];
+	size_t i = 0;
+
+	for (; i + BLOCK <= length; i += BLOCK) {
+		for (int j = 0; j < BLOCK; j++)
+			piece_planes(positions[i + j], block[j]);
+
+		add_block(&counters, block);
+
+		// the planes hold at most 2^PLANES - 1 carries
+		if (counters.blocks == (1u << PLANES) - 1)
+			flush(&counters, counts);
+	}
+
+	flush(&counters, counts);
+
+	for (; i < length; i++) {
+		piece_planes(positions[i], block[0]);
+
+		for (int k = 0; k < KINDS; k++)
+			add_weighted(counts->pieces[k / 6][k % 6], block[0][k], 1);
+	}
+
+	counts->positions += length;
+}
+
+struct CountWorker {
+	const struct Position *positions;
+	size_t length;
+	struct SquareCounts counts;
+};
+
+static
+void *run_worker(void *arg) {
+	struct CountWorker *w = arg;
+	count_range(w->positions, w->length, &w->counts);
+	return NULL;
+}
+
+void count_squares(const struct Position *positions, size_t length, unsigned threads, struct SquareCounts *counts) {
+	if (threads > MAX_THREADS) threads = MAX_THREADS;
+
+	// the counts of each thread take 6 KiB
+	struct CountWorker *workers = (threads > 1) ? calloc(threads, sizeof *workers) : NULL;
+
+	if (!workers) {
+		count_range(positions, length, counts);
+		return;
+	}
+
+	pthread_t handles[MAX_THREADS];
+	bool started[MAX_THREADS];
+
+	for (unsigned i = 0; i < threads; i++) {
+		size_t begin = length * i / threads, end = length * (i + 1) / threads;
+
+		workers[i].positions = positions + begin;
+		workers[i].length = end - begin;
+
+		// without a thread of its own the slice is counted here
+		started[i] = pthread_create(&handles[i], NULL, run_worker, &workers[i]) == 0;
+		if (!started[i]) run_worker(&workers[i]);
+	}
+
+	for (unsigned i = 0; i < threads; i++) {
+		if (started[i]) pthread_join(handles[i], NULL);
+
+		counts->positions += workers[i].counts.positions;
+
+		for (int c = 0; c < 2; c++)
+			for (int T = 0; T < 6; T++)
+				for (int sq = 0; sq < 64; sq++)
+					counts->pieces[c][T][sq] += workers[i].counts.pieces[c][T][sq];
+	}
+
+	free(workers);
+}
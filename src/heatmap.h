@@ -0,0 +1,23 @@
+#ifndef HEATMAP_H_
+#define HEATMAP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "position.h"
+
+// Occupancy counts of each square by each piece, indexed by the color as
+// stored (the side to move first, unless built with ABSOLUTE_COLORS), the
+// piece type from Pawn and the stored square.
+struct SquareCounts {
+	uint64_t positions;
+	uint64_t pieces[2][6][64];
+};
+
+// Adds the positions to the counts. Each thread takes a slice and adds the
+// 12 piece bitboards of 16 positions at a time into bit-sliced vertical
+// counters with carry-save adders, flushed to the 64-bit totals before they
+// can overflow.
+void count_squares(const struct Position *positions, size_t length, unsigned threads, struct SquareCounts *counts);
+
+#endif /*HEATMAP_H_*/
@@ -0,0 +1,176 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bits.h"
+#include "heatmap.h"
+#include "position.h"
+#include "sort.h"
+#include "state.h"
+#include "text.h"
+#include "timer.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+enum { MAX_LINE = 4096, BATCH = 1 << 16 };
+
+static const char *PIECE_NAMES[] = { "pawns", "knights", "bishops", "rooks", "queens", "kings" };
+
+#ifdef ABSOLUTE_COLORS
+static const char *COLOR_NAMES[] = { "white", "black" };
+#else
+static const char *COLOR_NAMES[] = { "our", "their" };
+#endif
+
+// percentages of the positions with the piece on each square, rank 8 first
+static
+void print_counts(const struct SquareCounts *counts) {
+	printf("%llu positions\n", (unsigned long long)counts->positions);
+
+	for (int c = 0; c < 2; c++) {
+		for (int T = 0; T < 6; T++) {
+			printf("\n%s %s\n", COLOR_NAMES[c], PIECE_NAMES[T]);
+
+			for (int rank = 7; rank >= 0; rank--) {
+				for (int file = 0; file < 8; file++) {
+					uint64_t count = counts->pieces[c][T][8 * rank + file];
+					printf("%6.1f", counts->positions ? 100.0 * count / counts->positions : 0.0);
+				}
+
+				printf("\n");
+			}
+		}
+	}
+}
+
+// fens from stdin, counted in batches
+static
+bool count_stream(unsigned threads, struct SquareCounts *counts) {
+	static char line[MAX_LINE];
+	struct Position *batch = malloc(BATCH * sizeof *batch);
+	size_t length = 0;
+
+	if (!batch) {
+		fprintf(stderr, "failed to allocate %d positions\n", BATCH);
+		return false;
+	}
+
+	while (fgets(line, sizeof line, stdin)) {
+		line[strcspn(line, "\r\n")] = '\0';
+
+		bool ok;
+		struct State state = parse_fen(line, &ok, stderr);
+
+		if (line[0] && ok)
+			batch[length++] = state.pos;
+
+		if (length == BATCH) {
+			count_squares(batch, length, threads, counts);
+			length = 0;
+		}
+	}
+
+	count_squares(batch, length, threads, counts);
+	free(batch);
+	return true;
+}
+
+// one get_piece per square, to compare against
+static
+void count_naive(const struct Position *positions, size_t length, struct SquareCounts *counts) {
+	for (size_t i = 0; i < length; i++) {
+		for (square sq = 0; sq < 64; sq++) {
+			enum PieceType T = get_piece(positions[i], sq);
+
+			if (T != None && T != Info)
+				counts->pieces[!((positions[i].white >> sq) & 1)][T - Pawn][sq]++;
+		}
+	}
+
+	counts->positions += length;
+}
+
+// the naive count, then the bit-sliced counts for 1, 2, 4, ... and
+// max_threads threads
+static
+bool bench(const char *path, unsigned max_threads) {
+	static struct SquareCounts expected, counts;
+	struct PositionFile file;
+
+	if (!open_position_file(&file, path, stderr))
+		return false;
+
+	printf("method\t\t| threads\t| positions\t| ms\t\t| positions/s\n");
+
+	memset(&expected, 0, sizeof expected);
+
+	double start = wall_time();
+	count_naive(file.positions, file.length, &expected);
+	double seconds = wall_time() - start;
+
+	printf("get_piece\t| 1\t\t| %zu\t| %-10.3f\t| %.0f\n", file.length, seconds * 1e3, file.length / seconds);
+
+	// doubling, with max_threads as the last row
+	for (unsigned threads = 1; threads <= max_threads;
+	     threads = (threads < max_threads && 2 * threads > max_threads) ? max_threads : 2 * threads) {
+		memset(&counts, 0, sizeof counts);
+
+		start = wall_time();
+		count_squares(file.positions, file.length, threads, &counts);
+		seconds = wall_time() - start;
+
+		bool same = memcmp(&counts, &expected, sizeof counts) == 0;
+
+		printf("bit-sliced\t| %u\t\t| %zu\t| %-10.3f\t| %.0f%s\n", threads, file.length, seconds * 1e3,
+		       file.length / seconds, same ? "" : "\t(mismatch)");
+	}
+
+	close_position_file(&file);
+	return true;
+}
+
+int main(int argc, char **argv) {
+	init_bitbase();
+
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned default_threads = (cores > 0) ? cores : 1;
+
+	// uchess-heatmap count <positions | -> [threads], reading one fen per line
+	// from stdin for -
+	if (argc > 2 && strcmp(argv[1], "count") == 0) {
+		static struct SquareCounts counts;
+		unsigned threads = (argc > 3) ? (unsigned)atoi(argv[3]) : default_threads;
+
+		if (strcmp(argv[2], "-") == 0) {
+			if (!count_stream(threads, &counts))
+				return 1;
+		}
+
+		else {
+			struct PositionFile file;
+
+			if (!open_position_file(&file, argv[2], stderr))
+				return 1;
+
+			count_squares(file.positions, file.length, threads, &counts);
+			close_position_file(&file);
+		}
+
+		print_counts(&counts);
+	}
+
+	// uchess-heatmap bench <positions> [max threads]
+	else if (argc > 2 && strcmp(argv[1], "bench") == 0) {
+		return !bench(argv[2], (argc > 3) ? (unsigned)atoi(argv[3]) : default_threads);
+	}
+
+	else {
+		fprintf(stderr, "usage: uchess-heatmap count <positions | -> [threads]\n"
+		                "       uchess-heatmap bench <positions> [max threads]\n");
+		return 1;
+	}
+
+	return 0;
+}
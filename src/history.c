@@ -0,0 +1,281 @@
+#include "history.h"
+
+#include "movetext.h"
+
+#include <assert.h>
+
+enum {
+	MASK = HISTORY_PLIES - 1,
+	CUCKOO_SIZE = 8192, // a power of two
+	CUCKOO_MOVES = 3668, // of each piece between each pair of squares it attacks
+};
+
+static uint64_t zobrist_pieces[2][King + 1][64];
+static uint64_t zobrist_castling[16];
+static uint64_t zobrist_en_passant[8];
+static uint64_t zobrist_black;
+
+// reversible moves by the difference they make to the key, in one of two
+// slots, with the squares between the ends in absolute squares
+struct CuckooMove {
+	bitboard ends, between;
+};
+
+static uint64_t cuckoo_keys[CUCKOO_SIZE];
+static struct CuckooMove cuckoo_moves[CUCKOO_SIZE];
+
+static inline size_t cuckoo_first(uint64_t key) { return key & (CUCKOO_SIZE - 1); }
+static inline size_t cuckoo_second(uint64_t key) { return (key >> 16) & (CUCKOO_SIZE - 1); }
+
+static inline
+uint64_t next_random(uint64_t *seed) {
+	*seed ^= *seed >> 12, *seed ^= *seed << 25, *seed ^= *seed >> 27;
+	return *seed * 0x2545f4914f6cdd1d;
+}
+
+// the attacks of a piece on an empty board
+static inline
+bitboard empty_board_attacks(enum PieceType T, square sq) {
+	switch (T) {
+	case Knight: return knight_attacks(sq);
+	case Bishop: return bishop_attacks(sq, 0);
+	case Rook:   return rook_attacks(sq, 0);
+	case Queen:  return queen_attacks(sq, 0);
+	default:     return king_attacks(sq);
+	}
+}
+
+void init_zobrist() {
+	uint64_t seed = 0x9e3779b97f4a7c15;
+
+	for (int c = WHITE; c <= BLACK; c++)
+		for (int T = Pawn; T <= King; T++)
+			for (int sq = 0; sq < 64; sq++)
+				zobrist_pieces[c][T][sq] = next_random(&seed);
+
+	for (int i = 0; i < 16; i++) zobrist_castling[i] = i ? next_random(&seed) : 0;
+	for (int i = 0; i < 8; i++) zobrist_en_passant[i] = next_random(&seed);
+	zobrist_black = next_random(&seed);
+
+	memset(cuckoo_keys, 0, sizeof cuckoo_keys);
+	size_t count = 0;
+
+	for (int c = WHITE; c <= BLACK; c++) {
+		for (int T = Knight; T <= King; T++) {
+			for (square a = 0; a < 64; a++) {
+				for (square b = a + 1; b < 64; b++) {
+					if (!((empty_board_attacks(T, a) >> b) & 1))
+						continue;
+
+					uint64_t key = zobrist_pieces[c][T][a] ^ zobrist_pieces[c][T][b] ^ zobrist_black;
+					struct CuckooMove move = { (1ULL << a) | (1ULL << b), line_between(1ULL << a, 1ULL << b) };
+					size_t slot = cuckoo_first(key);
+
+					// insert, displacing entries to their other slot until one is free
+					for (;;) {
+						uint64_t displaced_key = cuckoo_keys[slot];
+						struct CuckooMove displaced = cuckoo_moves[slot];
+
+						cuckoo_keys[slot] = key;
+						cuckoo_moves[slot] = move;
+
+						if (displaced_key == 0)
+							break;
+
+						key = displaced_key, move = displaced;
+						slot = (slot == cuckoo_first(key)) ? cuckoo_second(key) : cuckoo_first(key);
+					}
+
+					count++;
+				}
+			}
+		}
+	}
+
+	assert(count == CUCKOO_MOVES);
+	(void)count;
+}
+
+// the stored board in absolute squares
+static inline
+bitboard absolute(struct State state, bitboard bb) {
+#ifdef ABSOLUTE_COLORS
+	(void)state;
+	return bb;
+#else
+	return (state.side_to_move == BLACK) ? rotate(bb) : bb;
+#endif
+}
+
+// the absolute color of the pieces of the white bitboard
+static inline
+enum Color white_color(struct State state) {
+#ifdef ABSOLUTE_COLORS
+	(void)state;
+	return WHITE;
+#else
+	return state.side_to_move;
+#endif
+}
+
+static inline
+uint64_t piece_key(struct State state, bool white, enum PieceType T, square sq) {
+	enum Color c = white ? white_color(state) : !white_color(state);
+	return zobrist_pieces[c][T][board_square(state, sq)];
+}
+
+// castling rights and en-passant file
+static inline
+uint64_t info_key(struct State state) {
+	bitboard info = extract_info(state.pos);
+	bitboard castling = (info & CA_MASK) >> 8;
+
+#ifndef ABSOLUTE_COLORS
+	if (state.side_to_move == BLACK)
+		castling = ((castling << 2) | (castling >> 2)) & 15;
+#endif
+
+	uint64_t key = zobrist_castling[castling];
+	if (info & EP_MASK) key ^= zobrist_en_passant[lsb(info & EP_MASK)];
+
+	return key;
+}
+
+uint64_t zobrist_key(struct State state) {
+	uint64_t key = info_key(state) ^ ((state.side_to_move == BLACK) ? zobrist_black : 0);
+
+	for (bitboard occ = occupied(state.pos); occ; occ &= occ - 1) {
+		square sq = lsb(occ);
+		key ^= piece_key(state, (state.pos.white >> sq) & 1, get_piece(state.pos, sq), sq);
+	}
+
+	return key;
+}
+
+// the key after the move, from the pieces it moves, captures and castles
+static
+uint64_t next_key(uint64_t key, struct State state, struct Move move) {
+	enum { A1 = 0, H1 = 7 };
+
+	struct Position pos = state.pos;
+	enum Color c = turn(pos);
+	bool white = (c == WHITE);
+
+	enum PieceType T = get_piece(pos, move.start);
+	enum PieceType victim = get_piece(pos, move.end);
+
+	key ^= info_key(state) ^ zobrist_black;
+	key ^= piece_key(state, white, T, move.start) ^ piece_key(state, white, move.piece, move.end);
+
+	if (victim != None && victim != Info) {
+		key ^= piece_key(state, !white, victim, move.end);
+	}
+
+	// a pawn moving to another file onto an empty square captures en passant
+	else if (T == Pawn && ((move.start ^ move.end) & 7)) {
+		key ^= piece_key(state, !white, Pawn, lsb(backward(c, 1ULL << move.end)));
+	}
+
+	if (move.castling) {
+		square rook = relative_square(c, (move.end < move.start) ? A1 : H1);
+		square mid = (move.start + move.end) >> 1;
+
+		key ^= piece_key(state, white, Rook, rook) ^ piece_key(state, white, Rook, mid);
+	}
+
+	return key;
+}
+
+void init_history(struct History *history, struct State root) {
+	history->ply = 0;
+	history->states[0] = root;
+	history->keys[0] = zobrist_key(root);
+}
+
+void history_make_move(struct History *history, struct Move move) {
+	struct State state = current_state(history);
+	uint64_t key = next_key(history->keys[history->ply & MASK], state, move);
+
+	state = play_move(state, move);
+	size_t ply = ++history->ply & MASK;
+
+	history->states[ply] = state;
+	history->keys[ply] = key ^ info_key(state);
+}
+
+void history_unmake_move(struct History *history) {
+	assert(history->ply > 0);
+	history->ply--;
+}
+
+// the earlier positions that can repeat: the plies since the last
+// irreversible move, as far back as the root
+static inline
+size_t reversible_plies(const struct History *history) {
+	size_t reversible = current_state(history).fify_move_clock;
+
+	if (reversible > history->ply) reversible = history->ply;
+	if (reversible > MASK) reversible = MASK;
+
+	return reversible;
+}
+
+unsigned repetitions(const struct History *history) {
+	size_t ply = history->ply, reversible = reversible_plies(history);
+	struct State state = history->states[ply & MASK];
+
+	uint64_t key = history->keys[ply & MASK];
+	unsigned count = 0;
+
+	// a position can't repeat 2 plies later, as both sides have moved
+	for (size_t back = 4; back <= reversible; back += 2) {
+		size_t i = (ply - back) & MASK;
+		count += history->keys[i] == key && same_position(history->states[i].pos, state.pos);
+	}
+
+	return count;
+}
+
+bool is_repetition_draw(const struct History *history) {
+	return repetitions(history) >= 2;
+}
+
+bool is_fifty_move_draw(const struct History *history) {
+	struct State state = current_state(history);
+
+	if (state.fify_move_clock < 100)
+		return false;
+
+	return !enemy_checks(state.pos) || generate_moves(state.pos).length != 0;
+}
+
+bool has_upcoming_repetition(const struct History *history) {
+	size_t ply = history->ply, reversible = reversible_plies(history);
+	if (reversible < 3) return false;
+
+	struct State state = history->states[ply & MASK];
+	uint64_t key = history->keys[ply & MASK];
+
+	bitboard occ = absolute(state, occupied(state.pos));
+	bitboard ours = absolute(state, side(state.pos, turn(state.pos)));
+
+	// after our move, the positions an odd number of plies back have the same
+	// side to move, the nearest that could repeat being 4 plies back
+	for (size_t back = 3; back <= reversible; back += 2) {
+		uint64_t diff = key ^ history->keys[(ply - back) & MASK];
+		size_t slot = cuckoo_first(diff);
+
+		if (cuckoo_keys[slot] != diff) {
+			slot = cuckoo_second(diff);
+			if (cuckoo_keys[slot] != diff) continue;
+		}
+
+		struct CuckooMove move = cuckoo_moves[slot];
+
+		// one end holds our piece and the other is empty, nothing in between
+		if (!(move.between & occ) && (move.ends & ours) && (move.ends & ~occ))
+			return true;
+	}
+
+	return false;
+}
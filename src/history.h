@@ -0,0 +1,58 @@
+#ifndef HISTORY_H_
+#define HISTORY_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "movegen.h"
+#include "state.h"
+
+enum { HISTORY_PLIES = 1024 }; // a power of two
+
+// fills the Zobrist keys and the cuckoo table of reversible moves, once
+// before using any of the functions below
+void init_zobrist();
+
+// Zobrist key of the pieces, castling rights, en-passant file and side to
+// move in absolute colors and squares, so it doesn't depend on the rotation
+// of the board
+uint64_t zobrist_key(struct State state);
+
+// The states of a game from the root to the current ply, with the Zobrist
+// key of each position, in ring buffers: moves can be unmade back to the root
+// or up to HISTORY_PLIES - 1 plies, and repetitions are looked for among the
+// positions since the last capture or pawn move.
+struct History {
+	struct State states[HISTORY_PLIES];
+	uint64_t keys[HISTORY_PLIES];
+	size_t ply; // since the root
+};
+
+void init_history(struct History *history, struct State root);
+
+static inline struct State current_state(const struct History *history) {
+	return history->states[history->ply & (HISTORY_PLIES - 1)];
+}
+
+// makes the move, keeping the clocks and the side to move (see play_move) and
+// updating the key incrementally
+void history_make_move(struct History *history, struct Move move);
+void history_unmake_move(struct History *history);
+
+// the earlier occurrences of the current position, with the same side to
+// move, since the last irreversible move
+unsigned repetitions(const struct History *history);
+
+// threefold repetition, or 100 plies without a capture or pawn move unless
+// the side to move is checkmated
+bool is_repetition_draw(const struct History *history);
+bool is_fifty_move_draw(const struct History *history);
+
+// Whether the side to move has a knight, bishop, rook, queen or king move back
+// to a position since the last irreversible move, found by looking up the key
+// difference to each earlier position in the cuckoo table and checking the
+// squares between are empty. The move isn't checked for legality.
+bool has_upcoming_repetition(const struct History *history);
+
+#endif /*HISTORY_H_*/
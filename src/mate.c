@@ -0,0 +1,351 @@
+#include "mate.h"
+
+#include "bits.h"
+#include "movegen.h"
+#include "position.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+enum { BUCKET = 4 };
+
+static const uint32_t INF = UINT32_MAX / 4;
+
+bool init_mate_solver(struct MateSolver *solver, size_t hash_mb) {
+	size_t entries = BUCKET;
+
+	while (2 * entries * sizeof(struct MateEntry) <= hash_mb << 20) {
+		entries *= 2;
+	}
+
+	solver->table = calloc(entries, sizeof *solver->table);
+	solver->mask = entries - 1;
+	solver->length = 0;
+	solver->epoch = 0;
+
+	return solver->table != NULL;
+}
+
+void clear_mate_solver(struct MateSolver *solver) {
+	memset(solver->table, 0, (solver->mask + 1) * sizeof *solver->table);
+}
+
+void free_mate_solver(struct MateSolver *solver) {
+	free(solver->table);
+	solver->table = NULL;
+}
+
+// plies left to mate at `ply`, which is part of the key when the search is
+// limited to a number of moves, as results then depend on it
+static inline
+uint8_t plies_left(struct MateSolver *solver, size_t ply) {
+	return solver->max_moves ? 2 * solver->max_moves - 1 - ply : 0;
+}
+
+static inline
+struct MateEntry *bucket(struct MateSolver *solver, struct Position pos, uint8_t depth) {
+	uint64_t hash = hash_position(pos) ^ (depth * 0x9e3779b97f4a7c15);
+	return &solver->table[hash & solver->mask & ~(size_t)(BUCKET - 1)];
+}
+
+// whether the result of an entry holds on the current path
+static inline
+bool holds(const struct MateSolver *solver, const struct MateEntry *entry) {
+	return !entry->loop || (entry->loop <= solver->length && solver->epochs[entry->loop - 1] == entry->epoch);
+}
+
+static inline
+struct MateEntry *lookup(struct MateSolver *solver, struct Position pos, size_t ply) {
+	uint8_t depth = plies_left(solver, ply);
+	struct MateEntry *entries = bucket(solver, pos, depth);
+
+	for (int i = 0; i < BUCKET; i++) {
+		if (same_position(entries[i].key, pos) && entries[i].depth == depth)
+			return holds(solver, &entries[i]) ? &entries[i] : NULL;
+	}
+
+	return NULL;
+}
+
+static inline
+void push_path(struct MateSolver *solver, struct Position pos) {
+	solver->epochs[solver->length] = ++solver->epoch;
+	solver->path[solver->length++] = pos;
+}
+
+// replaces the entry with the least work, keeping proofs where possible
+static
+void store(struct MateSolver *solver, struct MateEntry entry) {
+	struct MateEntry *entries = bucket(solver, entry.key, entry.depth);
+	struct MateEntry *victim = &entries[0];
+	uint64_t least = UINT64_MAX;
+
+	for (int i = 0; i < BUCKET; i++) {
+		if (same_position(entries[i].key, entry.key) && entries[i].depth == entry.depth) {
+			victim = &entries[i];
+			break;
+		}
+
+		bool resolved = (entries[i].phi == 0 || entries[i].delta == 0) && holds(solver, &entries[i]);
+		uint64_t value = entries[i].work + (resolved ? (uint64_t)INF : 0);
+
+		if (value < least) {
+			least = value;
+			victim = &entries[i];
+		}
+	}
+
+	*victim = entry;
+}
+
+// the index of the position on the path plus one, or 0
+static inline
+uint8_t on_path(struct MateSolver *solver, struct Position pos) {
+	// the same side is to move every other ply
+	for (size_t i = solver->length % 2; i < solver->length; i += 2) {
+		if (same_position(solver->path[i], pos))
+			return i + 1;
+	}
+
+	return 0;
+}
+
+static inline
+struct MoveList node_moves(struct Position pos, bool attacker) {
+	return attacker ? generate_checks(pos) : generate_moves(pos);
+}
+
+// Values of a child, where repetitions and the ply limit count as a failure
+// of the attacker; unvisited children start at (1, 1). `loop` is set to the
+// path index plus one of the deepest position the values depend on, or 0.
+// Without a limit on moves the ply isn't part of the key, so failing the ply
+// limit only holds for the current search from the root.
+static inline
+void child_values(struct MateSolver *solver, struct Position child, bool attacker, uint32_t *phi, uint32_t *delta,
+                  uint8_t *loop) {
+	size_t ply = solver->length;
+	size_t max_ply = solver->max_moves ? 2 * solver->max_moves - 1 : MAX_MATE_PLY - 1;
+
+	*loop = (ply > max_ply) ? !solver->max_moves : on_path(solver, child);
+
+	if (ply > max_ply || *loop) {
+		// `attacker` is the side to move at the child
+		*phi = attacker ? INF : 0;
+		*delta = attacker ? 0 : INF;
+		return;
+	}
+
+	struct MateEntry *entry = lookup(solver, child, ply);
+	*phi = entry ? entry->phi : 1;
+	*delta = entry ? entry->delta : 1;
+	*loop = entry ? entry->loop : 0;
+}
+
+static
+uint16_t proven_distance(struct MateSolver *solver, struct Position *children, size_t count, bool winning) {
+	// winning: the fastest child that loses for the opponent,
+	// losing: the slowest child, all of which win for the opponent
+	uint16_t distance = winning ? UINT16_MAX : 0;
+
+	for (size_t i = 0; i < count; i++) {
+		struct MateEntry *entry = lookup(solver, children[i], solver->length + 1);
+		if (entry == NULL) continue;
+
+		if (winning && entry->delta == 0 && entry->distance < distance)
+			distance = entry->distance;
+
+		if (!winning && entry->phi == 0 && entry->distance > distance)
+			distance = entry->distance;
+	}
+
+	return distance + 1;
+}
+
+// multiple iterative deepening: expands the most proving child until the
+// node's phi or delta reaches its threshold
+static
+void mid(struct MateSolver *solver, struct Position pos, bool attacker, uint32_t phi_threshold, uint32_t delta_threshold) {
+	uint64_t start = solver->nodes;
+
+	struct MoveList list = node_moves(pos, attacker);
+	solver->nodes += list.length;
+
+	if (list.length == 0) {
+		// stalemate is the only way for the side to move to not lose here
+		bool stalemate = !attacker && !enemy_checks(pos);
+
+		store(solver, (struct MateEntry){
+			.key = pos,
+			.phi = stalemate ? 0 : INF,
+			.delta = stalemate ? INF : 0,
+			.work = 1,
+			.depth = plies_left(solver, solver->length),
+		});
+
+		return;
+	}
+
+	struct Position children[MAX_MOVELIST_LENGTH];
+
+	for (size_t i = 0; i < list.length; i++) {
+		children[i] = make_move(pos, list.moves[i]);
+	}
+
+	push_path(solver, pos);
+
+	uint32_t phi, delta;
+	uint8_t loop, escape_loop;
+
+	for (;;) {
+		size_t best = 0;
+		uint32_t best_phi = INF, best_delta = INF, second_delta = INF;
+		uint64_t sum = 0;
+
+		phi = INF;
+
+		// a failure of the attacker depends on the path if every move fails
+		// at the attacker's node, or every failing move does at the defender's
+		loop = 0, escape_loop = UINT8_MAX;
+
+		for (size_t i = 0; i < list.length; i++) {
+			uint32_t child_phi, child_delta;
+			uint8_t child_loop;
+			child_values(solver, children[i], !attacker, &child_phi, &child_delta, &child_loop);
+
+			// a repetition of this position itself only rules out a cycle from it
+			if (child_loop == solver->length) child_loop = 0;
+
+			if (child_loop > loop) loop = child_loop;
+			if (child_delta == 0 && child_loop < escape_loop) escape_loop = child_loop;
+
+			sum = (child_phi >= INF || sum >= INF) ? INF : sum + child_phi;
+
+			if (child_delta < best_delta) {
+				second_delta = best_delta;
+				best_delta = child_delta;
+				best_phi = child_phi;
+				best = i;
+			}
+
+			else if (child_delta < second_delta) {
+				second_delta = child_delta;
+			}
+		}
+
+		phi = best_delta;
+		delta = (sum >= INF) ? INF : (sum < INF - 1) ? sum : INF - 1;
+
+		if (phi >= phi_threshold || delta >= delta_threshold)
+			break;
+
+		if (solver->limit && solver->nodes >= solver->limit)
+			break;
+
+		uint32_t child_phi_threshold = (delta_threshold >= INF) ? INF : delta_threshold + best_phi - delta;
+		uint32_t child_delta_threshold = (second_delta >= INF) ? phi_threshold
+		                               : (phi_threshold < second_delta + 1) ? phi_threshold : second_delta + 1;
+
+		mid(solver, children[best], !attacker, child_phi_threshold, child_delta_threshold);
+	}
+
+	solver->length--;
+
+	struct MateEntry entry = {
+		.key = pos,
+		.phi = phi,
+		.delta = delta,
+		.work = solver->nodes - start,
+		.depth = plies_left(solver, solver->length),
+	};
+
+	if (phi == 0 || delta == 0)
+		entry.distance = proven_distance(solver, children, list.length, phi == 0);
+
+	if (attacker ? delta == 0 : phi == 0) {
+		entry.loop = attacker ? loop : escape_loop;
+		if (entry.loop) entry.epoch = solver->epochs[entry.loop - 1];
+	}
+
+	store(solver, entry);
+}
+
+// Follows proven children, re-proving any that were replaced in the table:
+// every defence, and the attacker's moves when none is left proven. False
+// unless the line ends in mate.
+static
+bool mating_line(struct MateSolver *solver, struct Position pos, struct MoveList *line) {
+	line->length = 0;
+
+	for (bool attacker = true; line->length < MAX_MATE_PLY - 1; attacker = !attacker) {
+		struct MoveList list = node_moves(pos, attacker);
+		if (list.length == 0) return !attacker && enemy_checks(pos);
+
+		size_t ply = line->length + 1;
+		size_t best = list.length;
+		uint16_t best_distance = 0;
+
+		for (int attempt = 0; attempt < 2 && best == list.length; attempt++) {
+			// the node itself, whose search stores its children again
+			if (attempt) {
+				solver->length = line->length;
+				mid(solver, pos, true, INF, INF);
+			}
+
+			solver->length = line->length;
+			push_path(solver, pos);
+
+			for (size_t i = 0; i < list.length; i++) {
+				struct Position child = make_move(pos, list.moves[i]);
+				struct MateEntry *entry = lookup(solver, child, ply);
+
+				// defences must all be proven, so a missing one was replaced
+				if (!attacker && (entry == NULL || entry->phi != 0)) {
+					mid(solver, child, true, INF, INF);
+					entry = lookup(solver, child, ply);
+				}
+
+				if (entry == NULL || (attacker ? entry->delta : entry->phi) != 0)
+					continue;
+
+				// the attacker mates fastest, the defender resists longest
+				bool better = attacker ? entry->distance < best_distance : entry->distance > best_distance;
+
+				if (best == list.length || better) {
+					best = i;
+					best_distance = entry->distance;
+				}
+			}
+
+			// a defender's node is only reached once every defence is proven
+			if (!attacker) break;
+		}
+
+		if (best == list.length) return false;
+
+		line->moves[line->length++] = list.moves[best];
+		pos = make_move(pos, list.moves[best]);
+	}
+
+	return false;
+}
+
+bool solve_mate(struct MateSolver *solver, struct Position pos, unsigned max_moves, uint64_t max_nodes, struct MoveList *line) {
+	solver->nodes = 0;
+	solver->limit = max_nodes;
+	solver->max_moves = (max_moves < MAX_MATE_PLY / 2) ? max_moves : MAX_MATE_PLY / 2;
+	solver->length = 0;
+
+	mid(solver, pos, true, INF, INF);
+
+	struct MateEntry *entry = lookup(solver, pos, 0);
+	bool proven = entry && entry->phi == 0;
+
+	line->length = 0;
+
+	if (proven) {
+		solver->limit = 0;
+		proven = mating_line(solver, pos, line);
+	}
+
+	return proven;
+}
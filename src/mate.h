@@ -0,0 +1,56 @@
+#ifndef MATE_H_
+#define MATE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "movegen.h"
+#include "position.h"
+
+#define MAX_MATE_PLY 128
+
+// Proof and disproof numbers of a node, from the point of view of the side to
+// move: phi is 0 once it is proven to win, delta is 0 once it is proven not to.
+// A failure of the attacker that relies on a repetition of a position on the
+// path only holds below that position, so it keeps the path index (plus one)
+// and the epoch of the visit to it, and is ignored once the search left it.
+struct MateEntry {
+	struct Position key;
+	uint32_t phi, delta;
+	uint32_t work;     // nodes searched below this entry, for replacement
+	uint32_t epoch;    // of the visit to path[loop - 1]
+	uint16_t distance; // plies to mate once proven
+	uint8_t depth;     // plies left when limited to a number of moves
+	uint8_t loop;      // 0 unless the result depends on the path
+};
+
+// Depth-first proof-number search for a forced mate by the side to move,
+// where the attacker only plays checks. Positions are stored by their full
+// 32 bytes in the table, so there are no hash collisions.
+struct MateSolver {
+	struct MateEntry *table;
+	size_t mask;
+
+	uint64_t nodes; // positions generated
+	uint64_t limit;
+	unsigned max_moves;
+
+	// positions on the current path, to avoid cycles of checks, each with the
+	// epoch of its visit
+	struct Position path[MAX_MATE_PLY];
+	uint32_t epochs[MAX_MATE_PLY];
+	uint32_t epoch;
+	size_t length;
+};
+
+bool init_mate_solver(struct MateSolver *solver, size_t hash_mb);
+void clear_mate_solver(struct MateSolver *solver);
+void free_mate_solver(struct MateSolver *solver);
+
+// proves a mate in at most `max_moves` moves searching at most `max_nodes`
+// positions (either 0 for no limit), writing the mating line, alternating
+// attacker and defender moves and ending in mate, to `line`
+bool solve_mate(struct MateSolver *solver, struct Position pos, unsigned max_moves, uint64_t max_nodes, struct MoveList *line);
+
+#endif /*MATE_H_*/
@@ -0,0 +1,167 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bits.h"
+#include "mate.h"
+#include "movegen.h"
+#include "position.h"
+#include "state.h"
+#include "text.h"
+#include "timer.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { DEFAULT_HASH_MB = 64, DEFAULT_NODES = 10000000, MAX_LINE = 4096, REPEATS = 16 };
+
+static
+void print_line(struct State state, const struct MoveList *line) {
+	for (size_t i = 0; i < line->length; i++) {
+		char buffer[16];
+		buffer[generate_san(line->moves[i], state, buffer, true)] = '\0';
+
+		if (state.side_to_move == WHITE)
+			printf("%u. ", state.movenumber);
+		else if (i == 0)
+			printf("%u... ", state.movenumber);
+
+		printf("%s ", buffer);
+
+		state.pos = make_move(state.pos, line->moves[i]);
+		state.movenumber += state.side_to_move == BLACK;
+		state.side_to_move = !state.side_to_move;
+	}
+}
+
+// shortest mates where every attacking move is a check
+
+static const struct {
+	const char *fen;
+	unsigned moves;
+} suite[] = {
+	{ "6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1", 1 },
+	{ "r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq - 4 4", 1 },
+	{ "rn1qkbnr/ppp2p1p/3p2p1/4N3/2B1P3/2N5/PPPP1PPP/R1BbK2R w KQkq - 0 6", 2 },
+	{ "q2n2n1/2p2k2/8/2P1PpP1/P6r/N3BPpp/8/3b1KR1 b - - 0 44", 2 },
+	{ "rn2k2r/5pb1/pp2p1pp/1ppP2P1/2q3P1/PP4P1/2P1N1KN/R1Q4R b - - 0 27", 3 },
+	{ "qB4r1/p3kp2/NnppPbpr/4P1nB/Ppb2Q2/8/1PP1NPPP/2RK3R w - - 0 23", 3 },
+	{ "r1b1kb1r/pppp1ppp/5q2/4n3/3KP3/2N3PN/PPP4P/R1BQ1B1R b kq - 0 1", 3 },
+	{ "2rk3b/p1p1qp2/bn1pp1p1/1B2NQ2/4P1Pr/1pN2K1p/PnP2P1P/R1B4R w - - 0 15", 4 },
+	{ "r3kn2/b1p4r/p5p1/Pp2q3/4RPbp/2P5/1P1P1N1P/RNB4K b q - 0 28", 4 },
+	{ "5bq1/1Q4p1/P5r1/1nk1pPP1/3p2RP/8/3P4/1NB1KB2 w - - 0 57", 5 },
+	{ "1r1k4/p1ppqpb1/3Pp1p1/1B2NQ2/n3P1Pr/2p4p/PPPB1P1P/R1K4R w - - 0 10", 6 },
+	{ "3R1rk1/2P5/4Pp1r/N2p3p/6P1/2PB2n1/3b1K2/8 w - - 0 62", 6 },
+	{ "1rb5/2Q1b1kr/3p1p2/4Pq1p/1PP3nP/6PR/1P3P2/RNB1K3 b - - 0 32", 7 },
+};
+
+static
+int compare_times(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+static
+void bench(struct MateSolver *solver, uint64_t max_nodes) {
+	int count = sizeof suite / sizeof suite[0];
+	uint64_t total_nodes = 0;
+	double total_seconds = 0;
+
+	printf("position\t| expected\t| found\t\t| positions\t| ms\t\t| positions/s\n");
+
+	for (int i = 0; i < count; i++) {
+		bool ok;
+		struct State state = parse_fen(suite[i].fen, &ok, stderr);
+		struct MoveList line;
+
+		bool proven = false;
+
+		// median of several solves from an empty table
+		double times[REPEATS];
+
+		for (int r = 0; r < REPEATS; r++) {
+			clear_mate_solver(solver);
+
+			double start = wall_time();
+			proven = solve_mate(solver, state.pos, suite[i].moves, max_nodes, &line);
+			times[r] = wall_time() - start;
+		}
+
+		qsort(times, REPEATS, sizeof *times, compare_times);
+		double seconds = times[REPEATS / 2];
+
+		printf("%d\t\t| mate in %u\t| ", i + 1, suite[i].moves);
+
+		if (proven) printf("mate in %zu\t", (line.length + 1) / 2);
+		else        printf("none\t\t");
+
+		printf("| %-10llu\t| %-10.3f\t| %.0f\n", (unsigned long long)solver->nodes,
+		       seconds * 1e3, solver->nodes / seconds);
+
+		total_nodes += solver->nodes;
+		total_seconds += seconds;
+	}
+
+	printf("total\t\t|\t\t|\t\t| %-10llu\t| %-10.3f\t| %.0f\n", (unsigned long long)total_nodes,
+	       total_seconds * 1e3, total_nodes / total_seconds);
+}
+
+static
+void solve(struct MateSolver *solver, const char *fen, unsigned max_moves, uint64_t max_nodes) {
+	bool ok;
+	struct State state = parse_fen(fen, &ok, stderr);
+	if (!ok) return;
+
+	struct MoveList line;
+	clear_mate_solver(solver);
+
+	if (solve_mate(solver, state.pos, max_moves, max_nodes, &line)) {
+		printf("%s; mate in %zu: ", fen, (line.length + 1) / 2);
+		print_line(state, &line);
+		printf("\n");
+	}
+
+	else {
+		printf("%s; none\n", fen);
+	}
+}
+
+int main(int argc, char **argv) {
+	init_bitbase();
+
+	struct MateSolver solver;
+
+	if (!init_mate_solver(&solver, DEFAULT_HASH_MB)) {
+		fprintf(stderr, "failed to allocate hash table\n");
+		return 1;
+	}
+
+	// uchess-mate bench [max positions]
+	if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+		bench(&solver, (argc > 2) ? strtoull(argv[2], NULL, 10) : DEFAULT_NODES);
+	}
+
+	// uchess-mate <fen | -> [max moves] [max positions], reading one fen per
+	// line from stdin for -
+	else if (argc > 1 && strcmp(argv[1], "-") != 0) {
+		unsigned max_moves = (argc > 2) ? (unsigned)atoi(argv[2]) : 0;
+		uint64_t max_nodes = (argc > 3) ? strtoull(argv[3], NULL, 10) : DEFAULT_NODES;
+
+		solve(&solver, argv[1], max_moves, max_nodes);
+	}
+
+	else {
+		static char line[MAX_LINE];
+
+		unsigned max_moves = (argc > 2) ? (unsigned)atoi(argv[2]) : 0;
+		uint64_t max_nodes = (argc > 3) ? strtoull(argv[3], NULL, 10) : DEFAULT_NODES;
+
+		while (fgets(line, sizeof line, stdin)) {
+			line[strcspn(line, "\r\n")] = '\0';
+			if (line[0]) solve(&solver, line, max_moves, max_nodes);
+		}
+	}
+
+	free_mate_solver(&solver);
+	return 0;
+}
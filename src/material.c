@@ -0,0 +1,293 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "material.h"
+
+#include "bits.h"
+#include "sort.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char MAGIC[8] = "UCMAT1";
+static const char PIECE_CHARS[] = " PNBRQK";
+
+// native byte order
+struct MaterialHeader {
+	char magic[8];
+	uint64_t signature_count;
+	uint64_t entry_count;
+	uint64_t reserved;
+};
+
+uint64_t pawn_key(struct Position pos) {
+	enum Color c = turn(pos);
+	bitboard pawns = extract(pos, Pawn);
+	bitboard us = relative(c, pawns & side(pos, c));
+	bitboard them = relative(c, pawns & side(pos, !c));
+
+	uint64_t h = (us ^ 0x9e3779b97f4a7c15) * 0xbf58476d1ce4e5b9;
+	h = (h ^ (h >> 31) ^ them) * 0x94d049bb133111eb;
+	return h ^ (h >> 29);
+}
+
+static inline
+bitboard fill_north(bitboard bb) {
+	bb |= bb << 8;
+	bb |= bb << 16;
+	return bb | bb << 32;
+}
+
+static inline
+bitboard fill_south(bitboard bb) {
+	bb |= bb >> 8;
+	bb |= bb >> 16;
+	return bb | bb >> 32;
+}
+
+// features of `ours`, moving north, as the US flags
+static inline
+unsigned side_features(bitboard ours, bitboard theirs) {
+	bitboard behind = fill_south(shiftS(theirs));
+	bitboard stoppers = behind | shiftE(behind) | shiftW(behind);
+
+	bitboard files = fill_north(fill_south(ours));
+	bitboard neighbours = shiftE(files) | shiftW(files);
+
+	unsigned features = 0;
+
+	if (ours & ~stoppers) features |= PASSED_US;
+	if (ours & ~neighbours) features |= ISOLATED_US;
+	if (ours & fill_north(shiftN(ours))) features |= DOUBLED_US;
+
+	return features;
+}
+
+unsigned pawn_features(struct Position pos) {
+	enum Color c = turn(pos);
+	bitboard pawns = extract(pos, Pawn);
+	bitboard us = relative(c, pawns & side(pos, c));
+	bitboard them = relative(c, pawns & side(pos, !c));
+
+	// the other side moves north once the board is flipped
+	return side_features(us, them) | side_features(rotate(them), rotate(us)) << 1;
+}
+
+bool parse_material(const char *signature, uint64_t *key, FILE *stream) {
+	unsigned counts[2][7] = {{0}};
+	int theirs = 0;
+
+	for (const char *c = signature; *c; c++) {
+		const char *piece = (*c != ' ') ? strchr(PIECE_CHARS, *c) : NULL;
+
+		if ((*c == 'v' || *c == 'V') && !theirs) {
+			theirs = 1;
+		}
+
+		else if (piece && counts[theirs][piece - PIECE_CHARS] < 15) {
+			counts[theirs][piece - PIECE_CHARS]++;
+		}
+
+		else {
+			fprintf(stream, "invalid material signature: %s\n", signature);
+			return false;
+		}
+	}
+
+	if (counts[0][King] != 1 || counts[1][King] != 1) {
+		fprintf(stream, "material signature needs one king per side: %s\n", signature);
+		return false;
+	}
+
+	*key = 0;
+
+	for (enum PieceType T = Pawn; T <= Queen; T++) {
+		*key |= (uint64_t)counts[0][T] << (4 * (T - Pawn));
+		*key |= (uint64_t)counts[1][T] << (4 * (T - Pawn) + 20);
+	}
+
+	return true;
+}
+
+size_t format_material(uint64_t key, char *buffer) {
+	size_t length = 0;
+
+	for (int theirs = 0; theirs < 2; theirs++) {
+		buffer[length++] = 'K';
+
+		for (enum PieceType T = Queen; T >= Pawn; T--) {
+			unsigned count = (key >> (4 * (T - Pawn) + 20 * theirs)) & 15;
+
+			while (count--)
+				buffer[length++] = PIECE_CHARS[T];
+		}
+
+		if (!theirs) buffer[length++] = 'v';
+	}
+
+	buffer[length] = '\0';
+	return length;
+}
+
+bool build_material_index(const struct Position *positions, size_t length, const char *path, unsigned threads, FILE *stream) {
+	// entries as 256-bit keys (signature, pawn key, record, features), so
+	// that the radix sort of positions orders them
+	struct Position *keys = malloc((length ? length : 1) * sizeof *keys);
+
+	if (!keys) {
+		fprintf(stream, "failed to allocate %zu index entries\n", length);
+		return false;
+	}
+
+	for (size_t i = 0; i < length; i++) {
+		keys[i] = (struct Position){
+			.white = material_key(positions[i]),
+			.X = pawn_key(positions[i]),
+			.Y = i,
+			.Z = pawn_features(positions[i]),
+		};
+	}
+
+	sort_positions(keys, length, threads, false);
+
+	struct MaterialHeader header = { .entry_count = length };
+	memcpy(header.magic, MAGIC, sizeof MAGIC);
+
+	for (size_t i = 0; i < length; i++)
+		header.signature_count += (i == 0 || keys[i].white != keys[i - 1].white);
+
+	FILE *file = fopen(path, "wb");
+
+	if (!file) {
+		fprintf(stream, "failed to create %s\n", path);
+		free(keys);
+		return false;
+	}
+
+	bool ok = fwrite(&header, sizeof header, 1, file) == 1;
+
+	for (size_t i = 0; i < length && ok; i++) {
+		if (i == 0 || keys[i].white != keys[i - 1].white) {
+			struct MaterialSignature signature = { keys[i].white, i };
+			ok = fwrite(&signature, sizeof signature, 1, file) == 1;
+		}
+	}
+
+	// the sentinel ends the entries of the last signature
+	struct MaterialSignature sentinel = { UINT64_MAX, length };
+	ok = ok && fwrite(&sentinel, sizeof sentinel, 1, file) == 1;
+
+	for (size_t i = 0; i < length && ok; i++) {
+		struct MaterialEntry entry = { keys[i].X, keys[i].Y, keys[i].Z };
+		ok = fwrite(&entry, sizeof entry, 1, file) == 1;
+	}
+
+	ok &= fclose(file) == 0;
+	free(keys);
+
+	if (!ok) fprintf(stream, "failed to write %s\n", path);
+	return ok;
+}
+
+bool open_material_index(struct MaterialIndex *index, const char *path, FILE *stream) {
+	*index = (struct MaterialIndex){0};
+
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		fprintf(stream, "failed to open %s\n", path);
+		if (fd >= 0) close(fd);
+		return false;
+	}
+
+	struct MaterialHeader header;
+	bool ok = (size_t)st.st_size >= sizeof header && pread(fd, &header, sizeof header, 0) == sizeof header
+	       && memcmp(header.magic, MAGIC, sizeof MAGIC) == 0
+	       && (size_t)st.st_size == sizeof header + (header.signature_count + 1) * sizeof(struct MaterialSignature)
+	                                + header.entry_count * sizeof(struct MaterialEntry);
+
+	if (!ok) {
+		fprintf(stream, "%s is not a material index\n", path);
+		close(fd);
+		return false;
+	}
+
+	void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+	// the mapping stays valid without the descriptor
+	close(fd);
+
+	if (data == MAP_FAILED) {
+		fprintf(stream, "failed to map %s\n", path);
+		return false;
+	}
+
+	const char *bytes = data;
+
+	index->data = data;
+	index->size = st.st_size;
+	index->signatures = (const struct MaterialSignature *)(bytes + sizeof header);
+	index->entries = (const struct MaterialEntry *)(index->signatures + header.signature_count + 1);
+	index->signature_count = header.signature_count;
+	index->entry_count = header.entry_count;
+	return true;
+}
+
+void close_material_index(struct MaterialIndex *index) {
+	if (index->data)
+		munmap((void *)index->data, index->size);
+
+	*index = (struct MaterialIndex){0};
+}
+
+// the first entry in [lo, hi) with a pawn key not below `pawns`
+static
+size_t lower_pawns(const struct MaterialEntry *entries, size_t lo, size_t hi, uint64_t pawns) {
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (entries[mid].pawns < pawns) lo = mid + 1;
+		else                            hi = mid;
+	}
+
+	return lo;
+}
+
+size_t query_material_index(const struct MaterialIndex *index, struct MaterialQuery query, uint64_t *records, size_t max) {
+	size_t lo = 0, hi = index->signature_count;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (index->signatures[mid].material < query.material) lo = mid + 1;
+		else                                                  hi = mid;
+	}
+
+	if (lo == index->signature_count || index->signatures[lo].material != query.material)
+		return 0;
+
+	size_t first = index->signatures[lo].first;
+	size_t last = index->signatures[lo + 1].first;
+
+	if (query.match_pawns) {
+		first = lower_pawns(index->entries, first, last, query.pawns);
+		last = (query.pawns == UINT64_MAX) ? last : lower_pawns(index->entries, first, last, query.pawns + 1);
+	}
+
+	size_t count = 0;
+
+	for (size_t i = first; i < last; i++) {
+		const struct MaterialEntry *entry = &index->entries[i];
+
+		if ((entry->features & query.features) == query.features) {
+			if (count < max) records[count] = entry->record;
+			count++;
+		}
+	}
+
+	return count;
+}
@@ -0,0 +1,73 @@
+#ifndef MATERIAL_H_
+#define MATERIAL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "position.h"
+
+// pawn structure features of the side to move (US) and of the other side
+enum PawnFeature {
+	PASSED_US     = 1 << 0,
+	PASSED_THEM   = 1 << 1,
+	ISOLATED_US   = 1 << 2,
+	ISOLATED_THEM = 1 << 3,
+	DOUBLED_US    = 1 << 4,
+	DOUBLED_THEM  = 1 << 5,
+};
+
+// hash of the pawns of both sides, relative to the side to move
+uint64_t pawn_key(struct Position pos);
+unsigned pawn_features(struct Position pos);
+
+// material signatures such as KRPvKR, side to move first (see material_key)
+bool parse_material(const char *signature, uint64_t *key, FILE *stream);
+size_t format_material(uint64_t key, char *buffer);
+
+// An index over a file of positions: the signatures in order, each with the
+// first of its entries, then the entries of all positions sorted by
+// signature, pawn key and record number, carrying the pawn features.
+struct MaterialSignature {
+	uint64_t material;
+	uint64_t first;
+};
+
+struct MaterialEntry {
+	uint64_t pawns;
+	uint64_t record;
+	uint64_t features;
+};
+
+// an index file mapped read-only
+struct MaterialIndex {
+	const void *data;
+	size_t size;
+
+	const struct MaterialSignature *signatures; // with a sentinel at the end
+	const struct MaterialEntry *entries;
+	uint64_t signature_count;
+	uint64_t entry_count;
+};
+
+bool build_material_index(const struct Position *positions, size_t length, const char *path, unsigned threads, FILE *stream);
+
+bool open_material_index(struct MaterialIndex *index, const char *path, FILE *stream);
+void close_material_index(struct MaterialIndex *index);
+
+// entries with the material, optionally the pawn key, and all the required
+// pawn features
+struct MaterialQuery {
+	uint64_t material;
+	uint64_t pawns;
+	bool match_pawns;
+	unsigned features;
+};
+
+// Finds the signature and pawn key by binary search and filters the entries
+// in between on their features. Returns the number of matches, writing the
+// record numbers of at most `max` of them.
+size_t query_material_index(const struct MaterialIndex *index, struct MaterialQuery query, uint64_t *records, size_t max);
+
+#endif /*MATERIAL_H_*/
@@ -0,0 +1,299 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bits.h"
+#include "material.h"
+#include "movegen.h"
+#include "position.h"
+#include "sort.h"
+#include "state.h"
+#include "text.h"
+#include "timer.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+enum { DEFAULT_QUERIES = 1000, MAX_PLIES = 400, SHOWN = 10, MAX_STATS = 20 };
+
+static const struct {
+	const char *name;
+	unsigned feature;
+} FEATURES[] = {
+	{ "passed", PASSED_US },
+	{ "their-passed", PASSED_THEM },
+	{ "isolated", ISOLATED_US },
+	{ "their-isolated", ISOLATED_THEM },
+	{ "doubled", DOUBLED_US },
+	{ "their-doubled", DOUBLED_THEM },
+};
+
+// positions of long random games, so that the later ones are endgames of all
+// kinds of material
+static
+void synthesize(const char *path, size_t count) {
+	FILE *file = fopen(path, "wb");
+
+	if (!file) {
+		fprintf(stderr, "failed to create %s\n", path);
+		return;
+	}
+
+	bool ok;
+	struct State start = parse_fen(STARTPOS, &ok, stderr);
+	struct Position pos = start.pos;
+	uint64_t seed = 0x9e3779b97f4a7c15;
+	unsigned ply = 0;
+
+	for (size_t i = 0; i < count && ok; i++) {
+		ok = fwrite(&pos, sizeof pos, 1, file) == 1;
+
+		struct MoveList list = generate_moves(pos);
+
+		if (list.length == 0 || insufficient_material(pos) || ++ply == MAX_PLIES) {
+			pos = start.pos;
+			ply = 0;
+			continue;
+		}
+
+		seed ^= seed >> 12, seed ^= seed << 25, seed ^= seed >> 27;
+		pos = make_move(pos, list.moves[(seed * 0x2545f4914f6cdd1d >> 32) % list.length]);
+	}
+
+	if (fclose(file) != 0 || !ok)
+		fprintf(stderr, "failed to write %s\n", path);
+}
+
+static
+void build(const char *positions, const char *path, unsigned threads) {
+	struct PositionFile file;
+
+	if (!open_position_file(&file, positions, stderr))
+		return;
+
+	double start = wall_time();
+
+	if (build_material_index(file.positions, file.length, path, threads, stderr)) {
+		struct MaterialIndex index;
+		double seconds = wall_time() - start;
+
+		if (open_material_index(&index, path, stderr)) {
+			printf("%zu positions, %llu signatures, %.3fs, %.0f positions/s\n", file.length,
+			       (unsigned long long)index.signature_count, seconds, file.length / seconds);
+			close_material_index(&index);
+		}
+	}
+
+	close_position_file(&file);
+}
+
+static
+void print_position(struct Position pos) {
+	struct State state = { .pos = pos, .side_to_move = turn(pos), .movenumber = 1 };
+	char buffer[128];
+
+	buffer[generate_fen(state, buffer)] = '\0';
+	printf("%s\n", buffer);
+}
+
+// a signature, or the signature and pawn structure of a fen, then features
+static
+bool parse_query(int argc, char **argv, struct MaterialQuery *query) {
+	*query = (struct MaterialQuery){0};
+
+	if (strchr(argv[0], '/')) {
+		bool ok;
+		struct State state = parse_fen(argv[0], &ok, stderr);
+		if (!ok) return false;
+
+		query->material = material_key(state.pos);
+		query->pawns = pawn_key(state.pos);
+		query->match_pawns = true;
+	}
+
+	else if (!parse_material(argv[0], &query->material, stderr)) {
+		return false;
+	}
+
+	for (int i = 1; i < argc; i++) {
+		size_t f = 0, count = sizeof FEATURES / sizeof *FEATURES;
+
+		while (f < count && strcmp(argv[i], FEATURES[f].name) != 0)
+			f++;
+
+		if (f == count) {
+			fprintf(stderr, "unknown pawn feature: %s\n", argv[i]);
+			return false;
+		}
+
+		query->features |= FEATURES[f].feature;
+	}
+
+	return true;
+}
+
+static
+void query(const struct PositionFile *file, const struct MaterialIndex *index, struct MaterialQuery query) {
+	uint64_t records[SHOWN];
+
+	double start = wall_time();
+	size_t count = query_material_index(index, query, records, SHOWN);
+	double seconds = wall_time() - start;
+
+	printf("%zu positions, %.1f us\n", count, seconds * 1e6);
+
+	for (size_t i = 0; i < count && i < SHOWN; i++) {
+		if (records[i] < file->length)
+			print_position(file->positions[records[i]]);
+	}
+}
+
+static
+void stats(const struct MaterialIndex *index) {
+	size_t shown[MAX_STATS] = {0}, length = 0;
+
+	// the most common signatures, by insertion into a short sorted list
+	for (size_t i = 0; i < index->signature_count; i++) {
+		uint64_t count = index->signatures[i + 1].first - index->signatures[i].first;
+		size_t j = (length < MAX_STATS) ? length++ : MAX_STATS;
+
+		for (; j > 0; j--) {
+			size_t other = shown[j - 1];
+			if (index->signatures[other + 1].first - index->signatures[other].first >= count) break;
+			if (j < MAX_STATS) shown[j] = other;
+		}
+
+		if (j < MAX_STATS) shown[j] = i;
+	}
+
+	printf("%llu positions, %llu signatures\n", (unsigned long long)index->entry_count,
+	       (unsigned long long)index->signature_count);
+
+	for (size_t i = 0; i < length; i++) {
+		const struct MaterialSignature *s = &index->signatures[shown[i]];
+		char buffer[80];
+
+		format_material(s->material, buffer);
+		printf("%-20s %llu\n", buffer, (unsigned long long)(s[1].first - s[0].first));
+	}
+}
+
+// Queries the signatures of random positions, alone and with a passed pawn,
+// reading every matching position as a caller would, against one scan of all
+// positions computing their signatures.
+static
+void bench(const struct PositionFile *file, const struct MaterialIndex *index, size_t queries) {
+	static uint64_t records[1 << 16];
+	uint64_t seed = 0x9e3779b97f4a7c15;
+
+	if (file->length == 0 || file->length != index->entry_count) {
+		fprintf(stderr, "the index does not match the positions\n");
+		return;
+	}
+
+	printf("query\t\t| queries\t| matches\t| touched\t| us/query\n");
+
+	for (int passed = 0; passed < 2; passed++) {
+		uint64_t matches = 0, touched = 0;
+		double start = wall_time();
+
+		for (size_t q = 0; q < queries; q++) {
+			seed ^= seed >> 12, seed ^= seed << 25, seed ^= seed >> 27;
+			struct Position pos = file->positions[(seed * 0x2545f4914f6cdd1d >> 16) % file->length];
+
+			struct MaterialQuery query = {
+				.material = material_key(pos),
+				.features = passed ? PASSED_US : 0,
+			};
+
+			size_t count = query_material_index(index, query, records, sizeof records / sizeof *records);
+			size_t read = (count < sizeof records / sizeof *records) ? count : sizeof records / sizeof *records;
+
+			for (size_t i = 0; i < read; i++)
+				touched += material_key(file->positions[records[i]]) == query.material;
+
+			matches += count;
+		}
+
+		double seconds = wall_time() - start;
+
+		printf("%s\t| %zu\t\t| %llu\t| %llu\t| %.1f\n", passed ? "passed\t" : "signature", queries,
+		       (unsigned long long)matches, (unsigned long long)touched, seconds / queries * 1e6);
+	}
+
+	uint64_t counted = 0;
+	double start = wall_time();
+
+	for (size_t i = 0; i < file->length; i++)
+		counted += material_key(file->positions[i]) == material_key(file->positions[0]);
+
+	printf("full scan\t| 1\t\t| %llu\t| %zu\t| %.1f\n", (unsigned long long)counted, file->length,
+	       (wall_time() - start) * 1e6);
+}
+
+int main(int argc, char **argv) {
+	init_bitbase();
+
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned default_threads = (cores > 0) ? cores : 1;
+
+	// uchess-material synth <positions> <count>
+	if (argc > 3 && strcmp(argv[1], "synth") == 0) {
+		synthesize(argv[2], strtoull(argv[3], NULL, 10));
+		return 0;
+	}
+
+	// uchess-material build <positions> <index> [threads]
+	if (argc > 3 && strcmp(argv[1], "build") == 0) {
+		build(argv[2], argv[3], (argc > 4) ? (unsigned)atoi(argv[4]) : default_threads);
+		return 0;
+	}
+
+	struct PositionFile file = {0};
+	struct MaterialIndex index;
+	bool stats_only = argc > 2 && strcmp(argv[1], "stats") == 0;
+
+	if (stats_only) {
+		if (!open_material_index(&index, argv[2], stderr))
+			return 1;
+
+		stats(&index);
+		close_material_index(&index);
+		return 0;
+	}
+
+	if (argc < 4 || (strcmp(argv[1], "query") != 0 && strcmp(argv[1], "bench") != 0)) {
+		fprintf(stderr, "usage: uchess-material synth <positions> <count>\n"
+		                "       uchess-material build <positions> <index> [threads]\n"
+		                "       uchess-material query <positions> <index> <signature | fen> [feature...]\n"
+		                "       uchess-material stats <index>\n"
+		                "       uchess-material bench <positions> <index> [queries]\n");
+		return 1;
+	}
+
+	if (!open_position_file(&file, argv[2], stderr))
+		return 1;
+
+	if (!open_material_index(&index, argv[3], stderr)) {
+		close_position_file(&file);
+		return 1;
+	}
+
+	// uchess-material query <positions> <index> <signature | fen> [feature...]
+	if (strcmp(argv[1], "query") == 0) {
+		struct MaterialQuery q;
+
+		if (argc > 4 && parse_query(argc - 4, argv + 4, &q))
+			query(&file, &index, q);
+	}
+
+	// uchess-material bench <positions> <index> [queries]
+	else {
+		bench(&file, &index, (argc > 4) ? strtoull(argv[4], NULL, 10) : DEFAULT_QUERIES);
+	}
+
+	close_material_index(&index);
+	close_position_file(&file);
+	return 0;
+}
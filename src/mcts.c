@@ -0,0 +1,306 @@
+#include "mcts.h"
+
+#include "bits.h"
+#include "movegen.h"
+#include "position.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+enum NodeState { UNEXPANDED, EXPANDING, EXPANDED, TERMINAL };
+
+// exploration constant of UCT, for scores in [0, 1]
+static const double EXPLORATION = 1.4;
+
+static inline
+uint64_t next_random(uint64_t *seed) {
+	// xorshift64*
+	*seed ^= *seed >> 12;
+	*seed ^= *seed << 25;
+	*seed ^= *seed >> 27;
+	return *seed * 0x2545f4914f6cdd1d;
+}
+
+// the index-th move of the set, without expanding the set into a list:
+// pawns on the 7th rank count each destination once per promotion piece
+static inline
+struct Move nth_move(const struct MoveSet *set, size_t index) {
+	for (size_t i = 0;; i++) {
+		const struct PieceMoves *moves = &set->pieces[i];
+		size_t promotions = (moves->promotion != None) ? 4 : 1;
+		size_t count = popcount(moves->targets) * promotions;
+
+		if (index >= count) {
+			index -= count;
+			continue;
+		}
+
+		square dst = lsb(pdep(1ULL << (index / promotions), moves->targets));
+		uint8_t piece = (promotions == 4) ? Knight + index % 4 : moves->piece;
+		bool castling = moves->piece == King && ((set->castling >> dst) & 1);
+
+		return (struct Move){ moves->start, dst, piece, castling };
+	}
+}
+
+static inline
+bool is_irreversible(struct Position pos, struct Move move) {
+	return ((occupied(pos) >> move.end) & 1) || get_piece(pos, move.start) == Pawn;
+}
+
+enum Outcome terminal_outcome(struct Position pos, const struct MoveSet *set, unsigned fifty) {
+	if (!has_moves(set))
+		return enemy_checks(pos) ? LOSS : DRAW;
+
+	if (fifty >= 100 || insufficient_material(pos))
+		return DRAW;
+
+	return ONGOING;
+}
+
+enum Outcome random_playout(struct Position pos, unsigned fifty, uint64_t *seed) {
+	bool flipped = false; // whether the side to move differs from the start
+
+	for (unsigned ply = 0; ply < MAX_PLAYOUT_PLIES; ply++) {
+		struct MoveSet set = generate_move_set(pos);
+		enum Outcome outcome = terminal_outcome(pos, &set, fifty);
+
+		if (outcome != ONGOING)
+			return flipped ? WIN - outcome : outcome;
+
+		// multiply-shift maps a random word onto [0, count) without division
+		size_t count = count_moves(&set);
+		size_t index = ((next_random(seed) >> 32) * count) >> 32;
+		struct Move move = nth_move(&set, index);
+
+		fifty = is_irreversible(pos, move) ? 0 : fifty + 1;
+		pos = make_move(pos, move);
+		flipped = !flipped;
+	}
+
+	return DRAW;
+}
+
+
+// tree
+
+bool init_mcts(struct MCTS *tree, size_t capacity) {
+	tree->nodes = malloc(capacity * sizeof *tree->nodes);
+	tree->capacity = capacity;
+	tree->length = 0;
+
+	return tree->nodes != NULL;
+}
+
+void free_mcts(struct MCTS *tree) {
+	free(tree->nodes);
+	tree->nodes = NULL;
+}
+
+void reset_mcts(struct MCTS *tree, struct State root) {
+	tree->root = root.pos;
+	tree->fifty = root.fify_move_clock;
+	tree->nodes[0] = (struct MCTSNode){ .state = UNEXPANDED };
+	tree->length = 1;
+}
+
+// generates the children of a node, or marks it terminal; returns false if
+// the arena is full, in which case the node stays a leaf
+static
+bool expand(struct MCTS *tree, struct MCTSNode *node, struct Position pos, unsigned fifty) {
+	struct MoveSet set = generate_move_set(pos);
+	enum Outcome outcome = terminal_outcome(pos, &set, fifty);
+
+	if (outcome != ONGOING) {
+		node->outcome = outcome;
+		__atomic_store_n(&node->state, TERMINAL, __ATOMIC_RELEASE);
+		return true;
+	}
+
+	size_t count = count_moves(&set);
+	size_t first = __atomic_fetch_add(&tree->length, count, __ATOMIC_RELAXED);
+
+	if (first + count > tree->capacity) {
+		__atomic_store_n(&node->state, UNEXPANDED, __ATOMIC_RELEASE);
+		return false;
+	}
+
+	struct MCTSNode *children = &tree->nodes[first];
+	struct Move move;
+
+	for (size_t i = 0; pop_move(&set, &move); i++) {
+		children[i] = (struct MCTSNode){ .move = move, .state = UNEXPANDED };
+	}
+
+	node->first = first;
+	node->children = count;
+	__atomic_store_n(&node->state, EXPANDED, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+static inline
+struct MCTSNode *select_child(struct MCTS *tree, struct MCTSNode *node) {
+	struct MCTSNode *children = &tree->nodes[node->first];
+	struct MCTSNode *best = &children[0];
+	double best_value = -1;
+
+	double log_visits = log(__atomic_load_n(&node->visits, __ATOMIC_RELAXED) + 1);
+
+	for (size_t i = 0; i < node->children; i++) {
+		uint32_t visits = __atomic_load_n(&children[i].visits, __ATOMIC_RELAXED);
+		uint32_t score = __atomic_load_n(&children[i].score, __ATOMIC_RELAXED);
+
+		// visit every child once before exploiting
+		if (visits == 0)
+			return &children[i];
+
+		double value = 0.5 * score / visits + EXPLORATION * sqrt(log_visits / visits);
+
+		if (value > best_value) {
+			best_value = value;
+			best = &children[i];
+		}
+	}
+
+	return best;
+}
+
+static
+void iterate(struct MCTS *tree, uint64_t *seed) {
+	struct MCTSNode *path[MAX_PLAYOUT_PLIES + 1];
+	size_t length = 0;
+
+	struct Position pos = tree->root;
+	unsigned fifty = tree->fifty;
+	struct MCTSNode *node = &tree->nodes[0];
+
+	enum Outcome outcome = DRAW;
+
+	for (;;) {
+		// virtual loss: count the visit now and add the result later
+		__atomic_fetch_add(&node->visits, 1, __ATOMIC_RELAXED);
+		path[length++] = node;
+
+		uint8_t state = __atomic_load_n(&node->state, __ATOMIC_ACQUIRE);
+
+		if (state == TERMINAL) {
+			outcome = node->outcome;
+			break;
+		}
+
+		if (state == UNEXPANDED) {
+			uint8_t expected = UNEXPANDED;
+
+			if (__atomic_compare_exchange_n(&node->state, &expected, EXPANDING, false,
+			                                __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+				expand(tree, node, pos, fifty);
+
+			state = __atomic_load_n(&node->state, __ATOMIC_ACQUIRE);
+
+			if (state == TERMINAL) {
+				outcome = node->outcome;
+				break;
+			}
+
+			// evaluate new leaves with a playout before descending further
+			outcome = random_playout(pos, fifty, seed);
+			break;
+		}
+
+		if (state == EXPANDING || length == MAX_PLAYOUT_PLIES) {
+			outcome = random_playout(pos, fifty, seed);
+			break;
+		}
+
+		node = select_child(tree, node);
+		fifty = is_irreversible(pos, node->move) ? 0 : fifty + 1;
+		pos = make_move(pos, node->move);
+	}
+
+	// outcome is for the side to move at the leaf, each node is scored for
+	// the side that moved into it
+	uint32_t result = WIN - outcome;
+
+	while (length--) {
+		__atomic_fetch_add(&path[length]->score, result, __ATOMIC_RELAXED);
+		result = WIN - result;
+	}
+}
+
+struct Worker {
+	struct MCTS *tree;
+	int64_t *remaining;
+	uint64_t seed;
+	uint64_t playouts;
+};
+
+static
+void *run_worker(void *arg) {
+	struct Worker *w = arg;
+
+	while (__atomic_fetch_sub(w->remaining, 1, __ATOMIC_RELAXED) > 0) {
+		iterate(w->tree, &w->seed);
+		w->playouts++;
+	}
+
+	return NULL;
+}
+
+uint64_t mcts_search(struct MCTS *tree, uint64_t playouts, unsigned threads) {
+	if (threads < 1) threads = 1;
+	if (threads > MCTS_MAX_THREADS) threads = MCTS_MAX_THREADS;
+
+	// each thread claims playouts until the shared count runs out
+	int64_t remaining = playouts;
+
+	struct Worker workers[MCTS_MAX_THREADS];
+	pthread_t handles[MCTS_MAX_THREADS];
+
+	for (unsigned i = 0; i < threads; i++) {
+		workers[i] = (struct Worker){
+			.tree = tree,
+			.remaining = &remaining,
+			.seed = 0x9e3779b97f4a7c15 * (i + 1) ^ hash_position(tree->root),
+		};
+	}
+
+	// the playouts are shared, so the threads that started do them all
+	unsigned started = 1;
+
+	while (started < threads && pthread_create(&handles[started], NULL, run_worker, &workers[started]) == 0) {
+		started++;
+	}
+
+	run_worker(&workers[0]);
+
+	uint64_t total = workers[0].playouts;
+
+	for (unsigned i = 1; i < started; i++) {
+		pthread_join(handles[i], NULL);
+		total += workers[i].playouts;
+	}
+
+	return total;
+}
+
+struct Move mcts_best_move(const struct MCTS *tree) {
+	const struct MCTSNode *root = &tree->nodes[0];
+	struct Move best = {0};
+	uint32_t best_visits = 0;
+
+	if (root->state != EXPANDED)
+		return best;
+
+	for (size_t i = 0; i < root->children; i++) {
+		const struct MCTSNode *child = &tree->nodes[root->first + i];
+
+		if (child->visits > best_visits) {
+			best_visits = child->visits;
+			best = child->move;
+		}
+	}
+
+	return best;
+}
@@ -0,0 +1,63 @@
+#ifndef MCTS_H_
+#define MCTS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "movegen.h"
+#include "position.h"
+#include "state.h"
+
+#define MCTS_MAX_THREADS 256
+#define MAX_PLAYOUT_PLIES 512
+
+// results in half points, from the point of view of the side to move
+enum Outcome { LOSS = 0, DRAW = 1, WIN = 2, ONGOING = 3 };
+
+// Nodes live in one preallocated arena and the children of a node are
+// allocated as a contiguous block, so a tree is freed or reset in O(1).
+//
+// Threads share the tree without locks: visits are added on the way down
+// (a virtual loss, steering other threads to different lines until the
+// playout result arrives) and results are added on the way back up.
+struct MCTSNode {
+	struct Move move;  // move leading to this node
+	uint8_t state;     // UNEXPANDED, EXPANDING, EXPANDED or TERMINAL
+	uint8_t outcome;   // for terminal nodes, for the side to move
+	uint16_t children; // number of children
+	uint32_t first;    // index of the first child
+
+	uint32_t visits;
+	uint32_t score;    // half points for the side that played `move`
+};
+
+struct MCTS {
+	struct MCTSNode *nodes;
+	size_t capacity;
+	size_t length;
+
+	struct Position root;
+	unsigned fifty; // fifty move clock at the root
+};
+
+bool init_mcts(struct MCTS *tree, size_t capacity);
+void free_mcts(struct MCTS *tree);
+void reset_mcts(struct MCTS *tree, struct State root);
+
+// runs `playouts` select/expand/playout/backpropagate iterations over
+// `threads` threads, returning the number of playouts run
+uint64_t mcts_search(struct MCTS *tree, uint64_t playouts, unsigned threads);
+
+// most visited move at the root, or a zero move if there is none
+struct Move mcts_best_move(const struct MCTS *tree);
+
+// plays uniformly random legal moves until the game ends, returning the result
+// for the side to move in `pos`; games are adjudicated as draws after
+// MAX_PLAYOUT_PLIES plies
+enum Outcome random_playout(struct Position pos, unsigned fifty, uint64_t *seed);
+
+// mate, stalemate, the fifty move rule or insufficient material, else ONGOING
+enum Outcome terminal_outcome(struct Position pos, const struct MoveSet *set, unsigned fifty);
+
+#endif /*MCTS_H_*/
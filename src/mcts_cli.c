@@ -0,0 +1,131 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bits.h"
+#include "mcts.h"
+#include "movegen.h"
+#include "position.h"
+#include "state.h"
+#include "text.h"
+#include "timer.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+enum { DEFAULT_NODES = 1 << 22, DEFAULT_PLAYOUTS = 100000 };
+
+// playouts/sec of the bare kernel and of the tree search by thread count
+
+static
+void bench(struct MCTS *tree, uint64_t playouts, unsigned max_threads) {
+	int count = PERFT_POSITIONS;
+
+	printf("position\t| kernel playouts/s\n");
+
+	for (int i = 0; i < count; i++) {
+		bool ok;
+		struct State state = parse_fen(perft_positions[i], &ok, stderr);
+		uint64_t seed = 0x9e3779b97f4a7c15;
+
+		double start = wall_time();
+
+		for (uint64_t n = 0; n < playouts; n++) {
+			random_playout(state.pos, state.fify_move_clock, &seed);
+		}
+
+		printf("%d\t\t| %.0f\n", i + 1, playouts / (wall_time() - start));
+	}
+
+	printf("\nthreads\t| position\t| playouts/s\t| per core\t| nodes\n");
+
+	// doubling, with max_threads as the last row
+	for (unsigned threads = 1; threads <= max_threads;
+	     threads = (threads < max_threads && 2 * threads > max_threads) ? max_threads : 2 * threads) {
+		double total_seconds = 0;
+
+		for (int i = 0; i < count; i++) {
+			bool ok;
+			struct State state = parse_fen(perft_positions[i], &ok, stderr);
+
+			reset_mcts(tree, state);
+
+			double start = wall_time();
+			uint64_t done = mcts_search(tree, playouts, threads);
+			double seconds = wall_time() - start;
+
+			printf("%u\t| %d\t\t| %-10.0f\t| %-10.0f\t| %zu\n", threads, i + 1, done / seconds,
+			       done / seconds / threads, tree->length < tree->capacity ? tree->length : tree->capacity);
+
+			total_seconds += seconds;
+		}
+
+		printf("%u\t| total\t\t| %-10.0f\t| %-10.0f\t|\n\n", threads, count * playouts / total_seconds,
+		       count * playouts / total_seconds / threads);
+
+		fflush(stdout);
+	}
+}
+
+int main(int argc, char **argv) {
+	init_bitbase();
+
+	struct MCTS tree;
+
+	if (!init_mcts(&tree, DEFAULT_NODES)) {
+		fprintf(stderr, "failed to allocate the node arena\n");
+		return 1;
+	}
+
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned default_threads = cores > 0 ? cores : 1;
+
+	// uchess-mcts bench [playouts] [max threads]
+	if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+		uint64_t playouts = (argc > 2) ? strtoull(argv[2], NULL, 10) : DEFAULT_PLAYOUTS;
+		unsigned max_threads = (argc > 3) ? (unsigned)atoi(argv[3]) : default_threads;
+
+		bench(&tree, playouts, max_threads);
+	}
+
+	// uchess-mcts [fen] [playouts] [threads]
+	else {
+		bool ok;
+		struct State state = parse_fen((argc > 1) ? argv[1] : STARTPOS, &ok, stderr);
+
+		if (!ok) {
+			free_mcts(&tree);
+			return 1;
+		}
+
+		uint64_t playouts = (argc > 2) ? strtoull(argv[2], NULL, 10) : DEFAULT_PLAYOUTS;
+		unsigned threads = (argc > 3) ? (unsigned)atoi(argv[3]) : default_threads;
+
+		reset_mcts(&tree, state);
+
+		double start = wall_time();
+		uint64_t done = mcts_search(&tree, playouts, threads);
+		double seconds = wall_time() - start;
+
+		struct MCTSNode *root = &tree.nodes[0];
+
+		for (size_t i = 0; i < root->children; i++) {
+			struct MCTSNode *child = &tree.nodes[root->first + i];
+			char buffer[8];
+
+			buffer[generate_uci(child->move, state, buffer)] = '\0';
+			printf("%-6s %10u visits %6.1f%%\n", buffer, child->visits,
+			       child->visits ? 50.0 * child->score / child->visits : 0.0);
+		}
+
+		char buffer[8];
+		buffer[generate_uci(mcts_best_move(&tree), state, buffer)] = '\0';
+
+		printf("bestmove %s (%llu playouts, %.0f playouts/s)\n", buffer,
+		       (unsigned long long)done, done / seconds);
+	}
+
+	free_mcts(&tree);
+	return 0;
+}
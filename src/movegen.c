@@ -10,30 +10,19 @@ void append(struct MoveList *list, struct Move move) {
 	list->moves[list->length++] = move;
 }
 
-static inline bitboard line_between(bitboard a, bitboard b) {
-	assert(a && b && "bitboards must be populated");
+// all functions below take the color `c` of the side to move, which is always
+// WHITE in the rotated representation, and are specialised per color
 
-	square sqa = lsb(a);
-	square sqb = lsb(b);
+static always_inline
+bitboard enemy_attacks_for(struct Position pos, enum Color c) {
+	bitboard them = side(pos, !c);
 
-	bitboard diag = bishop_attacks(sqa, b);
-	bitboard orth = rook_attacks(sqa, b);
-
-	bitboard line = 0;
-	if (diag & b) line |= bishop_attacks(sqb, a) & diag;
-	if (orth & b) line |= rook_attacks(sqb, a) & orth;
-
-	return line;
-}
-
-static inline
-bitboard enemy_attacks(struct Position pos) {
-	bitboard pawns   = extract(pos, Pawn)   & ~pos.white;
-	bitboard knights = extract(pos, Knight) & ~pos.white;
-	bitboard bishops = extract(pos, Bishop) & ~pos.white;
-	bitboard rooks   = extract(pos, Rook)   & ~pos.white;
-	bitboard queens  = extract(pos, Queen)  & ~pos.white;
-	bitboard king    = extract(pos, King)   & ~pos.white;
+	bitboard pawns   = extract(pos, Pawn)   & them;
+	bitboard knights = extract(pos, Knight) & them;
+	bitboard bishops = extract(pos, Bishop) & them;
+	bitboard rooks   = extract(pos, Rook)   & them;
+	bitboard queens  = extract(pos, Queen)  & them;
+	bitboard king    = extract(pos, King)   & them;
 
 	bishops |= queens;
 	rooks |= queens;
@@ -41,11 +30,10 @@ bitboard enemy_attacks(struct Position pos) {
 	bitboard attacks = 0;
 	bitboard occ = occupied(pos);
 
-	bitboard our_king = extract(pos, King) & pos.white;
+	bitboard our_king = extract(pos, King) & ~them;
 	occ &= ~our_king; // allow sliders to move through our king
 
-	attacks |= shift(S,E, pawns);
-	attacks |= shift(S,W, pawns);
+	attacks |= pawn_attacks(!c, pawns);
 
 	while (knights) {
 		attacks |= knight_attacks(lsb(knights));
@@ -66,21 +54,23 @@ bitboard enemy_attacks(struct Position pos) {
 	return attacks;
 }
 
-bitboard enemy_checks(struct Position pos) {
-	bitboard king = extract(pos, King) & pos.white;
+static always_inline
+bitboard enemy_checks_for(struct Position pos, enum Color c) {
+	bitboard them = side(pos, !c);
+	bitboard king = extract(pos, King) & ~them;
 	square sq = lsb(king);
 
 	bitboard occ = occupied(pos);
-	bitboard pawns   = extract(pos, Pawn)   & ~pos.white;
-	bitboard knights = extract(pos, Knight) & ~pos.white;
-	bitboard bishops = extract(pos, Bishop) & ~pos.white;
-	bitboard rooks   = extract(pos, Rook)   & ~pos.white;
-	bitboard queens  = extract(pos, Queen)  & ~pos.white;
+	bitboard pawns   = extract(pos, Pawn)   & them;
+	bitboard knights = extract(pos, Knight) & them;
+	bitboard bishops = extract(pos, Bishop) & them;
+	bitboard rooks   = extract(pos, Rook)   & them;
+	bitboard queens  = extract(pos, Queen)  & them;
 
 	bishops |= queens;
 	rooks |= queens;
 
-	pawns   &= shift(N,E, king) | shift(N,W, king);
+	pawns   &= pawn_attacks(c, king);
 	knights &= knight_attacks(sq);
 	bishops &= bishop_attacks(sq, occ);
 	rooks   &= rook_attacks(sq, occ);
@@ -88,9 +78,27 @@ bitboard enemy_checks(struct Position pos) {
 	return pawns | knights | bishops | rooks;
 }
 
-static inline
-void generate_partial_moves(struct Position pos, enum PieceType T, bitboard targets, struct MoveList *list) {
-	bitboard pieces = extract(pos, T) & pos.white;
+bitboard enemy_attacks(struct Position pos) {
+#ifdef ABSOLUTE_COLORS
+	if (turn(pos) == BLACK)
+		return enemy_attacks_for(pos, BLACK);
+#endif
+
+	return enemy_attacks_for(pos, WHITE);
+}
+
+bitboard enemy_checks(struct Position pos) {
+#ifdef ABSOLUTE_COLORS
+	if (turn(pos) == BLACK)
+		return enemy_checks_for(pos, BLACK);
+#endif
+
+	return enemy_checks_for(pos, WHITE);
+}
+
+static always_inline
+void generate_partial_moves(struct Position pos, enum Color c, enum PieceType T, bitboard targets, struct MoveList *list) {
+	bitboard pieces = extract(pos, T) & side(pos, c);
 	bitboard occ = occupied(pos);
 
 	while (pieces) {
@@ -106,11 +114,13 @@ void generate_partial_moves(struct Position pos, enum PieceType T, bitboard targ
 	}
 }
 
-static inline
-void generate_king_moves(struct Position pos, struct MoveList *list) {
-	square sq = lsb(extract(pos, King) & pos.white);
-	bitboard attacked = enemy_attacks(pos);
-	bitboard attacks = king_attacks(sq) & ~attacked & ~pos.white;
+static always_inline
+void generate_king_moves(struct Position pos, enum Color c, bool castling, bitboard info, struct MoveList *list) {
+	bitboard us = side(pos, c);
+
+	square sq = lsb(extract(pos, King) & us);
+	bitboard attacked = enemy_attacks_for(pos, c);
+	bitboard attacks = king_attacks(sq) & ~attacked & ~us;
 
 	while (attacks) {
 		square dst = lsb(attacks);
@@ -118,30 +128,30 @@ void generate_king_moves(struct Position pos, struct MoveList *list) {
 		attacks &= attacks - 1;
 	}
 
+	if (!castling)
+		return;
+
 	// generate castling moves
 	bitboard occ = occupied(pos);
 
-	bitboard info = extract(pos, Info);
-	info = pext(info, ~occ);
-
-	bitboard kingside_occ  = 0b01100000;
-	bitboard queenside_occ = 0b00001110;
-	bitboard kingside_attacked  = 0b01110000;
-	bitboard queenside_attacked = 0b00011100;
+	bitboard kingside_occ  = relative(c, 0b01100000);
+	bitboard queenside_occ = relative(c, 0b00001110);
+	bitboard kingside_attacked  = relative(c, 0b01110000);
+	bitboard queenside_attacked = relative(c, 0b00011100);
 
 	enum { C1 = 2, E1 = 4, G1 = 6 };
 
-	if ((info & WK_MASK) && !(occ & kingside_occ) && !(attacked & kingside_attacked)) {
-		append(list, (struct Move){ E1, G1, King, 1 });
+	if ((info & kingside(c)) && !(occ & kingside_occ) && !(attacked & kingside_attacked)) {
+		append(list, (struct Move){ relative_square(c, E1), relative_square(c, G1), King, 1 });
 	}
 
-	if ((info & WQ_MASK) && !(occ & queenside_occ) && !(attacked & queenside_attacked)) {
-		append(list, (struct Move){ E1, C1, King, 1 });
+	if ((info & queenside(c)) && !(occ & queenside_occ) && !(attacked & queenside_attacked)) {
+		append(list, (struct Move){ relative_square(c, E1), relative_square(c, C1), King, 1 });
 	}
 }
 
-static inline
-void append_pawn_moves(bitboard mask, square shift, bool promotion, struct MoveList *list) {
+static always_inline
+void append_pawn_moves(bitboard mask, int shift, bool promotion, struct MoveList *list) {
 	while (mask) {
 		square dst = lsb(mask);
 		square sq = dst - shift;
@@ -159,62 +169,57 @@ void append_pawn_moves(bitboard mask, square shift, bool promotion, struct MoveL
 	}
 }
 
-static inline
-void generate_pawn_moves(struct Position pos, bitboard targets, struct MoveList *list) {
-	bitboard pawns = extract(pos, Pawn) & pos.white;
+static always_inline
+void generate_pawn_moves(struct Position pos, enum Color c, bitboard targets, bitboard en_passant, struct MoveList *list) {
+	bitboard us = side(pos, c);
+	bitboard pawns = extract(pos, Pawn) & us;
 
 	bitboard occ = occupied(pos);
-	bitboard them = occ & ~pos.white;
-
-	bitboard info = extract(pos, Info);
-	info = pext(info, ~occ);
+	bitboard them = occ & ~us;
 
-	bitboard en_passant = (info & EP_MASK) << 40;
-
-	targets |= shift(N, targets) & en_passant;
+	targets |= forward(c, targets) & en_passant;
 	them |= en_passant;
 
-	bitboard single_up = shift(N, pawns) & ~occ;
-	bitboard double_up = shift(N, single_up & RANK3) & ~occ;
+	bitboard single_up = forward(c, pawns) & ~occ;
+	bitboard double_up = forward(c, single_up & relative(c, RANK3)) & ~occ;
 
 	// mask with targets after to allow double move
 	single_up &= targets;
 	double_up &= targets;
 
-	bitboard east_captures = shift(N,E, pawns) & them & targets;
-	bitboard west_captures = shift(N,W, pawns) & them & targets;
+	bitboard east_captures = forward(c, shift(E, pawns)) & them & targets;
+	bitboard west_captures = forward(c, shift(W, pawns)) & them & targets;
+
+	bitboard last_rank = relative(c, RANK8);
+	int up = (c == WHITE) ? N : S;
 
 	// promotions
-	append_pawn_moves(single_up & RANK8, N, true, list);
-	append_pawn_moves(east_captures & RANK8, N+E, true, list);
-	append_pawn_moves(west_captures & RANK8, N+W, true, list);
+	append_pawn_moves(single_up & last_rank, up, true, list);
+	append_pawn_moves(east_captures & last_rank, up+E, true, list);
+	append_pawn_moves(west_captures & last_rank, up+W, true, list);
 
 	// non promotions
-	append_pawn_moves(double_up, N+N, false, list);
-	append_pawn_moves(single_up & ~RANK8, N, false, list);
-	append_pawn_moves(east_captures & ~RANK8, N+E, false, list);
-	append_pawn_moves(west_captures & ~RANK8, N+W, false, list);
+	append_pawn_moves(double_up, up+up, false, list);
+	append_pawn_moves(single_up & ~last_rank, up, false, list);
+	append_pawn_moves(east_captures & ~last_rank, up+E, false, list);
+	append_pawn_moves(west_captures & ~last_rank, up+W, false, list);
 }
 
-static inline
-void filter_pinned_moves(struct Position pos, struct MoveList *list) {
-	square ksq = lsb(extract(pos, King) & pos.white);
-	bitboard candidates = queen_attacks(ksq, pos.white) & pos.white;
+static always_inline
+void filter_pinned_moves(struct Position pos, enum Color c, bitboard en_passant, struct MoveList *list) {
+	bitboard us = side(pos, c);
+
+	square ksq = lsb(extract(pos, King) & us);
+	bitboard candidates = queen_attacks(ksq, us) & us;
 
 	bitboard occ = occupied(pos);
-	bitboard bishops = extract(pos, Bishop) & ~pos.white;
-	bitboard rooks   = extract(pos, Rook)   & ~pos.white;
-	bitboard queens  = extract(pos, Queen)  & ~pos.white;
+	bitboard bishops = extract(pos, Bishop) & ~us;
+	bitboard rooks   = extract(pos, Rook)   & ~us;
+	bitboard queens  = extract(pos, Queen)  & ~us;
 
 	bishops |= queens;
 	rooks |= queens;
 
-	bitboard info = extract(pos, Info);
-	info = pext(info, ~occ);
-
-	// always check en_passant for possible pins
-	bitboard en_passant = (info & EP_MASK) << 40;
-
 	// reset length to zero
 	size_t length = list->length;
 	list->length = 0;
@@ -225,8 +230,9 @@ void filter_pinned_moves(struct Position pos, struct MoveList *list) {
 		bitboard dst = 1ULL << move.end;
 
 		// remove captured en passant pawn from occupancy
+		// note: always check en_passant for possible pins
 		if (move.piece == Pawn) {
-			mask |= shift(S, dst & en_passant);
+			mask |= backward(c, dst & en_passant);
 		}
 
 		if (mask & candidates) {
@@ -241,30 +247,390 @@ void filter_pinned_moves(struct Position pos, struct MoveList *list) {
 	}
 }
 
-struct MoveList generate_moves(struct Position pos) {
+// `check`, `ep` and `castling` are compile-time constants in each variant, so
+// the work for impossible cases (e.g. castling in check) is removed entirely
+static always_inline
+struct MoveList generate_variant(struct Position pos, enum Color c, enum CheckState check, bool ep, bool castling,
+                                 bitboard checkers, bitboard info) {
 	struct MoveList list = {.length = 0};
 
-	bitboard checkers = enemy_checks(pos);
-	bitboard king = extract(pos, King) & pos.white;
+	// if more than 1 check we can only move the king
+	if (check == DOUBLE_CHECK)
+		goto king_moves;
+
+	bitboard targets = ~side(pos, c);
+
+	if (check == SINGLE_CHECK) {
+		bitboard king = extract(pos, King) & side(pos, c);
+		targets &= checkers | line_between(king, checkers);
+	}
+
+	bitboard en_passant = ep ? relative(c, (info & EP_MASK) << 40) : 0;
+
+	generate_pawn_moves(pos, c, targets, en_passant, &list);
+	generate_partial_moves(pos, c, Knight, targets, &list);
+	generate_partial_moves(pos, c, Bishop, targets, &list);
+	generate_partial_moves(pos, c, Rook,   targets, &list);
+	generate_partial_moves(pos, c, Queen,  targets, &list);
+	filter_pinned_moves(pos, c, en_passant, &list);
+
+king_moves:
+	generate_king_moves(pos, c, castling, info, &list);
+	return list;
+}
+
+static always_inline
+enum MovegenVariant classify(enum Color c, bitboard checkers, bitboard info) {
+	if (checkers & (checkers - 1))
+		return DOUBLE_CHECK_MOVES;
+
+	bool ep = info & EP_MASK;
+	bool castling = info & (kingside(c) | queenside(c));
+
+	if (checkers)
+		return ep ? SINGLE_CHECK_EP_MOVES : SINGLE_CHECK_MOVES;
+
+	return NO_CHECK_MOVES + 2*ep + castling;
+}
+
+// single runtime-checked variant, for comparing against the specialised ones
+static always_inline
+struct MoveList generate_generic_moves_for(struct Position pos, enum Color c) {
+	bitboard checkers = enemy_checks_for(pos, c);
+	bitboard info = extract_info(pos);
+
+	enum CheckState check = (checkers & (checkers - 1)) ? DOUBLE_CHECK
+	                      : checkers ? SINGLE_CHECK : NO_CHECK;
+
+	return generate_variant(pos, c, check, true, true, checkers, info);
+}
+
+static always_inline
+struct MoveList generate_moves_for(struct Position pos, enum Color c) {
+#ifdef GENERIC_MOVEGEN
+	return generate_generic_moves_for(pos, c);
+#else
+	bitboard checkers = enemy_checks_for(pos, c);
+	bitboard info = extract_info(pos);
+
+	switch (classify(c, checkers, info)) {
+		case DOUBLE_CHECK_MOVES:
+			return generate_variant(pos, c, DOUBLE_CHECK, false, false, checkers, info);
+		case SINGLE_CHECK_MOVES:
+			return generate_variant(pos, c, SINGLE_CHECK, false, false, checkers, info);
+		case SINGLE_CHECK_EP_MOVES:
+			return generate_variant(pos, c, SINGLE_CHECK, true, false, checkers, info);
+		case NO_CHECK_MOVES:
+			return generate_variant(pos, c, NO_CHECK, false, false, checkers, info);
+		case NO_CHECK_CASTLING_MOVES:
+			return generate_variant(pos, c, NO_CHECK, false, true, checkers, info);
+		case NO_CHECK_EP_MOVES:
+			return generate_variant(pos, c, NO_CHECK, true, false, checkers, info);
+		case NO_CHECK_EP_CASTLING_MOVES:
+			return generate_variant(pos, c, NO_CHECK, true, true, checkers, info);
+		default:
+			assert(0 && "unreachable");
+			return (struct MoveList){0};
+	}
+#endif
+}
+
+struct MoveList generate_moves(struct Position pos) {
+#ifdef ABSOLUTE_COLORS
+	if (turn(pos) == BLACK)
+		return generate_moves_for(pos, BLACK);
+#endif
+
+	return generate_moves_for(pos, WHITE);
+}
+
+struct MoveList generate_generic_moves(struct Position pos) {
+#ifdef ABSOLUTE_COLORS
+	if (turn(pos) == BLACK)
+		return generate_generic_moves_for(pos, BLACK);
+#endif
+
+	return generate_generic_moves_for(pos, WHITE);
+}
+
+enum MovegenVariant movegen_variant(struct Position pos) {
+	enum Color c = turn(pos);
+
+	bitboard checkers = (c == WHITE) ? enemy_checks_for(pos, WHITE)
+	                                 : enemy_checks_for(pos, BLACK);
+
+	return classify(c, checkers, extract_info(pos));
+}
+
+static always_inline
+void add_piece_moves(struct MoveSet *set, square sq, enum PieceType T, bitboard targets, bool promotion) {
+	if (targets) {
+		set->pieces[set->length++] = (struct PieceMoves){ sq, T, promotion ? Knight : None, targets };
+	}
+}
+
+static always_inline
+struct MoveSet generate_move_set_for(struct Position pos, enum Color c) {
+	struct MoveSet set = {.length = 0, .castling = 0};
+
+	bitboard us = side(pos, c);
+	bitboard occ = occupied(pos);
+	bitboard them = occ & ~us;
+
+	bitboard king = extract(pos, King) & us;
+	square ksq = lsb(king);
+
+	bitboard checkers = enemy_checks_for(pos, c);
+	bitboard info = extract_info(pos);
 
 	// if more than 1 check we can only move the king
 	if (checkers & (checkers - 1))
 		goto king_moves;
 
-	bitboard targets = ~pos.white;
+	bitboard targets = ~us;
 
 	if (checkers) {
 		targets &= checkers | line_between(king, checkers);
 	}
 
-	generate_pawn_moves(pos, targets, &list);
-	generate_partial_moves(pos, Knight, targets, &list);
-	generate_partial_moves(pos, Bishop, targets, &list);
-	generate_partial_moves(pos, Rook,   targets, &list);
-	generate_partial_moves(pos, Queen,  targets, &list);
-	filter_pinned_moves(pos, &list);
+	bitboard bishops = (extract(pos, Bishop) | extract(pos, Queen)) & them;
+	bitboard rooks   = (extract(pos, Rook)   | extract(pos, Queen)) & them;
+
+	// pinned pieces may only move along the line to their pinner
+	bitboard pinned = 0, pin_line[64];
+	bitboard snipers = (bishop_attacks(ksq, them) & bishops)
+	                 | (rook_attacks(ksq, them) & rooks);
+
+	while (snipers) {
+		bitboard sniper = snipers & -snipers;
+		bitboard line = line_between(king, sniper);
+		bitboard blockers = line & occ;
+
+		if (blockers && !(blockers & (blockers - 1)) && (blockers & us)) {
+			pinned |= blockers;
+			pin_line[lsb(blockers)] = line | sniper;
+		}
+
+		snipers &= snipers - 1;
+	}
+
+	// pawns
+	{
+		bitboard pawns = extract(pos, Pawn) & us;
+		bitboard en_passant = relative(c, (info & EP_MASK) << 40);
+
+		bitboard pawn_targets = targets | (forward(c, targets) & en_passant);
+		bitboard captures = (them | en_passant) & pawn_targets;
+
+		bitboard single_up = forward(c, pawns) & ~occ;
+		bitboard double_up = forward(c, single_up & relative(c, RANK3)) & ~occ;
+
+		single_up &= pawn_targets;
+		double_up &= pawn_targets;
+
+		while (pawns) {
+			square sq = lsb(pawns);
+			bitboard bit = 1ULL << sq;
+
+			bitboard moves = (forward(c, bit) & single_up)
+			               | (forward(c, forward(c, bit)) & double_up)
+			               | (pawn_attacks(c, bit) & captures);
+
+			if (pinned & bit)
+				moves &= pin_line[sq];
+
+			// en passant removes two pawns from the same rank, which can
+			// uncover a check that isn't a pin
+			if (moves & en_passant) {
+				bitboard nocc = (occ & ~bit & ~backward(c, en_passant)) | en_passant;
+
+				if ((bishops & bishop_attacks(ksq, nocc)) | (rooks & rook_attacks(ksq, nocc)))
+					moves &= ~en_passant;
+			}
+
+			add_piece_moves(&set, sq, Pawn, moves, bit & relative(c, RANK7));
+			pawns &= pawns - 1;
+		}
+	}
+
+	// pieces
+	for (enum PieceType T = Knight; T <= Queen; T++) {
+		bitboard pieces = extract(pos, T) & us;
+
+		while (pieces) {
+			square sq = lsb(pieces);
+			bitboard moves = generic_attacks(T, sq, occ) & targets;
+
+			if ((pinned >> sq) & 1)
+				moves &= pin_line[sq];
+
+			add_piece_moves(&set, sq, T, moves, false);
+			pieces &= pieces - 1;
+		}
+	}
 
 king_moves:
-	generate_king_moves(pos, &list);
+	{
+		bitboard attacked = enemy_attacks_for(pos, c);
+		bitboard moves = king_attacks(ksq) & ~attacked & ~us;
+
+		enum { C1 = 2, G1 = 6 };
+
+		if (!checkers) {
+			bitboard kingside_occ  = relative(c, 0b01100000);
+			bitboard queenside_occ = relative(c, 0b00001110);
+			bitboard kingside_attacked  = relative(c, 0b01110000);
+			bitboard queenside_attacked = relative(c, 0b00011100);
+
+			if ((info & kingside(c)) && !(occ & kingside_occ) && !(attacked & kingside_attacked))
+				set.castling |= 1ULL << relative_square(c, G1);
+
+			if ((info & queenside(c)) && !(occ & queenside_occ) && !(attacked & queenside_attacked))
+				set.castling |= 1ULL << relative_square(c, C1);
+		}
+
+		add_piece_moves(&set, ksq, King, moves | set.castling, false);
+	}
+
+	return set;
+}
+
+struct MoveSet generate_move_set(struct Position pos) {
+#ifdef ABSOLUTE_COLORS
+	if (turn(pos) == BLACK)
+		return generate_move_set_for(pos, BLACK);
+#endif
+
+	return generate_move_set_for(pos, WHITE);
+}
+
+struct MoveList expand_moves(struct MoveSet set) {
+	struct MoveList list = {.length = 0};
+	struct Move move;
+
+	while (pop_move(&set, &move)) {
+		append(&list, move);
+	}
+
 	return list;
 }
+
+size_t count_moves(const struct MoveSet *set) {
+	size_t count = 0;
+
+	for (size_t i = 0; i < set->length; i++) {
+		size_t moves = popcount(set->pieces[i].targets);
+		count += (set->pieces[i].promotion != None) ? 4 * moves : moves;
+	}
+
+	return count;
+}
+
+static always_inline
+bool gives_check(struct Position pos, struct Move move) {
+	return enemy_checks(make_move(pos, move)) != 0;
+}
+
+static always_inline
+struct MoveList generate_checks_for(struct Position pos, enum Color c) {
+	struct MoveSet set = generate_move_set_for(pos, c);
+	struct MoveList list = {.length = 0};
+
+	bitboard us = side(pos, c);
+	bitboard occ = occupied(pos);
+
+	bitboard enemy_king = extract(pos, King) & ~us;
+	square ksq = lsb(enemy_king);
+
+	bitboard en_passant = relative(c, (extract_info(pos) & EP_MASK) << 40);
+
+	// our pieces blocking one of our sliders from the enemy king give a
+	// discovered check by leaving the line
+	bitboard bishops = (extract(pos, Bishop) | extract(pos, Queen)) & us;
+	bitboard rooks   = (extract(pos, Rook)   | extract(pos, Queen)) & us;
+
+	bitboard discoverers = 0, discovery_line[64];
+	bitboard snipers = (bishop_attacks(ksq, 0) & bishops) | (rook_attacks(ksq, 0) & rooks);
+
+	while (snipers) {
+		bitboard sniper = snipers & -snipers;
+		bitboard line = line_between(enemy_king, sniper);
+		bitboard blockers = line & occ;
+
+		if (blockers && !(blockers & (blockers - 1)) && (blockers & us)) {
+			discoverers |= blockers;
+			discovery_line[lsb(blockers)] = line | sniper;
+		}
+
+		snipers &= snipers - 1;
+	}
+
+	for (size_t i = 0; i < set.length; i++) {
+		struct PieceMoves moves = set.pieces[i];
+		bitboard bit = 1ULL << moves.start;
+		bitboard targets = moves.targets;
+
+		// promotions, en passant and castling change more than one square,
+		// so they are played out instead
+		bitboard special = 0;
+
+		if (moves.promotion != None)
+			special = targets;
+		else if (moves.piece == Pawn)
+			special = targets & en_passant;
+		else if (moves.piece == King)
+			special = targets & set.castling;
+
+		targets &= ~special;
+
+		// the moving piece no longer blocks its own rays to the king
+		bitboard vacated = occ & ~bit;
+		bitboard checks = 0;
+
+		switch (moves.piece) {
+			case Pawn:   checks = pawn_attacks(!c, enemy_king); break;
+			case Knight: checks = knight_attacks(ksq); break;
+			case Bishop: checks = bishop_attacks(ksq, vacated); break;
+			case Rook:   checks = rook_attacks(ksq, vacated); break;
+			case Queen:  checks = queen_attacks(ksq, vacated); break;
+		}
+
+		if (discoverers & bit)
+			checks |= ~discovery_line[moves.start];
+
+		targets &= checks;
+
+		while (targets) {
+			append(&list, (struct Move){ moves.start, lsb(targets), moves.piece, false });
+			targets &= targets - 1;
+		}
+
+		while (special) {
+			square dst = lsb(special);
+			bool castling = moves.piece == King;
+
+			if (moves.promotion == None) {
+				struct Move move = { moves.start, dst, moves.piece, castling };
+				if (gives_check(pos, move)) append(&list, move);
+			}
+
+			else for (enum PieceType T = Knight; T <= Queen; T++) {
+				struct Move move = { moves.start, dst, T, false };
+				if (gives_check(pos, move)) append(&list, move);
+			}
+
+			special &= special - 1;
+		}
+	}
+
+	return list;
+}
+
+struct MoveList generate_checks(struct Position pos) {
+#ifdef ABSOLUTE_COLORS
+	if (turn(pos) == BLACK)
+		return generate_checks_for(pos, BLACK);
+#endif
+
+	return generate_checks_for(pos, WHITE);
+}
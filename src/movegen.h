@@ -2,6 +2,7 @@
 #define MOVEGEN_H_
 
 #include <assert.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -19,11 +20,89 @@ struct MoveList {
 	size_t length;
 };
 
+// legal moves as one destination bitboard per moving piece, for callers that
+// only need to count moves or test for their presence
+struct PieceMoves {
+	uint8_t start, piece;
+	uint8_t promotion; // next promotion piece for pawns on the 7th rank, else None
+	bitboard targets;
+};
+
+struct MoveSet {
+	struct PieceMoves pieces[16]; // only pieces with at least one move
+	size_t length;
+	bitboard castling; // king destinations that are castling moves
+};
+
+enum CheckState { NO_CHECK, SINGLE_CHECK, DOUBLE_CHECK };
+
+// generate_moves dispatches once per call to a generator specialised for the
+// check state and whether en passant and castling are possible at all
+enum MovegenVariant {
+	DOUBLE_CHECK_MOVES,
+	SINGLE_CHECK_MOVES,
+	SINGLE_CHECK_EP_MOVES,
+	NO_CHECK_MOVES,
+	NO_CHECK_CASTLING_MOVES,
+	NO_CHECK_EP_MOVES,
+	NO_CHECK_EP_CASTLING_MOVES,
+	MOVEGEN_VARIANTS,
+};
+
 // NOTE: these functions assume legal positions and moves
 struct MoveList generate_moves(struct Position pos);
 struct Position make_move(struct Position pos, struct Move move);
 
+// squares attacked by the side not to move, with sliders seeing through our king
+bitboard enemy_attacks(struct Position pos);
 bitboard enemy_checks(struct Position pos);
+enum MovegenVariant movegen_variant(struct Position pos);
+
+// the same moves as generate_moves from the single runtime-checked variant,
+// which generate_moves itself uses when built with GENERIC_MOVEGEN
+struct MoveList generate_generic_moves(struct Position pos);
+
+struct MoveSet generate_move_set(struct Position pos);
+struct MoveList expand_moves(struct MoveSet set);
+size_t count_moves(const struct MoveSet *set);
+
+// legal moves that give check
+struct MoveList generate_checks(struct Position pos);
+
+static inline
+bool has_moves(const struct MoveSet *set) {
+	return set->length != 0;
+}
+
+// removes the next move from the set, returning false once it is empty
+static inline
+bool pop_move(struct MoveSet *set, struct Move *move) {
+	if (set->length == 0)
+		return false;
+
+	struct PieceMoves *moves = &set->pieces[set->length - 1];
+	square dst = lsb(moves->targets);
+	bool castling = moves->piece == King && ((set->castling >> dst) & 1);
+
+	*move = (struct Move){ moves->start, dst, moves->piece, castling };
+
+	// pawns cycle through the promotion pieces before the next destination
+	if (moves->promotion != None) {
+		move->piece = moves->promotion;
+
+		if (moves->promotion++ != Queen)
+			return true;
+
+		moves->promotion = Knight;
+	}
+
+	moves->targets &= moves->targets - 1;
+
+	if (moves->targets == 0)
+		set->length--;
+
+	return true;
+}
 
 static inline
 bitboard generic_attacks(enum PieceType T, square sq, bitboard occ) {
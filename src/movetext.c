@@ -0,0 +1,136 @@
+#include "movetext.h"
+
+#include "bits.h"
+#include "movegen.h"
+#include "position.h"
+#include "text.h"
+
+#include <ctype.h>
+#include <string.h>
+
+enum { MAX_TOKEN = 64 };
+
+struct State play_move(struct State state, struct Move move) {
+	bitboard them = occupied(state.pos) & ~side(state.pos, turn(state.pos));
+	bool irreversible = ((them >> move.end) & 1) || get_piece(state.pos, move.start) == Pawn;
+
+	state.pos = make_move(state.pos, move);
+	state.fify_move_clock = irreversible ? 0 : state.fify_move_clock + 1;
+	state.movenumber += state.side_to_move == BLACK;
+	state.side_to_move = !state.side_to_move;
+
+	return state;
+}
+
+static
+void skip_until(FILE *input, int end) {
+	int c;
+	while ((c = getc(input)) != EOF && c != end);
+}
+
+// the next whitespace separated token, outside of tags, comments and variations
+static
+bool next_token(FILE *input, char *token) {
+	int c;
+
+	for (;;) {
+		while ((c = getc(input)) != EOF && isspace(c));
+
+		if (c == EOF) return false;
+		else if (c == '[' || c == ';') skip_until(input, '\n');
+		else if (c == '{') skip_until(input, '}');
+
+		// variations nest
+		else if (c == '(') {
+			for (int depth = 1; depth > 0 && (c = getc(input)) != EOF;) {
+				if (c == '{') skip_until(input, '}');
+				depth += (c == '(') - (c == ')');
+			}
+		}
+
+		else break;
+	}
+
+	size_t length = 0;
+
+	do {
+		if (length + 1 < MAX_TOKEN) token[length++] = c;
+	} while ((c = getc(input)) != EOF && !isspace(c) && !strchr("[;{(", c));
+
+	if (c != EOF) ungetc(c, input);
+
+	token[length] = '\0';
+	return true;
+}
+
+static
+enum GameResult parse_result(const char *token) {
+	if (strcmp(token, "1-0") == 0) return RESULT_WHITE_WINS;
+	if (strcmp(token, "0-1") == 0) return RESULT_BLACK_WINS;
+	if (strcmp(token, "1/2-1/2") == 0) return RESULT_DRAW;
+	if (strcmp(token, "*") == 0) return RESULT_UNKNOWN;
+	return -1;
+}
+
+// matched against the SAN of each legal move, without check marks
+static
+bool match_san(const char *san, struct State state, struct Move *move) {
+	struct MoveList list = generate_moves(state.pos);
+
+	for (size_t i = 0; i < list.length; i++) {
+		char buffer[16];
+		buffer[generate_san(list.moves[i], state, buffer, false)] = '\0';
+
+		if (strcmp(buffer, san) == 0) {
+			*move = list.moves[i];
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool read_game(FILE *input, struct Game *game, FILE *stream) {
+	char token[MAX_TOKEN];
+	bool ok, skipping = false;
+
+	struct State start = parse_fen(STARTPOS, &ok, stream);
+	struct State state = start;
+	game->length = 0;
+
+	while (next_token(input, token)) {
+		int result = parse_result(token);
+
+		if (result >= 0) {
+			if (!skipping) {
+				game->result = result;
+				return true;
+			}
+
+			skipping = false;
+			game->length = 0;
+			state = start;
+			continue;
+		}
+
+		// move numbers, possibly written against the move
+		char *san = token;
+		while (isdigit(*san)) san++;
+		while (*san == '.') san++;
+
+		if (!*san || *san == '$' || skipping)
+			continue;
+
+		san[strcspn(san, "+#!?")] = '\0';
+
+		if (game->length == MAX_GAME_PLIES || !match_san(san, state, &game->moves[game->length])) {
+			fprintf(stream, "skipping game at move %s\n", san);
+			skipping = true;
+			continue;
+		}
+
+		state = play_move(state, game->moves[game->length++]);
+	}
+
+	return false;
+}
@@ -0,0 +1,36 @@
+#ifndef MOVETEXT_H_
+#define MOVETEXT_H_
+
+#include "movegen.h"
+#include "state.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+enum { MAX_GAME_PLIES = 1024 };
+
+enum GameResult {
+	RESULT_BLACK_WINS,
+	RESULT_DRAW,
+	RESULT_WHITE_WINS,
+	RESULT_UNKNOWN,
+};
+
+struct Game {
+	struct Move moves[MAX_GAME_PLIES];
+	size_t length;
+	enum GameResult result;
+};
+
+// Reads the next game of SAN movetext from the standard starting position:
+// moves with optional move numbers, ended by the result (1-0, 0-1, 1/2-1/2 or
+// *). Tag lines, {comments}, (variations), NAGs and annotation marks are
+// skipped. Games with an unknown move are reported to `stream` and skipped.
+// Returns false at the end of the input.
+bool read_game(FILE *input, struct Game *game, FILE *stream);
+
+// makes the move, keeping the clocks and the side to move
+struct State play_move(struct State state, struct Move move);
+
+#endif //MOVETEXT_H_
@@ -0,0 +1,316 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "nnue.h"
+
+#include "bits.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char MAGIC[8] = "UCNNUE1";
+
+enum { ACTIVATION_MAX = 127, LAYER_SHIFT = 6, OUTPUT_SCALE = 16 };
+
+struct Network {
+	int16_t feature_bias[NNUE_HIDDEN];
+	int16_t feature_weights[HALFKP_INPUTS][NNUE_HIDDEN];
+
+	int32_t bias1[NNUE_L2];
+	int8_t weights1[NNUE_L2][NNUE_L1];
+
+	int32_t bias2[NNUE_L3];
+	int8_t weights2[NNUE_L3][NNUE_L2];
+
+	int32_t output_bias;
+	int8_t output_weights[NNUE_L3];
+};
+
+static
+struct Network *new_network() {
+	void *network = NULL;
+
+	if (posix_memalign(&network, 64, sizeof(struct Network)) != 0)
+		return NULL;
+
+	return network;
+}
+
+void free_network(struct Network *network) {
+	free(network);
+}
+
+// the parameters in file order
+static
+bool transfer(FILE *file, struct Network *n, bool write) {
+	struct { void *data; size_t size; } fields[] = {
+		{ n->feature_bias, sizeof n->feature_bias },
+		{ n->feature_weights, sizeof n->feature_weights },
+		{ n->bias1, sizeof n->bias1 },
+		{ n->weights1, sizeof n->weights1 },
+		{ n->bias2, sizeof n->bias2 },
+		{ n->weights2, sizeof n->weights2 },
+		{ &n->output_bias, sizeof n->output_bias },
+		{ n->output_weights, sizeof n->output_weights },
+	};
+
+	for (size_t i = 0; i < sizeof fields / sizeof *fields; i++) {
+		size_t done = write ? fwrite(fields[i].data, 1, fields[i].size, file)
+		                    : fread(fields[i].data, 1, fields[i].size, file);
+
+		if (done != fields[i].size)
+			return false;
+	}
+
+	return true;
+}
+
+struct Network *load_network(const char *path, FILE *stream) {
+	FILE *file = fopen(path, "rb");
+
+	if (!file) {
+		fprintf(stream, "failed to open %s\n", path);
+		return NULL;
+	}
+
+	struct Network *n = new_network();
+	char magic[sizeof MAGIC];
+
+	bool ok = n && fread(magic, sizeof magic, 1, file) == 1 && memcmp(magic, MAGIC, sizeof MAGIC) == 0
+	       && transfer(file, n, false);
+
+	// nothing may follow the parameters
+	ok = ok && fgetc(file) == EOF;
+	fclose(file);
+
+	if (!ok) {
+		fprintf(stream, "%s is not a network\n", path);
+		free_network(n);
+		return NULL;
+	}
+
+	return n;
+}
+
+bool save_network(const struct Network *n, const char *path, FILE *stream) {
+	FILE *file = fopen(path, "wb");
+
+	if (!file) {
+		fprintf(stream, "failed to create %s\n", path);
+		return false;
+	}
+
+	bool ok = fwrite(MAGIC, sizeof MAGIC, 1, file) == 1 && transfer(file, (struct Network *)n, true);
+
+	ok &= fclose(file) == 0;
+
+	if (!ok) fprintf(stream, "failed to write %s\n", path);
+	return ok;
+}
+
+// uniform in [lo, hi]
+static inline
+int random_int(uint64_t *seed, int lo, int hi) {
+	*seed ^= *seed >> 12, *seed ^= *seed << 25, *seed ^= *seed >> 27;
+	return lo + (int)((*seed * 0x2545f4914f6cdd1d >> 33) % (uint64_t)(hi - lo + 1));
+}
+
+struct Network *random_network(uint64_t seed) {
+	struct Network *n = new_network();
+	if (!n) return NULL;
+
+	seed |= 1;
+
+	for (int i = 0; i < NNUE_HIDDEN; i++)
+		n->feature_bias[i] = random_int(&seed, 0, 32);
+
+	for (int input = 0; input < HALFKP_INPUTS; input++)
+		for (int i = 0; i < NNUE_HIDDEN; i++)
+			n->feature_weights[input][i] = random_int(&seed, -8, 8);
+
+	for (int o = 0; o < NNUE_L2; o++) {
+		n->bias1[o] = random_int(&seed, -256, 256);
+
+		for (int i = 0; i < NNUE_L1; i++)
+			n->weights1[o][i] = random_int(&seed, -16, 16);
+	}
+
+	for (int o = 0; o < NNUE_L3; o++) {
+		n->bias2[o] = random_int(&seed, -256, 256);
+
+		for (int i = 0; i < NNUE_L2; i++)
+			n->weights2[o][i] = random_int(&seed, -64, 64);
+	}
+
+	n->output_bias = 0;
+
+	for (int i = 0; i < NNUE_L3; i++)
+		n->output_weights[i] = random_int(&seed, -64, 64);
+
+	return n;
+}
+
+// the king of a perspective, in its own squares
+static inline
+square perspective_king(struct Position pos, enum Perspective p) {
+	bitboard kings = extract(pos, King);
+	return (p == OURS) ? lsb(kings & pos.white) : lsb(kings & ~pos.white) ^ 56;
+}
+
+// the input of a piece of the white bitboard or not, in stored squares
+static inline
+unsigned piece_input(enum Perspective p, square king, enum PieceType T, bool white, square sq) {
+	return halfkp_index(king, T, white != (p == OURS), (p == THEIRS) ? sq ^ 56 : sq);
+}
+
+static
+void refresh_perspective(const struct Network *n, struct Position pos, enum Perspective p, int16_t *values) {
+	uint16_t features[MAX_HALFKP_ACTIVE];
+	size_t length = halfkp_features(pos, p, features);
+
+	memcpy(values, n->feature_bias, sizeof n->feature_bias);
+
+	for (size_t f = 0; f < length; f++) {
+		const int16_t *weights = n->feature_weights[features[f]];
+
+		for (int i = 0; i < NNUE_HIDDEN; i++)
+			values[i] += weights[i];
+	}
+}
+
+void refresh_accumulator(const struct Network *n, struct Position pos, struct Accumulator *acc) {
+	refresh_perspective(n, pos, OURS, acc->values[OURS]);
+	refresh_perspective(n, pos, THEIRS, acc->values[THEIRS]);
+}
+
+// the perspective of the same side once the move is made
+static inline
+enum Perspective next_perspective(enum Perspective p) {
+#ifdef ABSOLUTE_COLORS
+	return p;
+#else
+	return !p;
+#endif
+}
+
+struct PieceChange {
+	enum PieceType T;
+	bool white;
+	square sq;
+};
+
+void update_accumulator(const struct Network *n, struct Position pos, struct Move move,
+                        const struct Accumulator *from, struct Accumulator *to) {
+	enum { A1 = 0, H1 = 7 };
+
+	enum Color c = turn(pos);
+	bool white = (c == WHITE);
+	enum Perspective mover = white ? OURS : THEIRS;
+
+	struct PieceChange removed[3], added[2];
+	size_t removals = 0, additions = 0;
+
+	enum PieceType T = get_piece(pos, move.start);
+	enum PieceType victim = get_piece(pos, move.end);
+
+	if (T != King) removed[removals++] = (struct PieceChange){ T, white, move.start };
+	if (move.piece != King) added[additions++] = (struct PieceChange){ move.piece, white, move.end };
+
+	if (victim != None && victim != Info) {
+		removed[removals++] = (struct PieceChange){ victim, !white, move.end };
+	}
+
+	// a pawn moving to another file onto an empty square captures en passant
+	else if (T == Pawn && ((move.start ^ move.end) & 7)) {
+		square captured = lsb(backward(c, 1ULL << move.end));
+		removed[removals++] = (struct PieceChange){ Pawn, !white, captured };
+	}
+
+	if (move.castling) {
+		square rook = relative_square(c, (move.end < move.start) ? A1 : H1);
+		square mid = (move.start + move.end) >> 1;
+
+		removed[removals++] = (struct PieceChange){ Rook, white, rook };
+		added[additions++] = (struct PieceChange){ Rook, white, mid };
+	}
+
+	for (enum Perspective p = OURS; p <= THEIRS; p++) {
+		int16_t *values = to->values[next_perspective(p)];
+
+		// a king move changes every input of its own side
+		if (p == mover && T == King) {
+			refresh_perspective(n, make_move(pos, move), next_perspective(p), values);
+			continue;
+		}
+
+		square king = perspective_king(pos, p);
+		memcpy(values, from->values[p], sizeof from->values[p]);
+
+		for (size_t r = 0; r < removals; r++) {
+			const int16_t *weights = n->feature_weights[piece_input(p, king, removed[r].T, removed[r].white, removed[r].sq)];
+
+			for (int i = 0; i < NNUE_HIDDEN; i++)
+				values[i] -= weights[i];
+		}
+
+		for (size_t a = 0; a < additions; a++) {
+			const int16_t *weights = n->feature_weights[piece_input(p, king, added[a].T, added[a].white, added[a].sq)];
+
+			for (int i = 0; i < NNUE_HIDDEN; i++)
+				values[i] += weights[i];
+		}
+	}
+}
+
+// of unsigned activations and signed weights, `length` a multiple of 32
+static inline
+int32_t dot(const uint8_t *input, const int8_t *weights, size_t length) {
+#ifdef __AVX2__
+	const __m256i ones = _mm256_set1_epi16(1);
+	__m256i sum = _mm256_setzero_si256();
+
+	for (size_t i = 0; i < length; i += 32) {
+		__m256i a = _mm256_loadu_si256((const __m256i *)(input + i));
+		__m256i b = _mm256_loadu_si256((const __m256i *)(weights + i));
+
+		// pairs of products fit in 16 bits as activations are at most 127
+		__m256i pairs = _mm256_maddubs_epi16(a, b);
+		sum = _mm256_add_epi32(sum, _mm256_madd_epi16(pairs, ones));
+	}
+
+	__m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+	half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+	half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(half);
+#else
+	int32_t sum = 0;
+
+	for (size_t i = 0; i < length; i++)
+		sum += input[i] * weights[i];
+
+	return sum;
+#endif
+}
+
+static inline
+uint8_t clip(int32_t x) {
+	return (x < 0) ? 0 : (x > ACTIVATION_MAX) ? ACTIVATION_MAX : x;
+}
+
+int evaluate_nnue(const struct Network *n, struct Position pos, const struct Accumulator *acc) {
+	enum Perspective us = (turn(pos) == WHITE) ? OURS : THEIRS;
+
+	uint8_t input[NNUE_L1], hidden1[NNUE_L2], hidden2[NNUE_L3];
+
+	for (int i = 0; i < NNUE_HIDDEN; i++) {
+		input[i] = clip(acc->values[us][i]);
+		input[NNUE_HIDDEN + i] = clip(acc->values[!us][i]);
+	}
+
+	for (int o = 0; o < NNUE_L2; o++)
+		hidden1[o] = clip((n->bias1[o] + dot(input, n->weights1[o], NNUE_L1)) >> LAYER_SHIFT);
+
+	for (int o = 0; o < NNUE_L3; o++)
+		hidden2[o] = clip((n->bias2[o] + dot(hidden1, n->weights2[o], NNUE_L2)) >> LAYER_SHIFT);
+
+	return (n->output_bias + dot(hidden2, n->output_weights, NNUE_L3)) / OUTPUT_SCALE;
+}
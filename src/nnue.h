@@ -0,0 +1,47 @@
+#ifndef NNUE_H_
+#define NNUE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "features.h"
+#include "movegen.h"
+#include "position.h"
+
+// A HalfKP network: 41024 inputs per perspective into 256 int16 sums, the
+// two perspectives clipped and joined (side to move first) into 512 int8
+// inputs, then 32, 32 and one output through int8 affine layers.
+enum { NNUE_HIDDEN = 256, NNUE_L1 = 2 * NNUE_HIDDEN, NNUE_L2 = 32, NNUE_L3 = 32 };
+
+struct Network;
+
+// A file of the network's parameters after an 8-byte magic, in native byte
+// order: feature biases and weights (int16, input by input), then for each
+// layer the int32 biases and int8 weights (output by output).
+struct Network *load_network(const char *path, FILE *stream);
+bool save_network(const struct Network *network, const char *path, FILE *stream);
+void free_network(struct Network *network);
+
+// small random parameters, for trying the code out without a trained network
+struct Network *random_network(uint64_t seed);
+
+// the sums of the inputs of each perspective of the stored board (see
+// features.h)
+struct Accumulator {
+	int16_t values[2][NNUE_HIDDEN];
+} __attribute__((aligned(64)));
+
+void refresh_accumulator(const struct Network *network, struct Position pos, struct Accumulator *acc);
+
+// The accumulator of the position after `move`, from that of `pos`: the
+// perspectives follow the rotation of the board and only the inputs of the
+// moved, captured and castled pieces change, except for a perspective whose
+// own king moved, which is refreshed. `to` must not be `from`.
+void update_accumulator(const struct Network *network, struct Position pos, struct Move move,
+                        const struct Accumulator *from, struct Accumulator *to);
+
+// in centipawns, for the side to move
+int evaluate_nnue(const struct Network *network, struct Position pos, const struct Accumulator *acc);
+
+#endif /*NNUE_H_*/
@@ -0,0 +1,155 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bits.h"
+#include "movegen.h"
+#include "nnue.h"
+#include "position.h"
+#include "state.h"
+#include "text.h"
+#include "timer.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { MAX_LINE = 4096, MAX_DEPTH = 16, DEFAULT_DEPTH = 4 };
+
+static
+void eval(const struct Network *network, const char *fen) {
+	bool ok;
+	struct State state = parse_fen(fen, &ok, stderr);
+	if (!ok) return;
+
+	struct Accumulator acc;
+	refresh_accumulator(network, state.pos, &acc);
+
+	printf("%s; %d\n", fen, evaluate_nnue(network, state.pos, &acc));
+}
+
+struct Walk {
+	const struct Network *network;
+	struct Accumulator stack[MAX_DEPTH + 1];
+	bool incremental, verify;
+	uint64_t evals, mismatches;
+	int64_t checksum;
+};
+
+// evaluates every node of the tree to `depth`, with the accumulator of each
+// node updated from its parent or refreshed
+static
+void walk(struct Walk *w, struct Position pos, unsigned ply, unsigned depth) {
+	struct Accumulator *acc = &w->stack[ply];
+
+	if (w->verify) {
+		struct Accumulator fresh;
+		refresh_accumulator(w->network, pos, &fresh);
+		w->mismatches += memcmp(&fresh, acc, sizeof fresh) != 0;
+	}
+
+	w->checksum += evaluate_nnue(w->network, pos, acc);
+	w->evals++;
+
+	if (ply == depth)
+		return;
+
+	struct MoveList list = generate_moves(pos);
+
+	for (size_t i = 0; i < list.length; i++) {
+		struct Position child = make_move(pos, list.moves[i]);
+
+		if (w->incremental) update_accumulator(w->network, pos, list.moves[i], acc, &w->stack[ply + 1]);
+		else                refresh_accumulator(w->network, child, &w->stack[ply + 1]);
+
+		walk(w, child, ply + 1, depth);
+	}
+}
+
+// evals/sec over the trees of the bench positions, refreshing every node and
+// updating incrementally, then checking every update against a refresh
+static
+void bench(const struct Network *network, unsigned depth) {
+	static struct Walk w;
+	int count = PERFT_POSITIONS;
+
+	if (depth > MAX_DEPTH) depth = MAX_DEPTH;
+
+	printf("mode\t\t| evals\t\t| ms\t\t| evals/s\t| checksum\n");
+
+	for (int mode = 0; mode < 3; mode++) {
+		w = (struct Walk){ .network = network, .incremental = mode != 0, .verify = mode == 2 };
+		double start = wall_time();
+
+		for (int i = 0; i < count; i++) {
+			bool ok;
+			struct State state = parse_fen(perft_positions[i], &ok, stderr);
+
+			refresh_accumulator(network, state.pos, &w.stack[0]);
+			walk(&w, state.pos, 0, depth);
+		}
+
+		double seconds = wall_time() - start;
+		const char *name = (mode == 0) ? "refresh\t" : (mode == 1) ? "incremental" : "verify\t";
+
+		printf("%s\t| %-10llu\t| %-10.3f\t| %-10.0f\t| %lld", name, (unsigned long long)w.evals, seconds * 1e3,
+		       w.evals / seconds, (long long)w.checksum);
+
+		if (mode == 2) printf("\t(%llu mismatches)", (unsigned long long)w.mismatches);
+		printf("\n");
+	}
+}
+
+int main(int argc, char **argv) {
+	init_bitbase();
+
+	// uchess-nnue random <network> [seed]
+	if (argc > 2 && strcmp(argv[1], "random") == 0) {
+		struct Network *network = random_network((argc > 3) ? strtoull(argv[3], NULL, 10) : 1);
+
+		if (!network) {
+			fprintf(stderr, "failed to allocate the network\n");
+			return 1;
+		}
+
+		bool ok = save_network(network, argv[2], stderr);
+		free_network(network);
+		return !ok;
+	}
+
+	if (argc < 3 || (strcmp(argv[1], "eval") != 0 && strcmp(argv[1], "bench") != 0)) {
+		fprintf(stderr, "usage: uchess-nnue random <network> [seed]\n"
+		                "       uchess-nnue eval <network> [fen | -]\n"
+		                "       uchess-nnue bench <network> [depth]\n");
+		return 1;
+	}
+
+	struct Network *network = load_network(argv[2], stderr);
+
+	if (!network)
+		return 1;
+
+	// uchess-nnue eval <network> [fen | -], reading one fen per line from
+	// stdin for -
+	if (strcmp(argv[1], "eval") == 0) {
+		if (argc > 3 && strcmp(argv[3], "-") != 0) {
+			eval(network, argv[3]);
+		}
+
+		else {
+			static char line[MAX_LINE];
+
+			while (fgets(line, sizeof line, stdin)) {
+				line[strcspn(line, "\r\n")] = '\0';
+				if (line[0]) eval(network, line);
+			}
+		}
+	}
+
+	// uchess-nnue bench <network> [depth]
+	else {
+		bench(network, (argc > 3) ? (unsigned)atoi(argv[3]) : DEFAULT_DEPTH);
+	}
+
+	free_network(network);
+	return 0;
+}
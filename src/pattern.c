@@ -0,0 +1,366 @@
+#include "pattern.h"
+
+#include "bits.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { MAX_THREADS = 256 };
+
+static const char PIECE_CHARS[] = " PNBRQK";
+
+#ifdef __AVX2__
+typedef __m256i vector;
+
+static inline
+vector load_position(const struct Position *pos) {
+	return _mm256_loadu_si256((const __m256i *)pos);
+}
+
+static inline
+bool test_square(vector v, const struct SquareTest *test) {
+	__m256i difference = _mm256_xor_si256(v, load_position(&test->value));
+	return _mm256_testz_si256(difference, load_position(&test->mask));
+}
+#else
+typedef struct Position vector;
+
+static inline
+vector load_position(const struct Position *pos) {
+	return *pos;
+}
+
+static inline
+bool test_square(vector v, const struct SquareTest *test) {
+	return (((v.white ^ test->value.white) & test->mask.white) | ((v.X ^ test->value.X) & test->mask.X)
+	      | ((v.Y ^ test->value.Y) & test->mask.Y) | ((v.Z ^ test->value.Z) & test->mask.Z)) == 0;
+}
+#endif
+
+static
+struct SquareTest square_test(enum PieceType T, bool ours, square sq) {
+	bitboard b = 1ULL << sq;
+
+	return (struct SquareTest){
+		.mask = { b, b, b, b },
+		.value = { ours ? b : 0, (T & 1) ? b : 0, (T & 2) ? b : 0, (T & 4) ? b : 0 },
+	};
+}
+
+// false when the tests contradict each other
+static
+bool merge_test(struct SquareTest *into, const struct SquareTest *test) {
+	struct Position *m = &into->mask, *v = &into->value;
+	const struct Position *tm = &test->mask, *tv = &test->value;
+
+	if (((v->white ^ tv->white) & m->white & tm->white) | ((v->X ^ tv->X) & m->X & tm->X)
+	    | ((v->Y ^ tv->Y) & m->Y & tm->Y) | ((v->Z ^ tv->Z) & m->Z & tm->Z))
+		return false;
+
+	m->white |= tm->white, m->X |= tm->X, m->Y |= tm->Y, m->Z |= tm->Z;
+	v->white |= tv->white, v->X |= tv->X, v->Y |= tv->Y, v->Z |= tv->Z;
+	return true;
+}
+
+// one alternative such as Ne5 or .e4 on the stored board, where an empty
+// square is Info
+static
+bool parse_alternative(const char *text, size_t length, enum Color stm, enum PieceType *T, bool *ours, square *sq) {
+	if (length != 3 || text[1] < 'a' || text[1] > 'h' || text[2] < '1' || text[2] > '8')
+		return false;
+
+	enum Color c = (text[0] >= 'a' && text[0] <= 'z') ? BLACK : WHITE;
+	char upper = (c == BLACK) ? text[0] - 'a' + 'A' : text[0];
+
+	const char *piece = (upper != ' ') ? strchr(PIECE_CHARS, upper) : NULL;
+
+	if (!piece && text[0] != '.')
+		return false;
+
+	*T = piece ? (enum PieceType)(piece - PIECE_CHARS) : Info;
+	*sq = 8 * (text[2] - '1') + (text[1] - 'a');
+
+#ifdef ABSOLUTE_COLORS
+	(void)stm;
+	*ours = (c == WHITE);
+#else
+	*ours = (c == stm);
+	*sq = relative_square(stm, *sq);
+#endif
+
+	return true;
+}
+
+static
+bool add_test(struct SquareTest *tests, unsigned *count, struct SquareTest test, FILE *stream) {
+	if (*count == MAX_PATTERN_TESTS) {
+		fprintf(stream, "pattern has more than %d tests\n", MAX_PATTERN_TESTS);
+		return false;
+	}
+
+	tests[(*count)++] = test;
+	return true;
+}
+
+static
+bool compile_side(const char *text, enum Color stm, struct PatternSide *side, FILE *stream) {
+	*side = (struct PatternSide){0};
+	unsigned alternatives = 0;
+
+	for (const char *p = text; *p;) {
+		if (*p == ' ' || *p == '\t') {
+			p++;
+			continue;
+		}
+
+		size_t length = strcspn(p, " \t");
+		const char *end = p + length;
+		bool negated = (*p == '!');
+		unsigned first = alternatives, parsed = 0;
+		enum PieceType T = None;
+
+		for (const char *q = p + negated; q <= end; q += strcspn(q, "|") + 1) {
+			size_t n = strcspn(q, "|");
+			bool ours;
+			square sq;
+
+			if (q + n > end) n = end - q;
+
+			if (!parse_alternative(q, n, stm, &T, &ours, &sq)) {
+				fprintf(stream, "invalid pattern term: %.*s\n", (int)length, p);
+				return false;
+			}
+
+			parsed++;
+
+			// forbidding an empty square requires it to be occupied
+			if (negated && T == Info) {
+				side->occupied |= 1ULL << sq;
+			}
+
+			else if (negated) {
+				if (!add_test(side->forbidden, &side->forbidden_count, square_test(T, ours, sq), stream))
+					return false;
+			}
+
+			// an empty square has either no piece or the info bits
+			else if (T == Info) {
+				if (!add_test(side->alternatives, &alternatives, square_test(None, false, sq), stream)
+				    || !add_test(side->alternatives, &alternatives, square_test(Info, false, sq), stream))
+					return false;
+			}
+
+			else if (!add_test(side->alternatives, &alternatives, square_test(T, ours, sq), stream)) {
+				return false;
+			}
+		}
+
+		p = end;
+		if (negated) continue;
+
+		// single pieces and empty squares join the required squares, anything
+		// else is a clause
+		if (parsed == 1 && T == Info) {
+			side->empty |= side->alternatives[first].mask.X;
+			alternatives = first;
+		}
+
+		else if (parsed == 1) {
+			alternatives = first;
+
+			if (!merge_test(&side->required, &side->alternatives[first])) {
+				fprintf(stream, "contradictory pattern: %s\n", text);
+				return false;
+			}
+		}
+
+		else {
+			side->clause_ends[side->clause_count++] = alternatives;
+		}
+	}
+
+	// the required squares hold pieces
+	if ((side->empty & side->occupied) || (side->empty & side->required.mask.X)) {
+		fprintf(stream, "contradictory pattern: %s\n", text);
+		return false;
+	}
+
+	return true;
+}
+
+bool compile_pattern(const char *text, unsigned sides, struct Pattern *pattern, FILE *stream) {
+	*pattern = (struct Pattern){0};
+
+	for (enum Color c = WHITE; c <= BLACK; c++) {
+		if (!(sides & (1u << c)))
+			continue;
+
+		if (!compile_side(text, c, &pattern->sides[pattern->side_count], stream))
+			return false;
+
+		pattern->colors[pattern->side_count++] = c;
+	}
+
+	return true;
+}
+
+static inline
+bool match_side(const struct PatternSide *side, vector v, bitboard occ) {
+	if (!test_square(v, &side->required) || (occ & side->empty) || (~occ & side->occupied))
+		return false;
+
+	unsigned i = 0;
+
+	for (unsigned clause = 0; clause < side->clause_count; clause++) {
+		bool any = false;
+
+		for (; i < side->clause_ends[clause]; i++)
+			any |= test_square(v, &side->alternatives[i]);
+
+		if (!any) return false;
+	}
+
+	for (unsigned i = 0; i < side->forbidden_count; i++) {
+		if (test_square(v, &side->forbidden[i]))
+			return false;
+	}
+
+	return true;
+}
+
+unsigned match_pattern(const struct Pattern *pattern, struct Position pos) {
+	vector v = load_position(&pos);
+	bitboard occ = occupied(pos);
+	unsigned sides = 0;
+
+	for (unsigned s = 0; s < pattern->side_count; s++) {
+#ifdef ABSOLUTE_COLORS
+		if (turn(pos) != pattern->colors[s])
+			continue;
+#endif
+
+		if (match_side(&pattern->sides[s], v, occ))
+			sides |= 1u << pattern->colors[s];
+	}
+
+	return sides;
+}
+
+static inline
+void record(uint64_t *records, size_t max, size_t *count, size_t index) {
+	if (*count < max) records[*count] = index;
+	(*count)++;
+}
+
+static
+size_t scan_range(const struct Position *positions, size_t begin, size_t end, const struct Pattern *pattern,
+                  uint64_t *records, size_t max) {
+	size_t count = 0, i = begin;
+
+#ifdef __AVX512F__
+	// two positions per register against the required pieces and the empty
+	// and occupied squares of each side, leaving the rest of the pattern to
+	// the candidates. The occupancy lands in the X lane of each position.
+	__m512i masks[2], values[2], empty[2], occupied[2];
+
+	for (unsigned s = 0; s < pattern->side_count; s++) {
+		const struct PatternSide *side = &pattern->sides[s];
+
+		masks[s] = _mm512_broadcast_i64x4(load_position(&side->required.mask));
+		values[s] = _mm512_broadcast_i64x4(load_position(&side->required.value));
+		empty[s] = _mm512_maskz_set1_epi64(0x22, side->empty);
+		occupied[s] = _mm512_maskz_set1_epi64(0x22, side->occupied);
+	}
+
+	for (; i + 2 <= end; i += 2) {
+		__m512i v = _mm512_loadu_si512((const void *)(positions + i));
+		__m512i occ = _mm512_or_si512(_mm512_xor_si512(v, _mm512_alignr_epi64(v, v, 1)),
+		                              _mm512_xor_si512(v, _mm512_alignr_epi64(v, v, 2)));
+		unsigned candidates = 0;
+
+		for (unsigned s = 0; s < pattern->side_count; s++) {
+			__mmask8 differs = _mm512_test_epi64_mask(_mm512_xor_si512(v, values[s]), masks[s])
+			                 | _mm512_test_epi64_mask(occ, empty[s])
+			                 | _mm512_test_epi64_mask(_mm512_andnot_si512(occ, occupied[s]), occupied[s]);
+
+			candidates |= ((differs & 0x0f) == 0) | ((differs & 0xf0) == 0) << 1;
+		}
+
+		if (candidates == 0)
+			continue;
+
+		if ((candidates & 1) && match_pattern(pattern, positions[i]))
+			record(records, max, &count, i);
+
+		if ((candidates & 2) && match_pattern(pattern, positions[i + 1]))
+			record(records, max, &count, i + 1);
+	}
+#endif
+
+	for (; i < end; i++) {
+		if (match_pattern(pattern, positions[i]))
+			record(records, max, &count, i);
+	}
+
+	return count;
+}
+
+struct ScanWorker {
+	const struct Position *positions;
+	size_t begin, end;
+	const struct Pattern *pattern;
+	uint64_t *records;
+	size_t max, count;
+};
+
+static
+void *run_worker(void *arg) {
+	struct ScanWorker *w = arg;
+	w->count = scan_range(w->positions, w->begin, w->end, w->pattern, w->records, w->max);
+	return NULL;
+}
+
+size_t scan_positions(const struct Position *positions, size_t length, const struct Pattern *pattern,
+                      unsigned threads, uint64_t *records, size_t max) {
+	if (threads > MAX_THREADS) threads = MAX_THREADS;
+
+	// every slice keeps its first matches, in case the earlier ones have fewer
+	uint64_t *buffer = (threads > 1 && max > 0) ? malloc(threads * max * sizeof *buffer) : NULL;
+
+	if (threads <= 1 || (max > 0 && !buffer))
+		return scan_range(positions, 0, length, pattern, records, max);
+
+	pthread_t handles[MAX_THREADS];
+	struct ScanWorker workers[MAX_THREADS];
+	bool started[MAX_THREADS];
+
+	for (unsigned i = 0; i < threads; i++) {
+		workers[i] = (struct ScanWorker){
+			.positions = positions,
+			.begin = length * i / threads,
+			.end = length * (i + 1) / threads,
+			.pattern = pattern,
+			.records = buffer ? buffer + i * max : NULL,
+			.max = max,
+		};
+
+		// without a thread of its own the slice is scanned here
+		started[i] = pthread_create(&handles[i], NULL, run_worker, &workers[i]) == 0;
+		if (!started[i]) run_worker(&workers[i]);
+	}
+
+	size_t count = 0;
+
+	for (unsigned i = 0; i < threads; i++) {
+		if (started[i]) pthread_join(handles[i], NULL);
+
+		for (size_t j = 0; j < workers[i].count && j < max && count + j < max; j++)
+			records[count + j] = workers[i].records[j];
+
+		count += workers[i].count;
+	}
+
+	free(buffer);
+	return count;
+}
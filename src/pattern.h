@@ -0,0 +1,58 @@
+#ifndef PATTERN_H_
+#define PATTERN_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "position.h"
+
+enum { MAX_PATTERN_TESTS = 64 };
+
+// matches when (pos ^ value) & mask is zero, on all four bitboards
+struct SquareTest {
+	struct Position mask, value;
+};
+
+// A pattern compiled for one side to move: the pieces every match needs,
+// merged into a single test, the squares that must be empty or occupied, then
+// clauses of which one test must match each and tests that no match may pass.
+struct PatternSide {
+	struct SquareTest required;
+	bitboard empty, occupied;
+
+	struct SquareTest alternatives[MAX_PATTERN_TESTS];
+	unsigned clause_ends[MAX_PATTERN_TESTS];
+	unsigned clause_count;
+
+	struct SquareTest forbidden[MAX_PATTERN_TESTS];
+	unsigned forbidden_count;
+};
+
+struct Pattern {
+	struct PatternSide sides[2];
+	enum Color colors[2];
+	unsigned side_count;
+};
+
+// Compiles a pattern in absolute squares and colors, such as
+//
+//     Ne5 Pd4|Pf4 kg8|kh8 !qd8 .e4
+//
+// where every term must hold, `|` separates alternatives, `!` forbids all the
+// alternatives of a term, upper case pieces are white, lower case black and
+// `.` is an empty square. `sides` is a mask of 1 << color of the sides to
+// move to match: the board is stored from the side to move, so each of them
+// is compiled with its own orientation.
+bool compile_pattern(const char *text, unsigned sides, struct Pattern *pattern, FILE *stream);
+
+// the sides to move, as a mask of 1 << color, for which the position matches
+unsigned match_pattern(const struct Pattern *pattern, struct Position pos);
+
+// Scans positions with SIMD in `threads` slices. Returns the number of
+// matches, writing the indices of the first `max` of them in order.
+size_t scan_positions(const struct Position *positions, size_t length, const struct Pattern *pattern,
+                      unsigned threads, uint64_t *records, size_t max);
+
+#endif /*PATTERN_H_*/
@@ -0,0 +1,190 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bits.h"
+#include "pattern.h"
+#include "position.h"
+#include "sort.h"
+#include "state.h"
+#include "text.h"
+#include "timer.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+enum { MAX_LINE = 4096, SHOWN = 10, BENCH_ROUNDS = 3 };
+
+static const struct {
+	const char *name;
+	const char *pattern;
+} SUITE[] = {
+	{ "knight outpost", "Ne5 Pd4|Pf4 !pd6 !pf6" },
+	{ "castled short", "Kg1|Kh1 kg8|kh8 Pf2 Pg2|Pg3 Ph2|Ph3" },
+	{ "open e-file", ".e2 .e3 .e4 .e5 .e6 .e7 Re1|Qe1" },
+	{ "starting rooks", "Ra1 Rh1 ra8 rh8" },
+	{ "no match", "Ka1 ka2" },
+};
+
+// 1 << color of the sides to move in white, black or any
+static
+unsigned parse_sides(const char *text) {
+	if (strcmp(text, "white") == 0) return 1u << WHITE;
+	if (strcmp(text, "black") == 0) return 1u << BLACK;
+	if (strcmp(text, "any") == 0) return 1u << WHITE | 1u << BLACK;
+
+	fprintf(stderr, "side to move must be white, black or any: %s\n", text);
+	return 0;
+}
+
+// in absolute squares, as the lowest side to move it matches for
+static
+void print_position(const struct Pattern *pattern, struct Position pos) {
+	unsigned sides = match_pattern(pattern, pos);
+	struct State state = { .pos = pos, .side_to_move = (sides & (1u << WHITE)) ? WHITE : BLACK, .movenumber = 1 };
+	char buffer[128];
+
+	buffer[generate_fen(state, buffer)] = '\0';
+	printf("%s\n", buffer);
+}
+
+static
+bool scan(const char *path, const char *text, unsigned sides, unsigned threads) {
+	struct PositionFile file;
+	struct Pattern pattern;
+
+	if (!sides || !compile_pattern(text, sides, &pattern, stderr))
+		return false;
+
+	if (!open_position_file(&file, path, stderr))
+		return false;
+
+	uint64_t records[SHOWN];
+
+	double start = wall_time();
+	size_t count = scan_positions(file.positions, file.length, &pattern, threads, records, SHOWN);
+	double seconds = wall_time() - start;
+
+	printf("%zu of %zu positions, %.3fs, %.3f GB/s\n", count, file.length, seconds,
+	       file.length * sizeof(struct Position) / seconds / 1e9);
+
+	for (size_t i = 0; i < count && i < SHOWN; i++)
+		print_position(&pattern, file.positions[records[i]]);
+
+	close_position_file(&file);
+	return true;
+}
+
+// whether a fen matches, for the side to move it gives
+static
+void match(const struct Pattern *pattern, const char *fen) {
+	bool ok;
+	struct State state = parse_fen(fen, &ok, stderr);
+	if (!ok) return;
+
+	bool matched = match_pattern(pattern, state.pos) & (1u << state.side_to_move);
+	printf("%s; %s\n", fen, matched ? "match" : "no match");
+}
+
+// scans the suite with 1, 2, 4, ... and max_threads threads, checking the
+// SIMD count against testing every position in turn
+static
+bool bench(const char *path, unsigned max_threads) {
+	struct PositionFile file;
+
+	if (!open_position_file(&file, path, stderr))
+		return false;
+
+	double bytes = file.length * sizeof(struct Position);
+
+	printf("pattern\t\t| threads\t| matches\t| ms\t\t| GB/s\n");
+
+	for (size_t p = 0; p < sizeof SUITE / sizeof *SUITE; p++) {
+		struct Pattern pattern;
+
+		if (!compile_pattern(SUITE[p].pattern, 1u << WHITE | 1u << BLACK, &pattern, stderr))
+			continue;
+
+		size_t expected = 0;
+		double start = wall_time();
+
+		for (size_t i = 0; i < file.length; i++)
+			expected += match_pattern(&pattern, file.positions[i]) != 0;
+
+		double seconds = wall_time() - start;
+
+		printf("%-15s\t| scalar\t| %zu\t\t| %-10.3f\t| %.3f\n", SUITE[p].name, expected, seconds * 1e3,
+		       bytes / seconds / 1e9);
+
+		// doubling, with max_threads as the last row
+		for (unsigned threads = 1; threads <= max_threads;
+		     threads = (threads < max_threads && 2 * threads > max_threads) ? max_threads : 2 * threads) {
+			size_t count = 0;
+			double best = 0;
+
+			for (int round = 0; round < BENCH_ROUNDS; round++) {
+				start = wall_time();
+				count = scan_positions(file.positions, file.length, &pattern, threads, NULL, 0);
+				seconds = wall_time() - start;
+
+				if (round == 0 || seconds < best) best = seconds;
+			}
+
+			printf("%-15s\t| %u\t\t| %zu\t\t| %-10.3f\t| %.3f%s\n", SUITE[p].name, threads, count, best * 1e3,
+			       bytes / best / 1e9, (count == expected) ? "" : "\t(mismatch)");
+		}
+	}
+
+	close_position_file(&file);
+	return true;
+}
+
+int main(int argc, char **argv) {
+	init_bitbase();
+
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned default_threads = (cores > 0) ? cores : 1;
+
+	// uchess-pattern scan <positions> <pattern> [white | black | any] [threads]
+	if (argc > 3 && strcmp(argv[1], "scan") == 0) {
+		return !scan(argv[2], argv[3], parse_sides((argc > 4) ? argv[4] : "any"),
+		             (argc > 5) ? (unsigned)atoi(argv[5]) : default_threads);
+	}
+
+	// uchess-pattern match <pattern> [fen | -], reading one fen per line from
+	// stdin for -
+	else if (argc > 2 && strcmp(argv[1], "match") == 0) {
+		struct Pattern pattern;
+
+		if (!compile_pattern(argv[2], 1u << WHITE | 1u << BLACK, &pattern, stderr))
+			return 1;
+
+		if (argc > 3 && strcmp(argv[3], "-") != 0) {
+			match(&pattern, argv[3]);
+		}
+
+		else {
+			static char line[MAX_LINE];
+
+			while (fgets(line, sizeof line, stdin)) {
+				line[strcspn(line, "\r\n")] = '\0';
+				if (line[0]) match(&pattern, line);
+			}
+		}
+	}
+
+	// uchess-pattern bench <positions> [max threads]
+	else if (argc > 2 && strcmp(argv[1], "bench") == 0) {
+		return !bench(argv[2], (argc > 3) ? (unsigned)atoi(argv[3]) : default_threads);
+	}
+
+	else {
+		fprintf(stderr, "usage: uchess-pattern scan <positions> <pattern> [white | black | any] [threads]\n"
+		                "       uchess-pattern match <pattern> [fen | -]\n"
+		                "       uchess-pattern bench <positions> [max threads]\n");
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,783 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "perft.h"
+
+#include "movegen.h"
+#include "movetext.h"
+#include "text.h"
+#include "timer.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+enum { MAX_PATH = 4096, MAX_LINE = 256, MAX_ID = 128, MAX_THREADS = 256 };
+
+uint64_t perft(struct Position pos, unsigned depth) {
+	if (depth == 0) return 1;
+
+	struct MoveSet set = generate_move_set(pos);
+	if (depth == 1) return count_moves(&set);
+
+	uint64_t total = 0;
+	struct Move move;
+
+	while (pop_move(&set, &move)) {
+		total += perft(make_move(pos, move), depth - 1);
+	}
+
+	return total;
+}
+
+struct RootShare {
+	struct Position pos;
+	struct MoveList list;
+	unsigned depth;
+
+	size_t next; // root move, taken atomically
+	uint64_t total;
+};
+
+static
+void *run_root_share(void *arg) {
+	struct RootShare *share = arg;
+	size_t i;
+
+	while ((i = __atomic_fetch_add(&share->next, 1, __ATOMIC_RELAXED)) < share->list.length) {
+		uint64_t nodes = perft(make_move(share->pos, share->list.moves[i]), share->depth - 1);
+		__atomic_fetch_add(&share->total, nodes, __ATOMIC_RELAXED);
+	}
+
+	return NULL;
+}
+
+uint64_t parallel_perft(struct Position pos, unsigned depth, unsigned threads) {
+	if (depth <= 1 || threads <= 1) return perft(pos, depth);
+	if (threads > MAX_THREADS) threads = MAX_THREADS;
+
+	struct RootShare share = { .pos = pos, .list = generate_moves(pos), .depth = depth };
+	pthread_t handles[MAX_THREADS];
+
+	// the root moves are shared, so this thread and the ones that started do them all
+	unsigned started = 1;
+
+	while (started < threads && pthread_create(&handles[started], NULL, run_root_share, &share) == 0) {
+		started++;
+	}
+
+	run_root_share(&share);
+
+	for (unsigned t = 1; t < started; t++) pthread_join(handles[t], NULL);
+
+	return share.total;
+}
+
+
+// statistics
+
+// what the moves of a position check, for the side to move
+struct CheckInfo {
+	bitboard king;
+	bitboard occ;
+	bitboard squares[King + 1]; // from which each piece type checks
+
+	// our pieces alone between one of our sliders and their king, with the
+	// line they uncover by leaving it
+	bitboard blockers;
+	bitboard lines[64];
+};
+
+static
+void check_info(struct Position pos, struct CheckInfo *info) {
+	enum Color c = turn(pos);
+	bitboard us = side(pos, c);
+
+	info->occ = occupied(pos);
+	info->king = extract(pos, King) & ~us;
+	square ksq = lsb(info->king);
+
+	info->squares[Pawn]   = pawn_attacks(!c, info->king);
+	info->squares[Knight] = knight_attacks(ksq);
+	info->squares[Bishop] = bishop_attacks(ksq, info->occ);
+	info->squares[Rook]   = rook_attacks(ksq, info->occ);
+	info->squares[Queen]  = info->squares[Bishop] | info->squares[Rook];
+	info->squares[King]   = 0;
+
+	bitboard bishops = (extract(pos, Bishop) | extract(pos, Queen)) & us;
+	bitboard rooks   = (extract(pos, Rook)   | extract(pos, Queen)) & us;
+	bitboard snipers = (bishop_attacks(ksq, 0) & bishops) | (rook_attacks(ksq, 0) & rooks);
+
+	info->blockers = 0;
+
+	while (snipers) {
+		bitboard sniper = snipers & -snipers;
+		bitboard line = line_between(info->king, sniper);
+		bitboard blockers = line & info->occ;
+
+		if (blockers && !(blockers & (blockers - 1)) && (blockers & us)) {
+			info->blockers |= blockers;
+			info->lines[lsb(blockers)] = line | sniper;
+		}
+
+		snipers &= snipers - 1;
+	}
+}
+
+// a bitboard of the parent in the orientation of the child
+static inline
+bitboard after_move(bitboard bb) {
+#ifdef ABSOLUTE_COLORS
+	return bb;
+#else
+	return rotate(bb);
+#endif
+}
+
+static
+void leaf_stats(struct Position pos, struct PerftStats *stats) {
+	struct MoveList list = generate_moves(pos);
+	struct CheckInfo info;
+
+	check_info(pos, &info);
+	bitboard them = info.occ & ~side(pos, turn(pos));
+
+	stats->nodes += list.length;
+
+	for (size_t i = 0; i < list.length; i++) {
+		struct Move move = list.moves[i];
+		bitboard start = 1ULL << move.start, end = 1ULL << move.end;
+
+		enum PieceType T = get_piece(pos, move.start);
+		bool capture = (them & end) != 0;
+		bool en_passant = T == Pawn && !capture && ((move.start ^ move.end) & 7);
+		bool direct, discovered, double_check;
+
+		stats->captures += capture || en_passant;
+		stats->en_passant += en_passant;
+		stats->castles += move.castling;
+		stats->promotions += T == Pawn && move.piece != Pawn;
+
+		// a second piece moves or leaves the board
+		if (en_passant || move.castling) {
+			struct Position child = make_move(pos, move);
+			bitboard checkers = enemy_checks(child);
+			bitboard moved = after_move(move.castling ? 1ULL << ((move.start + move.end) >> 1) : end);
+
+			// en passant can uncover two lines at once
+			direct = (checkers & moved) != 0;
+			discovered = (checkers & ~moved) != 0;
+			double_check = popcount(checkers) > 1;
+		}
+
+		else {
+			// a promoted piece sees through the square it left
+			if (T != move.piece) {
+				bitboard occ = (info.occ ^ start) | end;
+				bitboard attacks = (move.piece == Knight) ? knight_attacks(move.end)
+				                 : (move.piece == Bishop) ? bishop_attacks(move.end, occ)
+				                 : (move.piece == Rook)   ? rook_attacks(move.end, occ)
+				                 : queen_attacks(move.end, occ);
+
+				direct = (attacks & info.king) != 0;
+			}
+
+			else {
+				direct = (info.squares[T] & end) != 0;
+			}
+
+			discovered = (info.blockers & start) && !(info.lines[move.start] & end);
+			double_check = direct && discovered;
+		}
+
+		if (!direct && !discovered)
+			continue;
+
+		struct Position child = make_move(pos, move);
+		struct MoveSet replies = generate_move_set(child);
+
+		stats->checks++;
+		stats->discovered_checks += discovered && !double_check;
+		stats->double_checks += double_check;
+		stats->mates += !has_moves(&replies);
+	}
+}
+
+void perft_stats(struct Position pos, unsigned depth, struct PerftStats *stats) {
+	if (depth == 1) {
+		leaf_stats(pos, stats);
+		return;
+	}
+
+	struct MoveSet set = generate_move_set(pos);
+	struct Move move;
+
+	while (pop_move(&set, &move)) {
+		perft_stats(make_move(pos, move), depth - 1, stats);
+	}
+}
+
+
+// files of a job
+
+// writes a whole file under a temporary name first, so readers only ever see
+// complete files
+static
+bool write_file(const char *path, const char *temp, const char *text) {
+	FILE *file = fopen(temp, "w");
+	if (!file) return false;
+
+	bool ok = fputs(text, file) >= 0;
+	ok &= fclose(file) == 0;
+
+	if (!ok || rename(temp, path) != 0) {
+		remove(temp);
+		return false;
+	}
+
+	return true;
+}
+
+// a unit: its position, the paths reaching it and the checkpoint
+struct Unit {
+	struct State state;
+	uint64_t paths;
+	size_t next;      // moves counted so far, in the order of their UCI
+	uint64_t partial; // their count for one path
+};
+
+static
+bool write_unit(const char *path, const char *temp, const struct Unit *unit) {
+	char fen[MAX_LINE], text[MAX_LINE * 2];
+	fen[generate_fen(unit->state, fen)] = '\0';
+
+	snprintf(text, sizeof text, "%s\n%llu %zu %llu\n", fen, (unsigned long long)unit->paths, unit->next,
+	         (unsigned long long)unit->partial);
+
+	return write_file(path, temp, text);
+}
+
+static
+bool read_unit(const char *path, struct Unit *unit) {
+	FILE *file = fopen(path, "r");
+	if (!file) return false;
+
+	char fen[MAX_LINE];
+	unsigned long long paths, partial;
+	bool ok = fgets(fen, sizeof fen, file) && fscanf(file, "%llu %zu %llu", &paths, &unit->next, &partial) == 3;
+	fclose(file);
+
+	if (!ok) return false;
+
+	fen[strcspn(fen, "\r\n")] = '\0';
+	unit->state = parse_fen(fen, &ok, stderr);
+	unit->paths = paths;
+	unit->partial = partial;
+
+	return ok;
+}
+
+struct Job {
+	unsigned depth, split;
+	size_t units;
+};
+
+static
+bool read_job(const char *dir, struct Job *job, FILE *stream) {
+	char path[MAX_PATH];
+	snprintf(path, sizeof path, "%s/job", dir);
+
+	FILE *file = fopen(path, "r");
+	bool ok = file && fscanf(file, "%u %u %zu", &job->depth, &job->split, &job->units) == 3;
+
+	if (file) fclose(file);
+	if (!ok) fprintf(stream, "%s is not a perft job\n", dir);
+
+	return ok;
+}
+
+
+// splitting
+
+struct UnitList {
+	struct Unit *units;
+	size_t length, capacity;
+};
+
+static
+bool collect_units(struct UnitList *list, struct State state, unsigned plies) {
+	if (plies == 0) {
+		if (list->length == list->capacity) {
+			size_t capacity = list->capacity ? 2 * list->capacity : 1024;
+			struct Unit *units = realloc(list->units, capacity * sizeof *units);
+
+			if (!units) return false;
+
+			list->units = units;
+			list->capacity = capacity;
+		}
+
+		list->units[list->length++] = (struct Unit){ .state = state, .paths = 1 };
+		return true;
+	}
+
+	struct MoveList moves = generate_moves(state.pos);
+
+	for (size_t i = 0; i < moves.length; i++) {
+		if (!collect_units(list, play_move(state, moves.moves[i]), plies - 1))
+			return false;
+	}
+
+	return true;
+}
+
+static
+int compare_units(const void *a, const void *b) {
+	return compare_positions(((const struct Unit *)a)->state.pos, ((const struct Unit *)b)->state.pos);
+}
+
+static
+bool make_directory(const char *dir, const char *name, FILE *stream) {
+	char path[MAX_PATH];
+	snprintf(path, sizeof path, "%s%s", dir, name);
+
+	if (mkdir(path, 0777) != 0 && errno != EEXIST) {
+		fprintf(stream, "failed to create %s\n", path);
+		return false;
+	}
+
+	return true;
+}
+
+bool split_perft(const char *dir, struct State root, unsigned depth, unsigned split, FILE *stream) {
+	char path[MAX_PATH], temp[MAX_PATH];
+
+	if (split > depth) split = depth;
+
+	if (!make_directory(dir, "", stream) || !make_directory(dir, "/pending", stream)
+	 || !make_directory(dir, "/active", stream) || !make_directory(dir, "/done", stream))
+		return false;
+
+	snprintf(path, sizeof path, "%s/job", dir);
+
+	if (access(path, F_OK) == 0) {
+		fprintf(stream, "%s already holds a job\n", dir);
+		return false;
+	}
+
+	struct UnitList list = {0};
+
+	if (!collect_units(&list, root, split)) {
+		fprintf(stream, "failed to allocate the units\n");
+		free(list.units);
+		return false;
+	}
+
+	// transpositions share a unit, counted once for each path
+	qsort(list.units, list.length, sizeof *list.units, compare_units);
+	size_t units = 0;
+
+	for (size_t i = 0; i < list.length; i++) {
+		if (units && same_position(list.units[units - 1].state.pos, list.units[i].state.pos))
+			list.units[units - 1].paths++;
+		else
+			list.units[units++] = list.units[i];
+	}
+
+	bool ok = true;
+
+	for (size_t i = 0; i < units && ok; i++) {
+		snprintf(path, sizeof path, "%s/pending/%zu", dir, i);
+		snprintf(temp, sizeof temp, "%s/pending/%zu.tmp", dir, i);
+
+		ok = write_unit(path, temp, &list.units[i]);
+	}
+
+	// the job is written last, so a job file means every unit is pending
+	if (ok) {
+		char fen[MAX_LINE], text[MAX_LINE * 2];
+		fen[generate_fen(root, fen)] = '\0';
+
+		snprintf(text, sizeof text, "%u %u %zu\n%s\n", depth, split, units, fen);
+
+		snprintf(path, sizeof path, "%s/job", dir);
+		snprintf(temp, sizeof temp, "%s/job.tmp", dir);
+
+		ok = write_file(path, temp, text);
+	}
+
+	if (!ok) fprintf(stream, "failed to write the units of %s\n", dir);
+
+	free(list.units);
+	return ok;
+}
+
+
+// working
+
+struct WorkContext {
+	const char *dir;
+	const struct PerftWorkConfig *config;
+	struct Job job;
+	FILE *stream;
+
+	pthread_mutex_t lock;
+	struct PerftWorkStats stats;
+	bool failed;
+};
+
+struct Worker {
+	struct WorkContext *context;
+	char id[MAX_ID];
+
+	DIR *pending;
+	bool rewound;
+};
+
+// the unit number of a file name, which starts with it
+static inline
+bool unit_number(const char *name, size_t *unit) {
+	char *end;
+	if (name[0] < '0' || name[0] > '9') return false;
+
+	*unit = strtoull(name, &end, 10);
+	return *end == '\0' || *end == '.';
+}
+
+// Renaming keeps the modification time the file had, which for a unit
+// split long ago or left by a dead worker would make it stale at once, so a
+// claimed unit is touched to start its heartbeat.
+static inline
+bool touch(const char *path) {
+	return utimensat(AT_FDCWD, path, NULL, 0) == 0;
+}
+
+// whether a unit is already counted, its active file being a leftover
+static inline
+bool unit_done(const struct WorkContext *c, size_t unit) {
+	char path[MAX_PATH];
+	struct stat info;
+
+	snprintf(path, sizeof path, "%s/done/%zu", c->dir, unit);
+	return stat(path, &info) == 0;
+}
+
+// moves the next pending unit to the active directory
+static
+bool claim_pending(struct Worker *w, size_t *unit, char *active) {
+	struct WorkContext *c = w->context;
+	char path[MAX_PATH];
+
+	for (;;) {
+		struct dirent *entry = readdir(w->pending);
+
+		// go over the directory again once, for units renamed while reading
+		if (!entry) {
+			if (w->rewound) return false;
+
+			rewinddir(w->pending);
+			w->rewound = true;
+			continue;
+		}
+
+		if (!unit_number(entry->d_name, unit) || strchr(entry->d_name, '.'))
+			continue;
+
+		snprintf(path, MAX_PATH, "%s/pending/%s", c->dir, entry->d_name);
+		snprintf(active, MAX_PATH, "%s/active/%zu.%s", c->dir, *unit, w->id);
+
+		if (rename(path, active) == 0) {
+			touch(active);
+			w->rewound = false;
+			return true;
+		}
+	}
+}
+
+// takes over an active unit without a checkpoint for `stale` seconds
+static
+bool claim_stale(struct Worker *w, size_t *unit, char *active) {
+	struct WorkContext *c = w->context;
+	char dir[MAX_PATH], path[MAX_PATH];
+	bool claimed = false;
+
+	snprintf(dir, sizeof dir, "%s/active", c->dir);
+	DIR *d = opendir(dir);
+	if (!d) return false;
+
+	struct dirent *entry;
+	time_t now = time(NULL);
+
+	while (!claimed && (entry = readdir(d))) {
+		size_t length = strlen(entry->d_name);
+		struct stat info;
+
+		if (!unit_number(entry->d_name, unit) || (length > 4 && strcmp(entry->d_name + length - 4, ".tmp") == 0))
+			continue;
+
+		snprintf(path, sizeof path, "%s/%s", dir, entry->d_name);
+
+		if (stat(path, &info) != 0 || difftime(now, info.st_mtime) < c->config->stale)
+			continue;
+
+		// its worker finished the unit but died before removing the file
+		if (unit_done(c, *unit)) {
+			remove(path);
+			continue;
+		}
+
+		snprintf(active, MAX_PATH, "%s/%zu.%s", dir, *unit, w->id);
+		claimed = rename(path, active) == 0;
+		if (claimed) touch(active);
+	}
+
+	closedir(d);
+	return claimed;
+}
+
+// entries of a move's index then its UCI
+static
+int compare_uci(const void *a, const void *b) {
+	return strcmp((const char *)a + 1, (const char *)b + 1);
+}
+
+// Counts a claimed unit from its checkpoint, writing checkpoints on the way.
+// If another worker took the unit over, it is given up without being counted.
+static
+bool count_unit(struct Worker *w, size_t number, const char *active) {
+	struct WorkContext *c = w->context;
+	char path[MAX_PATH], temp[MAX_PATH];
+	struct Unit unit;
+
+	if (!read_unit(active, &unit)) {
+		fprintf(c->stream, "%s is not a unit\n", active);
+		return false;
+	}
+
+	unsigned remaining = c->job.depth - c->job.split;
+	uint64_t nodes = 0;
+
+	if (remaining == 0) {
+		unit.partial = 1;
+	}
+
+	// the moves in the order of their UCI, which doesn't depend on the
+	// build, so any worker can resume the checkpoint
+	else {
+		struct MoveList list = generate_moves(unit.state.pos);
+		char uci[MAX_MOVELIST_LENGTH][8];
+		struct Move moves[MAX_MOVELIST_LENGTH];
+
+		for (size_t i = 0; i < list.length; i++) {
+			size_t length = generate_uci(list.moves[i], unit.state, uci[i] + 1);
+			uci[i][0] = (char)i, uci[i][length + 1] = '\0';
+		}
+
+		qsort(uci, list.length, sizeof uci[0], compare_uci);
+
+		for (size_t i = 0; i < list.length; i++)
+			moves[i] = list.moves[(unsigned char)uci[i][0]];
+
+		double last = wall_time();
+		snprintf(temp, sizeof temp, "%s.tmp", active);
+
+		for (size_t i = unit.next; i < list.length; i++) {
+			uint64_t count = perft(make_move(unit.state.pos, moves[i]), remaining - 1);
+
+			unit.partial += count;
+			unit.next = i + 1;
+			nodes += count;
+
+			if (unit.next < list.length && wall_time() - last >= c->config->checkpoint) {
+				struct stat info;
+
+				// renaming the checkpoint would bring back a unit taken over
+				if (stat(active, &info) != 0)
+					return true;
+
+				if (!write_unit(active, temp, &unit)) {
+					fprintf(c->stream, "failed to write the checkpoint %s\n", active);
+					return false;
+				}
+
+				last = wall_time();
+			}
+		}
+	}
+
+	char text[MAX_LINE];
+	snprintf(text, sizeof text, "%llu\n", (unsigned long long)(unit.partial * unit.paths));
+	snprintf(path, sizeof path, "%s/done/%zu", c->dir, number);
+	snprintf(temp, sizeof temp, "%s/done/%zu.%s.tmp", c->dir, number, w->id);
+
+	if (!write_file(path, temp, text)) {
+		fprintf(c->stream, "failed to write %s\n", path);
+		return false;
+	}
+
+	remove(active);
+
+	pthread_mutex_lock(&c->lock);
+	c->stats.units++;
+	c->stats.nodes += nodes;
+	pthread_mutex_unlock(&c->lock);
+
+	return true;
+}
+
+static
+void *run_worker(void *arg) {
+	struct Worker *w = arg;
+	struct WorkContext *c = w->context;
+
+	char active[MAX_PATH];
+	size_t unit;
+
+	while (!__atomic_load_n(&c->failed, __ATOMIC_RELAXED)) {
+		bool resumed = false;
+
+		if (!claim_pending(w, &unit, active)) {
+			if (!claim_stale(w, &unit, active)) break;
+			resumed = true;
+		}
+
+		if (!count_unit(w, unit, active)) {
+			__atomic_store_n(&c->failed, true, __ATOMIC_RELAXED);
+			break;
+		}
+
+		if (resumed) {
+			pthread_mutex_lock(&c->lock);
+			c->stats.resumed++;
+			pthread_mutex_unlock(&c->lock);
+		}
+	}
+
+	return NULL;
+}
+
+bool work_perft(const char *dir, const struct PerftWorkConfig *config, struct PerftWorkStats *stats, FILE *stream) {
+	struct WorkContext context = { .dir = dir, .config = config, .stream = stream };
+	unsigned threads = (config->threads < 1) ? 1 : (config->threads > MAX_THREADS) ? MAX_THREADS : config->threads;
+
+	*stats = (struct PerftWorkStats){0};
+
+	if (!read_job(dir, &context.job, stream))
+		return false;
+
+	char host[MAX_ID / 2] = "host", path[MAX_PATH];
+	gethostname(host, sizeof host - 1);
+	host[sizeof host - 1] = '\0';
+
+	// file names of units are split at the first dot
+	for (char *p = host; *p; p++)
+		if (*p == '.' || *p == '/') *p = '-';
+
+	struct Worker *workers = calloc(threads, sizeof *workers);
+	pthread_t handles[MAX_THREADS];
+	unsigned started = 0;
+
+	if (!workers) {
+		fprintf(stream, "failed to allocate %u workers\n", threads);
+		return false;
+	}
+
+	pthread_mutex_init(&context.lock, NULL);
+	snprintf(path, sizeof path, "%s/pending", dir);
+	double start = wall_time();
+
+	for (; started < threads; started++) {
+		struct Worker *w = &workers[started];
+
+		w->context = &context;
+		snprintf(w->id, sizeof w->id, "%s-%ld-%u", host, (long)getpid(), started);
+
+		if (!(w->pending = opendir(path))) {
+			fprintf(stream, "failed to open %s\n", path);
+			context.failed = true;
+			break;
+		}
+
+		if (pthread_create(&handles[started], NULL, run_worker, w) != 0) {
+			fprintf(stream, "failed to start worker %u\n", started);
+			closedir(w->pending);
+			context.failed = true;
+			break;
+		}
+	}
+
+	for (unsigned i = 0; i < started; i++) {
+		pthread_join(handles[i], NULL);
+		closedir(workers[i].pending);
+	}
+
+	context.stats.seconds = wall_time() - start;
+	*stats = context.stats;
+
+	pthread_mutex_destroy(&context.lock);
+	free(workers);
+	return !context.failed;
+}
+
+
+// merging
+
+// the unit files of a directory, with the sum of their counts for done/
+static
+size_t count_files(const char *dir, const char *name, uint64_t *sum) {
+	char path[MAX_PATH];
+	snprintf(path, sizeof path, "%s/%s", dir, name);
+
+	DIR *d = opendir(path);
+	if (!d) return 0;
+
+	struct dirent *entry;
+	size_t count = 0, unit;
+
+	while ((entry = readdir(d))) {
+		size_t length = strlen(entry->d_name);
+
+		if (!unit_number(entry->d_name, &unit) || (length > 4 && strcmp(entry->d_name + length - 4, ".tmp") == 0))
+			continue;
+
+		if (sum) {
+			unsigned long long nodes;
+			snprintf(path, sizeof path, "%s/%s/%s", dir, name, entry->d_name);
+
+			FILE *file = fopen(path, "r");
+			if (!file) continue;
+
+			bool ok = fscanf(file, "%llu", &nodes) == 1;
+			fclose(file);
+
+			if (!ok) continue;
+			*sum += nodes;
+		}
+
+		count++;
+	}
+
+	closedir(d);
+	return count;
+}
+
+bool merge_perft(const char *dir, struct PerftProgress *progress, FILE *stream) {
+	struct Job job;
+	*progress = (struct PerftProgress){0};
+
+	if (!read_job(dir, &job, stream))
+		return false;
+
+	progress->units = job.units;
+	progress->depth = job.depth;
+	progress->pending = count_files(dir, "pending", NULL);
+	progress->active = count_files(dir, "active", NULL);
+	progress->done = count_files(dir, "done", &progress->nodes);
+
+	return true;
+}
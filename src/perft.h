@@ -0,0 +1,78 @@
+#ifndef PERFT_H_
+#define PERFT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "position.h"
+#include "state.h"
+
+// leaf nodes of the tree to `depth`, counting the moves of the last ply
+// without making them
+uint64_t perft(struct Position pos, unsigned depth);
+
+// perft with the moves of the root shared between threads
+uint64_t parallel_perft(struct Position pos, unsigned depth, unsigned threads);
+
+// The moves of the last ply by category, as in the tables of
+// https://www.chessprogramming.org/Perft_Results: checks include discovered
+// and double checks, and discovered checks exclude double checks.
+struct PerftStats {
+	uint64_t nodes, captures, en_passant, castles, promotions;
+	uint64_t checks, discovered_checks, double_checks, mates;
+};
+
+// Sorts the moves of the last ply into categories from the squares that give
+// check and the blockers of discovered checks of their parent, only making
+// the checking moves to look for mates (and castling and en passant, which
+// move or remove a second piece). `depth` is at least 1.
+void perft_stats(struct Position pos, unsigned depth, struct PerftStats *stats);
+
+// A perft job is a directory of work units, the distinct positions `split`
+// plies from the root, each with the number of paths reaching it:
+//
+//   job              depth, split ply, unit count and the root fen
+//   pending/<n>      units not yet claimed
+//   active/<n>.<id>  units claimed by a worker (hostname, process and thread),
+//                    holding its checkpoint: the moves of the unit done and
+//                    their count so far
+//   done/<n>         the count of each finished unit
+//
+// Units are claimed and finished by renaming files, which is atomic on POSIX
+// file systems, so workers on any number of hosts sharing the directory can
+// run at once. Checkpoints are renamed over the active file too, keeping its
+// modification time as a heartbeat.
+bool split_perft(const char *dir, struct State root, unsigned depth, unsigned split, FILE *stream);
+
+struct PerftWorkConfig {
+	unsigned threads;
+	double checkpoint; // seconds between checkpoints
+	double stale;      // seconds after which an active unit is taken over
+};
+
+struct PerftWorkStats {
+	size_t units, resumed;
+	uint64_t nodes;
+	double seconds;
+};
+
+// Claims and counts units until none are left, resuming active units whose
+// checkpoint is older than `stale` seconds from their last checkpoint, as
+// their worker is taken to have died. A checkpoint is only written between
+// the moves of a unit, so `stale` must be well above both the checkpoint
+// interval of every worker and the time the slowest worker takes over the
+// largest subtree of a single move of a unit.
+bool work_perft(const char *dir, const struct PerftWorkConfig *config, struct PerftWorkStats *stats, FILE *stream);
+
+struct PerftProgress {
+	size_t units, pending, active, done;
+	uint64_t nodes; // of the finished units
+	unsigned depth;
+};
+
+// sums the finished units, the total being complete once every unit is done
+bool merge_perft(const char *dir, struct PerftProgress *progress, FILE *stream);
+
+#endif /*PERFT_H_*/
@@ -0,0 +1,263 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bits.h"
+#include "movegen.h"
+#include "perft.h"
+#include "state.h"
+#include "text.h"
+#include "timer.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+enum { MAX_PATH = 4096, CHECKPOINT = 60, STALE = 600, BENCH_DEPTH = 5, BENCH_SPLIT = 2 };
+
+static
+unsigned default_threads() {
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return (n < 1) ? 1 : (n > 256) ? 256 : n;
+}
+
+static
+void print_stats_header() {
+	printf("depth\t| nodes\t\t| captures\t| e.p.\t\t| castles\t| promotions\t| checks\t"
+	       "| discovered\t| double\t| mates\t\t| Mnps\n");
+}
+
+static
+void print_stats(unsigned depth, const struct PerftStats *s, double seconds) {
+	printf("%u\t| %-10llu\t| %-10llu\t| %-10llu\t| %-10llu\t| %-10llu\t| %-10llu\t| %-10llu\t| %-10llu\t"
+	       "| %-10llu\t| %.1f\n", depth, (unsigned long long)s->nodes, (unsigned long long)s->captures,
+	       (unsigned long long)s->en_passant, (unsigned long long)s->castles, (unsigned long long)s->promotions,
+	       (unsigned long long)s->checks, (unsigned long long)s->discovered_checks,
+	       (unsigned long long)s->double_checks, (unsigned long long)s->mates, s->nodes / seconds / 1e6);
+}
+
+// the moves of the root in UCI order, each with the nodes below it
+static
+void divide(struct State state, unsigned depth) {
+	struct MoveList list = generate_moves(state.pos);
+	char uci[MAX_MOVELIST_LENGTH][8];
+	uint64_t total = 0;
+
+	for (size_t i = 0; i < list.length; i++) {
+		uci[i][generate_uci(list.moves[i], state, uci[i])] = '\0';
+	}
+
+	for (size_t i = 0; i < list.length; i++) {
+		// selection sort, the list is short
+		size_t first = i;
+
+		for (size_t j = i + 1; j < list.length; j++)
+			if (strcmp(uci[j], uci[first]) < 0) first = j;
+
+		struct Move move = list.moves[first];
+		char name[8];
+
+		memcpy(name, uci[first], sizeof name);
+		memcpy(uci[first], uci[i], sizeof name);
+		list.moves[first] = list.moves[i];
+
+		uint64_t nodes = depth ? perft(make_move(state.pos, move), depth - 1) : 0;
+		printf("%s: %llu\n", name, (unsigned long long)nodes);
+		total += nodes;
+	}
+
+	printf("\nmoves: %zu\nnodes: %llu\n", list.length, (unsigned long long)total);
+}
+
+// prints the progress of a job, returning whether every unit is done
+static
+bool report(const char *dir) {
+	struct PerftProgress progress;
+
+	if (!merge_perft(dir, &progress, stderr))
+		return false;
+
+	printf("%zu of %zu units done, %zu pending, %zu active\n", progress.done, progress.units, progress.pending,
+	       progress.active);
+
+	bool complete = progress.done == progress.units;
+	printf("perft %u: %llu%s\n", progress.depth, (unsigned long long)progress.nodes, complete ? "" : " so far");
+
+	return complete;
+}
+
+// rows of https://www.chessprogramming.org/Perft_Results
+static const struct {
+	int position; // of perft_positions
+	unsigned depth;
+	struct PerftStats stats;
+} stats_tables[] = {
+	{ 0, 5, { 4865609, 82719, 258, 0, 0, 27351, 6, 0, 347 } },
+	{ 1, 4, { 4085603, 757163, 1929, 128013, 15172, 25523, 42, 6, 43 } },
+	{ 2, 5, { 674624, 52051, 1165, 0, 0, 52950, 1292, 3, 0 } },
+};
+
+// statistics perft against the published tables
+static
+void bench_stats() {
+	int count = sizeof stats_tables / sizeof stats_tables[0];
+	print_stats_header();
+
+	for (int i = 0; i < count; i++) {
+		bool ok;
+		struct State state = parse_fen(perft_positions[stats_tables[i].position], &ok, stderr);
+		struct PerftStats stats = {0};
+
+		double start = wall_time();
+		perft_stats(state.pos, stats_tables[i].depth, &stats);
+		print_stats(stats_tables[i].depth, &stats, wall_time() - start);
+
+		if (memcmp(&stats, &stats_tables[i].stats, sizeof stats) != 0)
+			printf("MISMATCH with the table of position %d\n", stats_tables[i].position + 1);
+	}
+
+	printf("\n");
+}
+
+// the statistics tables, then nodes/sec of each bench position in one thread,
+// over every thread, and split into a job in `dir` then worked and merged
+static
+void bench(const char *dir, unsigned depth, unsigned threads) {
+	int count = PERFT_POSITIONS;
+	char path[MAX_PATH];
+
+	struct PerftWorkConfig config = { .threads = threads, .checkpoint = CHECKPOINT, .stale = STALE };
+
+	bench_stats();
+
+	mkdir(dir, 0777);
+	printf("position| nodes\t\t| 1 thread\t| %u threads\t| job\t\t| units\n", threads);
+
+	for (int i = 0; i < count; i++) {
+		bool ok;
+		struct State state = parse_fen(perft_positions[i], &ok, stderr);
+
+		double start = wall_time();
+		uint64_t single = perft(state.pos, depth);
+		double mid = wall_time();
+		uint64_t parallel = parallel_perft(state.pos, depth, threads);
+		double end = wall_time();
+
+		snprintf(path, sizeof path, "%s/%d", dir, i);
+
+		struct PerftWorkStats stats;
+		struct PerftProgress progress;
+
+		if (!split_perft(path, state, depth, BENCH_SPLIT, stderr) || !work_perft(path, &config, &stats, stderr)
+		 || !merge_perft(path, &progress, stderr))
+			return;
+
+		double job = wall_time() - end;
+		bool same = parallel == single && progress.nodes == single && progress.done == progress.units;
+
+		printf("%d\t| %-10llu\t| %-7.1f Mnps\t| %-7.1f Mnps\t| %-7.1f Mnps\t| %zu %s\n", i + 1,
+		       (unsigned long long)single, single / (mid - start) / 1e6, single / (end - mid) / 1e6,
+		       single / job / 1e6, progress.units, same ? "ok" : "MISMATCH");
+	}
+}
+
+int main(int argc, char **argv) {
+	init_bitbase();
+
+	// uchess-perft run <fen> <depth> [threads]
+	if (argc > 3 && strcmp(argv[1], "run") == 0) {
+		bool ok;
+		struct State state = parse_fen(argv[2], &ok, stderr);
+		if (!ok) return 1;
+
+		unsigned threads = (argc > 4) ? (unsigned)atoi(argv[4]) : default_threads();
+
+		double start = wall_time();
+		uint64_t nodes = parallel_perft(state.pos, atoi(argv[3]), threads);
+		double seconds = wall_time() - start;
+
+		printf("perft %d: %llu, %.3f s, %.1f Mnps\n", atoi(argv[3]), (unsigned long long)nodes, seconds,
+		       nodes / seconds / 1e6);
+		return 0;
+	}
+
+	// uchess-perft stats <fen> <depth>, for each depth up to `depth`
+	if (argc > 3 && strcmp(argv[1], "stats") == 0) {
+		bool ok;
+		struct State state = parse_fen(argv[2], &ok, stderr);
+		if (!ok) return 1;
+
+		print_stats_header();
+
+		for (int depth = 1; depth <= atoi(argv[3]); depth++) {
+			struct PerftStats stats = {0};
+
+			double start = wall_time();
+			perft_stats(state.pos, depth, &stats);
+			print_stats(depth, &stats, wall_time() - start);
+		}
+
+		return 0;
+	}
+
+	// uchess-perft divide <fen> <depth>
+	if (argc > 3 && strcmp(argv[1], "divide") == 0) {
+		bool ok;
+		struct State state = parse_fen(argv[2], &ok, stderr);
+		if (!ok) return 1;
+
+		divide(state, atoi(argv[3]));
+		return 0;
+	}
+
+	// uchess-perft split <dir> <fen> <depth> <split ply>
+	if (argc > 5 && strcmp(argv[1], "split") == 0) {
+		bool ok;
+		struct State state = parse_fen(argv[3], &ok, stderr);
+
+		if (!ok || !split_perft(argv[2], state, atoi(argv[4]), atoi(argv[5]), stderr))
+			return 1;
+
+		report(argv[2]);
+		return 0;
+	}
+
+	// uchess-perft work <dir> [threads] [checkpoint seconds] [stale seconds]
+	if (argc > 2 && strcmp(argv[1], "work") == 0) {
+		struct PerftWorkConfig config = {
+			.threads = (argc > 3) ? (unsigned)atoi(argv[3]) : default_threads(),
+			.checkpoint = (argc > 4) ? atof(argv[4]) : CHECKPOINT,
+			.stale = (argc > 5) ? atof(argv[5]) : STALE,
+		};
+
+		struct PerftWorkStats stats;
+		bool ok = work_perft(argv[2], &config, &stats, stderr);
+
+		printf("%zu units (%zu resumed), %llu nodes, %.3f s, %.1f Mnps\n", stats.units, stats.resumed,
+		       (unsigned long long)stats.nodes, stats.seconds, stats.nodes / stats.seconds / 1e6);
+
+		return !ok;
+	}
+
+	// uchess-perft merge <dir>, failing until every unit is done
+	if (argc > 2 && strcmp(argv[1], "merge") == 0) {
+		return !report(argv[2]);
+	}
+
+	// uchess-perft bench <dir> [depth] [threads]
+	if (argc > 2 && strcmp(argv[1], "bench") == 0) {
+		bench(argv[2], (argc > 3) ? (unsigned)atoi(argv[3]) : BENCH_DEPTH,
+		      (argc > 4) ? (unsigned)atoi(argv[4]) : default_threads());
+		return 0;
+	}
+
+	fprintf(stderr, "usage: uchess-perft run <fen> <depth> [threads]\n"
+	                "       uchess-perft stats <fen> <depth>\n"
+	                "       uchess-perft divide <fen> <depth>\n"
+	                "       uchess-perft split <dir> <fen> <depth> <split ply>\n"
+	                "       uchess-perft work <dir> [threads] [checkpoint seconds] [stale seconds]\n"
+	                "       uchess-perft merge <dir>\n"
+	                "       uchess-perft bench <dir> [depth] [threads]\n");
+	return 1;
+}
@@ -1,6 +1,7 @@
 #include "bits.h"
 #include "movegen.h"
 #include "position.h"
+#include <stdbool.h>
 #include <string.h>
 
 // note: square must be None
@@ -13,10 +14,11 @@ void set_square(struct Position *pos, square sq, enum PieceType T) {
 	pos->Z |= (bitboard)((T >> 2) & 1) << sq;
 }
 
-struct Position make_move(struct Position pos, struct Move move) {
+static always_inline
+struct Position make_move_for(struct Position pos, struct Move move, enum Color c) {
 	bitboard occ = occupied(pos);
 	bitboard info = pext(extract(pos, Info), ~occ);
-	bitboard ep_mask = (info & EP_MASK) << 40;
+	bitboard ep_mask = relative(c, (info & EP_MASK) << 40);
 
 	enum { A1 = 0, E1 = 4, H1 = 7, A8 = 56, H8 = 63 };
 
@@ -27,11 +29,11 @@ struct Position make_move(struct Position pos, struct Move move) {
 
 	// remove captured en-passant pawn
 	if (move.piece == Pawn)
-		clear |= shift(S, ep_mask & (1ULL << move.end));
+		clear |= backward(c, ep_mask & (1ULL << move.end));
 
 	// remove castling rook
 	if (move.castling)
-		clear |= (move.end < move.start) ? (1 << A1) : (1 << H1);
+		clear |= 1ULL << relative_square(c, (move.end < move.start) ? A1 : H1);
 
 	// clear bits
 	pos.white &= ~clear;
@@ -40,7 +42,7 @@ struct Position make_move(struct Position pos, struct Move move) {
 	pos.Z &= ~clear;
 
 	// set moved pieces
-	pos.white |= 1ULL << move.end;
+	if (c == WHITE) pos.white |= 1ULL << move.end;
 	set_square(&pos, move.end, move.piece);
 
 	// set castled rook
@@ -48,18 +50,32 @@ struct Position make_move(struct Position pos, struct Move move) {
 		square mid = (move.start + move.end) >> 1;
 		set_square(&pos, mid, Rook);
 
-		pos.white |= 1ULL << mid;
+		if (c == WHITE) pos.white |= 1ULL << mid;
 	}
 
 	// update castling rights
 	if (move.piece == King)
-		info &= ~(WK_MASK | WQ_MASK);
+		info &= ~(kingside(c) | queenside(c));
+
+	if (move.start == relative_square(c, A1)) info &= ~queenside(c);
+	if (move.start == relative_square(c, H1)) info &= ~kingside(c);
+	if (move.end   == relative_square(c, A8)) info &= ~queenside(!c);
+	if (move.end   == relative_square(c, H8)) info &= ~kingside(!c);
+
+	// update new en-passant square
+	bool double_push = move.piece == Pawn
+	                && (move.start ^ move.end) == 16;
 
-	if (move.start == A1) info &= ~WQ_MASK;
-	if (move.start == H1) info &= ~WK_MASK;
-	if (move.end   == A8) info &= ~BQ_MASK;
-	if (move.end   == H8) info &= ~BK_MASK;
+#ifdef ABSOLUTE_COLORS
+	// clear en passant square and pass the move to the other side
+	info &= ~EP_MASK;
+	info ^= STM_MASK;
 
+	if (double_push)
+		info |= 1 << (move.start & 7);
+
+	occ = occupied(pos);
+#else
 	// clear en passant square and swap white and black castling rights
 	info &= ~EP_MASK;
 	info  = ((info << 2) | (info >> 2)) & CA_MASK;
@@ -70,20 +86,29 @@ struct Position make_move(struct Position pos, struct Move move) {
 	pos.Z = rotate(pos.Z);
 	pos.white = rotate(pos.white);
 
-	// update new en-passant square
-	if (move.piece == Pawn && move.end - move.start == N+N)
+	if (double_push)
 		info |= 1 << (move.start & 7);
 
-	// write info bits
+	// swap white & black bitboards
 	occ = occupied(pos);
+	pos.white = occ & ~pos.white;
+#endif
+
+	// write info bits
 	info = pdep(info, ~occ);
 
 	pos.X |= info;
 	pos.Y |= info;
 	pos.Z |= info;
 
-	// swap white & black bitboards
-	pos.white = occ & ~pos.white;
-
 	return pos;
 }
+
+struct Position make_move(struct Position pos, struct Move move) {
+#ifdef ABSOLUTE_COLORS
+	if (turn(pos) == BLACK)
+		return make_move_for(pos, move, BLACK);
+#endif
+
+	return make_move_for(pos, move, WHITE);
+}
@@ -3,10 +3,14 @@
 
 #include "bits.h"
 
+#include <stdbool.h>
+
 enum PieceType {
 	None, Pawn, Knight, Bishop, Rook, Queen, King, Info
 };
 
+enum Color { WHITE, BLACK };
+
 struct Position {
 	bitboard white, X,Y,Z;
 };
@@ -18,6 +22,9 @@ enum PositionInfo {
 	BK_MASK = 0x400,
 	BQ_MASK = 0x800,
 	CA_MASK = 0xf00,
+#ifdef ABSOLUTE_COLORS
+	STM_MASK = 0x1000, // set when black is to move
+#endif
 };
 
 static inline bitboard extract(struct Position pos, enum PieceType T) {
@@ -28,8 +35,153 @@ static inline bitboard extract(struct Position pos, enum PieceType T) {
 	return bb;
 }
 
+static inline enum PieceType get_piece(struct Position pos, square sq) {
+	assert(sq < 64 && "invalid square");
+	enum PieceType T = None;
+
+	T |= ((pos.X >> sq) & 1) << 0;
+	T |= ((pos.Y >> sq) & 1) << 1;
+	T |= ((pos.Z >> sq) & 1) << 2;
+
+	return T;
+}
+
 static inline bitboard occupied(struct Position pos) {
 	return (pos.X ^ pos.Y) | (pos.X ^ pos.Z);
 }
 
+static inline bool same_position(struct Position a, struct Position b) {
+	return ((a.white ^ b.white) | (a.X ^ b.X) | (a.Y ^ b.Y) | (a.Z ^ b.Z)) == 0;
+}
+
+// orders positions as 256-bit keys, by the white bitboard then X, Y and Z
+static inline int compare_positions(struct Position a, struct Position b) {
+	if (a.white != b.white) return (a.white > b.white) - (a.white < b.white);
+	if (a.X != b.X) return (a.X > b.X) - (a.X < b.X);
+	if (a.Y != b.Y) return (a.Y > b.Y) - (a.Y < b.Y);
+	return (a.Z > b.Z) - (a.Z < b.Z);
+}
+
+// 64-bit hash of the full 256-bit position, including the info bits
+static inline uint64_t hash_position(struct Position pos) {
+	uint64_t h = 0;
+	bitboard words[4] = { pos.white, pos.X, pos.Y, pos.Z };
+
+	for (int i = 0; i < 4; i++) {
+		h = (h ^ words[i]) * 0xbf58476d1ce4e5b9;
+		h ^= h >> 31;
+	}
+
+	return (h ^ (h >> 29)) * 0x94d049bb133111eb;
+}
+
+static inline bitboard extract_info(struct Position pos) {
+	return pext(extract(pos, Info), ~occupied(pos));
+}
+
+// the pieces of the white bitboard from pawns to kings, then those of the
+// other side
+static inline void piece_planes(struct Position pos, bitboard planes[12]) {
+	bitboard x = pos.X, y = pos.Y, z = pos.Z;
+
+	bitboard pieces[6] = {
+		x & ~y & ~z, ~x & y & ~z, x & y & ~z,
+		~x & ~y & z, x & ~y & z, ~x & y & z,
+	};
+
+	for (int i = 0; i < 6; i++) {
+		planes[i] = pieces[i] & pos.white;
+		planes[6 + i] = pieces[i] & ~pos.white;
+	}
+}
+
+static const bitboard LIGHT_SQUARES = 0x55aa55aa55aa55aa;
+
+// neither side can checkmate: bare kings, a single minor piece, or only
+// bishops all on the same square color
+static inline bool insufficient_material(struct Position pos) {
+	bitboard occ = occupied(pos);
+	bitboard kings = extract(pos, King);
+	bitboard knights = extract(pos, Knight);
+	bitboard bishops = extract(pos, Bishop);
+
+	bitboard minors = knights | bishops;
+	bitboard others = occ & ~kings & ~minors;
+
+	if (others)
+		return false;
+
+	if ((minors & (minors - 1)) == 0)
+		return true;
+
+	return !knights && (!(bishops & LIGHT_SQUARES) || !(bishops & ~LIGHT_SQUARES));
+}
+
+// By default the board is rotated so that the side to move is always WHITE.
+// With ABSOLUTE_COLORS defined the board keeps absolute colors, and the side
+// to move is stored in the info bits instead.
+//
+// The helpers below are written in terms of a color, which is always the
+// constant WHITE in the rotated representation, so they fold away to the
+// plain white-relative operations.
+
+static inline enum Color turn(struct Position pos) {
+#ifdef ABSOLUTE_COLORS
+	return (extract_info(pos) & STM_MASK) ? BLACK : WHITE;
+#else
+	(void)pos;
+	return WHITE;
+#endif
+}
+
+static inline bitboard side(struct Position pos, enum Color c) {
+	return (c == WHITE) ? pos.white : occupied(pos) & ~pos.white;
+}
+
+static inline bitboard relative(enum Color c, bitboard bb) {
+	return (c == WHITE) ? bb : rotate(bb);
+}
+
+static inline square relative_square(enum Color c, square sq) {
+	return (c == WHITE) ? sq : sq ^ 56;
+}
+
+static inline bitboard forward(enum Color c, bitboard bb) {
+	return (c == WHITE) ? shift(N, bb) : shift(S, bb);
+}
+
+static inline bitboard backward(enum Color c, bitboard bb) {
+	return (c == WHITE) ? shift(S, bb) : shift(N, bb);
+}
+
+static inline bitboard pawn_attacks(enum Color c, bitboard bb) {
+	return forward(c, shift(E, bb) | shift(W, bb));
+}
+
+// castling rights belonging to color `c`
+static inline bitboard kingside(enum Color c) {
+	return (c == WHITE) ? WK_MASK : BK_MASK;
+}
+
+static inline bitboard queenside(enum Color c) {
+	return (c == WHITE) ? WQ_MASK : BQ_MASK;
+}
+
+// material of the side to move and of the other side, 4 bits per piece type
+// from pawns to queens, in bits 0-19 and 20-39
+static inline uint64_t material_key(struct Position pos) {
+	enum Color c = turn(pos);
+	bitboard us = side(pos, c), them = side(pos, !c);
+	uint64_t key = 0;
+
+	for (enum PieceType T = Pawn; T <= Queen; T++) {
+		bitboard pieces = extract(pos, T);
+
+		key |= (uint64_t)popcount(pieces & us) << (4 * (T - Pawn));
+		key |= (uint64_t)popcount(pieces & them) << (4 * (T - Pawn) + 20);
+	}
+
+	return key;
+}
+
 #endif /*POSITION_H_*/
@@ -0,0 +1,296 @@
+#include "retro.h"
+
+#include "bits.h"
+#include "movegen.h"
+#include "position.h"
+
+#include <stdbool.h>
+
+enum { A1 = 0, E1 = 4, H1 = 7, A8 = 56, H8 = 63 };
+
+// Predecessors are built in the orientation of the current position, where
+// `c` is to move and `!c` has just moved, then handed back to `!c`.
+
+static inline
+void clear_square(struct Position *board, square sq) {
+	bitboard keep = ~(1ULL << sq);
+
+	board->white &= keep;
+	board->X &= keep;
+	board->Y &= keep;
+	board->Z &= keep;
+}
+
+static inline
+void put_piece(struct Position *board, square sq, enum PieceType T, enum Color c) {
+	clear_square(board, sq);
+
+	board->X |= (bitboard)((T >> 0) & 1) << sq;
+	board->Y |= (bitboard)((T >> 1) & 1) << sq;
+	board->Z |= (bitboard)((T >> 2) & 1) << sq;
+
+	if (c == WHITE) board->white |= 1ULL << sq;
+}
+
+static inline
+bool has_piece(struct Position board, square sq, enum PieceType T, enum Color c) {
+	return get_piece(board, sq) == T && ((side(board, c) >> sq) & 1);
+}
+
+// squares of the predecessor, which is rotated back unless colors are absolute
+static inline
+square predecessor_square(square sq) {
+#ifdef ABSOLUTE_COLORS
+	return sq;
+#else
+	return sq ^ 56;
+#endif
+}
+
+// hands the move back to `!c`, writing the castling rights and en-passant
+// file of `info` (given in the current orientation)
+static always_inline
+struct Position predecessor(struct Position board, bitboard info, enum Color c) {
+#ifdef ABSOLUTE_COLORS
+	if (c == WHITE) info |= STM_MASK;
+#else
+	(void)c;
+
+	board.X = rotate(board.X);
+	board.Y = rotate(board.Y);
+	board.Z = rotate(board.Z);
+	board.white = occupied(board) & ~rotate(board.white);
+
+	bitboard castling = info & CA_MASK;
+	info = (info & EP_MASK) | (((castling << 2) | (castling >> 2)) & CA_MASK);
+#endif
+
+	info = pdep(info, ~occupied(board));
+
+	board.X |= info;
+	board.Y |= info;
+	board.Z |= info;
+
+	return board;
+}
+
+// whether our king is attacked by `!c`, which would make the predecessor illegal
+static always_inline
+bool king_attacked(struct Position board, enum Color c) {
+	bitboard occ = occupied(board);
+	bitboard them = side(board, !c);
+
+	bitboard king = extract(board, King) & side(board, c);
+	square ksq = lsb(king);
+
+	bitboard bishops = (extract(board, Bishop) | extract(board, Queen)) & them;
+	bitboard rooks   = (extract(board, Rook)   | extract(board, Queen)) & them;
+
+	return (pawn_attacks(c, king) & extract(board, Pawn) & them)
+	     | (knight_attacks(ksq) & extract(board, Knight) & them)
+	     | (bishop_attacks(ksq, occ) & bishops)
+	     | (rook_attacks(ksq, occ) & rooks)
+	     | (king_attacks(ksq) & extract(board, King) & them);
+}
+
+static always_inline
+void append_unmove(struct UnmoveList *list, struct Position board, square from, square to,
+                   enum PieceType piece, bitboard info, enum Color c) {
+	if (king_attacked(board, c))
+		return;
+
+	enum Color them = !c;
+
+	// rights that make_move would remove, which the current position can't
+	// have but the predecessor may have
+	bitboard lost = 0;
+
+	if (piece == King)                          lost |= kingside(them) | queenside(them);
+	if (from == relative_square(them, A1))      lost |= queenside(them);
+	if (from == relative_square(them, H1))      lost |= kingside(them);
+	if (to   == relative_square(them, A8))      lost |= queenside(c);
+	if (to   == relative_square(them, H8))      lost |= kingside(c);
+
+	if (lost & info & CA_MASK)
+		return;
+
+	// only rights whose king and rook are still in place
+	bitboard optional = 0;
+
+	for (enum Color owner = WHITE; owner <= BLACK; owner++) {
+		if (!has_piece(board, relative_square(owner, E1), King, owner))
+			continue;
+
+		if (has_piece(board, relative_square(owner, H1), Rook, owner))
+			optional |= kingside(owner);
+
+		if (has_piece(board, relative_square(owner, A1), Rook, owner))
+			optional |= queenside(owner);
+	}
+
+	optional &= lost;
+
+	struct Move move = { predecessor_square(from), predecessor_square(to), piece, false };
+
+	// every subset of the optional rights
+	bitboard rights = 0;
+
+	do {
+		// the bound is far above any position seen, but the list must not overflow
+		if (list->length >= MAX_UNMOVELIST_LENGTH) {
+			list->truncated = true;
+			return;
+		}
+
+		list->unmoves[list->length++] = (struct Unmove){ predecessor(board, info | rights, c), move };
+
+		rights = (rights - optional) & optional;
+	} while (rights);
+}
+
+enum UnmoveKind { QUIET = 1, CAPTURE = 2 };
+
+// the moved piece goes back to `from`, leaving `to` empty for a quiet move or
+// putting back each piece type it could have captured
+static always_inline
+void append_unmoves(struct UnmoveList *list, struct Position board, square from, square to,
+                    enum PieceType moved, enum PieceType piece, bitboard info, enum Color c, int kinds) {
+	bitboard bit = 1ULL << to;
+	bitboard us = side(board, c);
+
+	put_piece(&board, from, moved, !c);
+	clear_square(&board, to);
+
+	if (kinds & QUIET)
+		append_unmove(list, board, from, to, piece, info, c);
+
+	// at most 16 pieces, of which at most 8 pawns
+	if (!(kinds & CAPTURE) || popcount(us) >= 16)
+		return;
+
+	for (enum PieceType captured = Pawn; captured <= Queen; captured++) {
+		if (captured == Pawn && ((bit & (RANK1 | RANK8)) || popcount(extract(board, Pawn) & us) >= 8))
+			continue;
+
+		struct Position uncaptured = board;
+		put_piece(&uncaptured, to, captured, c);
+
+		append_unmove(list, uncaptured, from, to, piece, info, c);
+	}
+}
+
+static always_inline
+bool generate_unmoves_for(struct Position pos, enum Color c, struct UnmoveList *list) {
+	// only the header, zeroing the whole list would dominate small positions
+	list->length = 0;
+	list->truncated = false;
+	enum Color them = !c;
+
+	bitboard occ = occupied(pos);
+	bitboard info = extract_info(pos);
+
+	// pieces only, the info bits are rewritten for each predecessor
+	struct Position board = { pos.white & occ, pos.X & occ, pos.Y & occ, pos.Z & occ };
+	bitboard castling = info & CA_MASK;
+
+	// after a double push the only predecessor is before it
+	if (info & EP_MASK) {
+		square file = lsb(info & EP_MASK);
+		square to = relative_square(them, 24 + file);
+		square from = relative_square(them, 8 + file);
+		bitboard path = (1ULL << relative_square(them, 16 + file)) | (1ULL << from);
+
+		if (has_piece(board, to, Pawn, them) && !(path & occ)) {
+			struct Position before = board;
+			put_piece(&before, from, Pawn, them);
+			clear_square(&before, to);
+
+			append_unmove(list, before, from, to, Pawn, castling, c);
+		}
+
+		return !list->truncated;
+	}
+
+	bitboard pieces = side(pos, them);
+	bitboard promotion_rank = relative(them, RANK8);
+	bitboard pawn_ranks = ~(RANK1 | RANK8);
+
+	while (pieces) {
+		square to = lsb(pieces);
+		bitboard bit = 1ULL << to;
+		enum PieceType T = get_piece(pos, to);
+
+		if (T == Pawn) {
+			// pushes, but not double pushes, which would have left an en-passant file
+			bitboard push = backward(them, bit) & ~occ & pawn_ranks;
+
+			if (push)
+				append_unmoves(list, board, lsb(push), to, Pawn, Pawn, castling, c, QUIET);
+
+			bitboard captures = pawn_attacks(c, bit) & ~occ & pawn_ranks;
+
+			while (captures) {
+				append_unmoves(list, board, lsb(captures), to, Pawn, Pawn, castling, c, CAPTURE);
+				captures &= captures - 1;
+			}
+
+			// en passant, where our pawn had just passed `to` with a double push
+			bitboard passed = forward(c, bit);
+
+			if ((bit & relative(c, RANK3)) && !((passed | backward(c, bit)) & occ)
+			                               && popcount(extract(pos, Pawn) & side(pos, c)) < 8) {
+				bitboard sources = pawn_attacks(c, bit) & ~occ;
+
+				while (sources) {
+					square from = lsb(sources);
+
+					struct Position before = board;
+					put_piece(&before, from, Pawn, them);
+					put_piece(&before, lsb(passed), Pawn, c);
+					clear_square(&before, to);
+
+					append_unmove(list, before, from, to, Pawn, castling | 1 << (to & 7), c);
+					sources &= sources - 1;
+				}
+			}
+
+			pieces &= pieces - 1;
+			continue;
+		}
+
+		// promotions, with and without a capture, by one of at most 8 pawns
+		if (T != King && (bit & promotion_rank) && popcount(extract(pos, Pawn) & side(pos, them)) < 8) {
+			bitboard push = backward(them, bit) & ~occ;
+
+			if (push)
+				append_unmoves(list, board, lsb(push), to, Pawn, T, castling, c, QUIET);
+
+			bitboard captures = pawn_attacks(c, bit) & ~occ;
+
+			while (captures) {
+				append_unmoves(list, board, lsb(captures), to, Pawn, T, castling, c, CAPTURE);
+				captures &= captures - 1;
+			}
+		}
+
+		bitboard sources = generic_attacks(T, to, occ) & ~occ;
+
+		while (sources) {
+			append_unmoves(list, board, lsb(sources), to, T, T, castling, c, QUIET | CAPTURE);
+			sources &= sources - 1;
+		}
+
+		pieces &= pieces - 1;
+	}
+
+	return !list->truncated;
+}
+
+bool generate_unmoves(struct Position pos, struct UnmoveList *list) {
+#ifdef ABSOLUTE_COLORS
+	if (turn(pos) == BLACK)
+		return generate_unmoves_for(pos, BLACK, list);
+#endif
+
+	return generate_unmoves_for(pos, WHITE, list);
+}
@@ -0,0 +1,36 @@
+#ifndef RETRO_H_
+#define RETRO_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "movegen.h"
+#include "position.h"
+
+#define MAX_UNMOVELIST_LENGTH 4096
+
+// a predecessor position, and the move from it that leads to the current one
+struct Unmove {
+	struct Position pos;
+	struct Move move;
+};
+
+struct UnmoveList {
+	struct Unmove unmoves[MAX_UNMOVELIST_LENGTH];
+	size_t length;
+	bool truncated; // more predecessors than fit were found
+};
+
+// Legal predecessors of a position, such that make_move(unmove.pos,
+// unmove.move) gives back the position exactly: un-captures of every piece
+// type, un-promotions and un-captures en passant. Castling is never undone.
+//
+// Predecessors only have an en-passant square when the unmove is a capture en
+// passant, and carry any castling rights that the move could have removed.
+//
+// The list is filled by the caller's pointer, as it is too large to return by
+// value. Returns false when more than MAX_UNMOVELIST_LENGTH predecessors were
+// found, and the list holds only the first of them.
+bool generate_unmoves(struct Position pos, struct UnmoveList *list);
+
+#endif /*RETRO_H_*/
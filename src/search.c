@@ -0,0 +1,734 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "search.h"
+
+#include "bits.h"
+#include "movegen.h"
+#include "position.h"
+#include "text.h"
+#include "timer.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// evaluation: material and piece-square tables (simplified evaluation
+// function), tables are written from rank 8 down to rank 1
+
+static const int piece_value[8] = { 0, 100, 320, 330, 500, 900, 0, 0 };
+
+static const int8_t piece_square[8][64] = {
+	[Pawn] = {
+		  0,  0,  0,  0,  0,  0,  0,  0,
+		 50, 50, 50, 50, 50, 50, 50, 50,
+		 10, 10, 20, 30, 30, 20, 10, 10,
+		  5,  5, 10, 25, 25, 10,  5,  5,
+		  0,  0,  0, 20, 20,  0,  0,  0,
+		  5, -5,-10,  0,  0,-10, -5,  5,
+		  5, 10, 10,-20,-20, 10, 10,  5,
+		  0,  0,  0,  0,  0,  0,  0,  0,
+	},
+	[Knight] = {
+		-50,-40,-30,-30,-30,-30,-40,-50,
+		-40,-20,  0,  0,  0,  0,-20,-40,
+		-30,  0, 10, 15, 15, 10,  0,-30,
+		-30,  5, 15, 20, 20, 15,  5,-30,
+		-30,  0, 15, 20, 20, 15,  0,-30,
+		-30,  5, 10, 15, 15, 10,  5,-30,
+		-40,-20,  0,  5,  5,  0,-20,-40,
+		-50,-40,-30,-30,-30,-30,-40,-50,
+	},
+	[Bishop] = {
+		-20,-10,-10,-10,-10,-10,-10,-20,
+		-10,  0,  0,  0,  0,  0,  0,-10,
+		-10,  0,  5, 10, 10,  5,  0,-10,
+		-10,  5,  5, 10, 10,  5,  5,-10,
+		-10,  0, 10, 10, 10, 10,  0,-10,
+		-10, 10, 10, 10, 10, 10, 10,-10,
+		-10,  5,  0,  0,  0,  0,  5,-10,
+		-20,-10,-10,-10,-10,-10,-10,-20,
+	},
+	[Rook] = {
+		  0,  0,  0,  0,  0,  0,  0,  0,
+		  5, 10, 10, 10, 10, 10, 10,  5,
+		 -5,  0,  0,  0,  0,  0,  0, -5,
+		 -5,  0,  0,  0,  0,  0,  0, -5,
+		 -5,  0,  0,  0,  0,  0,  0, -5,
+		 -5,  0,  0,  0,  0,  0,  0, -5,
+		 -5,  0,  0,  0,  0,  0,  0, -5,
+		  0,  0,  0,  5,  5,  0,  0,  0,
+	},
+	[Queen] = {
+		-20,-10,-10, -5, -5,-10,-10,-20,
+		-10,  0,  0,  0,  0,  0,  0,-10,
+		-10,  0,  5,  5,  5,  5,  0,-10,
+		 -5,  0,  5,  5,  5,  5,  0, -5,
+		  0,  0,  5,  5,  5,  5,  0, -5,
+		-10,  5,  5,  5,  5,  5,  0,-10,
+		-10,  0,  5,  0,  0,  0,  0,-10,
+		-20,-10,-10, -5, -5,-10,-10,-20,
+	},
+	[King] = {
+		-30,-40,-40,-50,-50,-40,-40,-30,
+		-30,-40,-40,-50,-50,-40,-40,-30,
+		-30,-40,-40,-50,-50,-40,-40,-30,
+		-30,-40,-40,-50,-50,-40,-40,-30,
+		-20,-30,-30,-40,-40,-30,-30,-20,
+		-10,-20,-20,-20,-20,-20,-20,-10,
+		 20, 20,  0,  0,  0,  0, 20, 20,
+		 20, 30, 10,  0,  0, 10, 30, 20,
+	},
+};
+
+static inline
+int evaluate_side(struct Position pos, enum Color c) {
+	bitboard us = side(pos, c);
+	int score = 0;
+
+	for (enum PieceType T = Pawn; T <= King; T++) {
+		bitboard pieces = extract(pos, T) & us;
+		score += piece_value[T] * popcount(pieces);
+
+		while (pieces) {
+			score += piece_square[T][relative_square(c, lsb(pieces)) ^ 56];
+			pieces &= pieces - 1;
+		}
+	}
+
+	return score;
+}
+
+// static evaluation relative to the side to move
+int evaluate(struct Position pos) {
+	enum Color c = turn(pos);
+	return evaluate_side(pos, c) - evaluate_side(pos, !c);
+}
+
+
+// transposition table
+
+enum Bound { BOUND_NONE, BOUND_UPPER, BOUND_LOWER, BOUND_EXACT };
+
+struct TTData {
+	struct Move move;
+	int score;
+	int depth;
+	enum Bound bound;
+};
+
+static inline
+uint16_t move_bits(struct Move move) {
+	uint16_t bits;
+	memcpy(&bits, &move, sizeof bits);
+	return bits;
+}
+
+static inline
+struct Move bits_move(uint16_t bits) {
+	struct Move move;
+	memcpy(&move, &bits, sizeof move);
+	return move;
+}
+
+static inline
+bool same_move(struct Move a, struct Move b) {
+	return move_bits(a) == move_bits(b);
+}
+
+static inline
+uint64_t pack_entry(struct TTData data, uint8_t generation) {
+	return (uint64_t)move_bits(data.move)
+	     | (uint64_t)(uint16_t)(int16_t)data.score << 16
+	     | (uint64_t)(uint8_t)data.depth << 32
+	     | (uint64_t)data.bound << 40
+	     | (uint64_t)generation << 48;
+}
+
+static inline
+bool probe_tt(struct TranspositionTable *tt, uint64_t key, struct TTData *data) {
+	struct TTEntry *entry = &tt->entries[key & tt->mask];
+	uint64_t packed = entry->data;
+
+	if ((entry->key ^ packed) != key)
+		return false;
+
+	data->move  = bits_move(packed & 0xffff);
+	data->score = (int16_t)(packed >> 16);
+	data->depth = (uint8_t)(packed >> 32);
+	data->bound = (packed >> 40) & 3;
+	return true;
+}
+
+static inline
+void store_tt(struct TranspositionTable *tt, uint64_t key, struct TTData data) {
+	struct TTEntry *entry = &tt->entries[key & tt->mask];
+	uint64_t old = entry->data;
+
+	bool same = (entry->key ^ old) == key;
+	uint8_t old_depth = old >> 32;
+	uint8_t old_generation = old >> 48;
+
+	// prefer deeper entries of the current search
+	if (!same && old_generation == tt->generation && old_depth > data.depth + 2)
+		return;
+
+	// keep the previous best move for upper bounds
+	if (same && data.bound == BOUND_UPPER && move_bits(data.move) == 0)
+		data.move = bits_move(old & 0xffff);
+
+	uint64_t packed = pack_entry(data, tt->generation);
+	entry->key = key ^ packed;
+	entry->data = packed;
+}
+
+// mate scores are stored relative to the node, not the root
+static inline
+int score_to_tt(int score, int ply) {
+	if (score >= MATE_BOUND)  return score + ply;
+	if (score <= -MATE_BOUND) return score - ply;
+	return score;
+}
+
+static inline
+int score_from_tt(int score, int ply) {
+	if (score >= MATE_BOUND)  return score - ply;
+	if (score <= -MATE_BOUND) return score + ply;
+	return score;
+}
+
+bool resize_hash(struct Engine *engine, size_t hash_mb) {
+	size_t count = 1;
+
+	while (2 * count * sizeof(struct TTEntry) <= (hash_mb << 20)) {
+		count *= 2;
+	}
+
+	struct TTEntry *entries = calloc(count, sizeof *entries);
+	if (entries == NULL) return false;
+
+	free(engine->tt.entries);
+	engine->tt.entries = entries;
+	engine->tt.mask = count - 1;
+	return true;
+}
+
+bool init_engine(struct Engine *engine, size_t hash_mb, unsigned threads) {
+	memset(engine, 0, sizeof *engine);
+	engine->threads = threads;
+	return resize_hash(engine, hash_mb);
+}
+
+void clear_engine(struct Engine *engine) {
+	memset(engine->tt.entries, 0, (engine->tt.mask + 1) * sizeof *engine->tt.entries);
+	engine->tt.generation = 0;
+	engine->history_length = 0;
+}
+
+void free_engine(struct Engine *engine) {
+	free(engine->tt.entries);
+	engine->tt.entries = NULL;
+}
+
+void push_history(struct Engine *engine, struct Position pos, bool irreversible) {
+	// earlier positions can't repeat after an irreversible move
+	if (irreversible || engine->history_length == MAX_HISTORY) {
+		engine->history_length = 0;
+		return;
+	}
+
+	engine->history[engine->history_length++] = hash_position(pos);
+}
+
+
+// search
+
+struct Thread {
+	struct Engine *engine;
+	struct SearchLimits limits;
+	struct State root;
+	unsigned id;
+
+	double start;
+	FILE *info;
+
+	uint64_t nodes;
+	struct Move killers[MAX_PLY][2];
+	int history[64][64];
+
+	// hashes of the game history followed by the current search path
+	uint64_t path[MAX_HISTORY + MAX_PLY + 1];
+	size_t base;
+
+	// result of the last completed iteration
+	struct Move best;
+	int score;
+	unsigned depth;
+};
+
+static inline
+uint64_t total_nodes(struct Engine *engine) {
+	uint64_t nodes = 0;
+
+	for (unsigned i = 0; i < engine->threads; i++) {
+		nodes += __atomic_load_n(&engine->workers[i].nodes, __ATOMIC_RELAXED);
+	}
+
+	return nodes;
+}
+
+// only the owning thread writes its node count, the others just read it
+static inline
+void count_node(struct Thread *t) {
+	__atomic_store_n(&t->nodes, t->nodes + 1, __ATOMIC_RELAXED);
+}
+
+static inline
+bool stopped(struct Engine *engine) {
+	return __atomic_load_n(&engine->stop, __ATOMIC_RELAXED);
+}
+
+void request_stop(struct Engine *engine) {
+	__atomic_store_n(&engine->stop, true, __ATOMIC_RELAXED);
+}
+
+// only the main thread checks limits, other threads follow the stop flag
+static inline
+bool should_stop(struct Thread *t) {
+	if (stopped(t->engine))
+		return true;
+
+	if (t->id != 0 || (t->nodes & 1023) != 0)
+		return false;
+
+	if (t->limits.time && wall_time() - t->start >= t->limits.time)
+		request_stop(t->engine);
+
+	if (t->limits.nodes && total_nodes(t->engine) >= t->limits.nodes)
+		request_stop(t->engine);
+
+	return stopped(t->engine);
+}
+
+static inline
+bool is_capture(struct Position pos, struct Move move) {
+	bitboard them = occupied(pos) & ~side(pos, turn(pos));
+
+	// en-passant captures are diagonal pawn moves to an empty square
+	return ((them >> move.end) & 1)
+	    || (move.piece == Pawn && (move.start & 7) != (move.end & 7));
+}
+
+static inline
+bool is_promotion(struct Position pos, struct Move move) {
+	return move.piece != Pawn && get_piece(pos, move.start) == Pawn;
+}
+
+static
+void score_moves(struct Thread *t, struct Position pos, struct MoveList *list, struct Move tt_move, int ply, int *scores) {
+	for (size_t i = 0; i < list->length; i++) {
+		struct Move move = list->moves[i];
+
+		if (same_move(move, tt_move)) {
+			scores[i] = 1 << 30;
+		}
+
+		else if (is_capture(pos, move) || is_promotion(pos, move)) {
+			enum PieceType victim = get_piece(pos, move.end);
+			enum PieceType attacker = get_piece(pos, move.start);
+
+			if (victim == Info) victim = None;
+			// most valuable victim, least valuable attacker
+			scores[i] = (1 << 28) + 16 * piece_value[victim] - piece_value[attacker];
+
+			if (is_promotion(pos, move))
+				scores[i] += piece_value[move.piece];
+		}
+
+		else if (same_move(move, t->killers[ply][0])) {
+			scores[i] = (1 << 27) + 1;
+		}
+
+		else if (same_move(move, t->killers[ply][1])) {
+			scores[i] = (1 << 27);
+		}
+
+		else {
+			scores[i] = t->history[move.start][move.end];
+		}
+	}
+}
+
+// selection sort step, moving the best remaining move to index i
+static inline
+struct Move pick_move(struct MoveList *list, int *scores, size_t i) {
+	size_t best = i;
+
+	for (size_t j = i + 1; j < list->length; j++) {
+		if (scores[j] > scores[best]) best = j;
+	}
+
+	struct Move move = list->moves[best];
+	int score = scores[best];
+
+	list->moves[best] = list->moves[i], scores[best] = scores[i];
+	list->moves[i] = move, scores[i] = score;
+
+	return move;
+}
+
+static inline
+bool is_repetition(struct Thread *t, int ply, unsigned fifty) {
+	size_t index = t->base + ply;
+	uint64_t hash = t->path[index];
+
+	for (size_t back = 2; back <= fifty && back <= index; back += 2) {
+		if (t->path[index - back] == hash) return true;
+	}
+
+	return false;
+}
+
+static
+int quiescence(struct Thread *t, struct Position pos, int alpha, int beta, int ply) {
+	count_node(t);
+
+	if (should_stop(t))
+		return 0;
+
+	bool in_check = enemy_checks(pos) != 0;
+	int best = -INF_SCORE;
+
+	if (!in_check) {
+		best = evaluate(pos);
+
+		if (best >= beta || ply >= MAX_PLY - 1)
+			return best;
+
+		if (best > alpha)
+			alpha = best;
+	}
+
+	struct MoveList list = generate_moves(pos);
+
+	if (list.length == 0)
+		return in_check ? -MATE_SCORE + ply : 0;
+
+	if (ply >= MAX_PLY - 1)
+		return evaluate(pos);
+
+	int scores[MAX_MOVELIST_LENGTH];
+	score_moves(t, pos, &list, (struct Move){0}, ply, scores);
+
+	for (size_t i = 0; i < list.length; i++) {
+		struct Move move = pick_move(&list, scores, i);
+
+		// only captures and queen promotions, unless evading check
+		bool tactical = is_capture(pos, move) || (is_promotion(pos, move) && move.piece == Queen);
+
+		if (!in_check && !tactical)
+			continue;
+
+		int score = -quiescence(t, make_move(pos, move), -beta, -alpha, ply + 1);
+
+		if (score > best) {
+			best = score;
+
+			if (score > alpha) {
+				alpha = score;
+				if (score >= beta) break;
+			}
+		}
+	}
+
+	return best;
+}
+
+static
+int negamax(struct Thread *t, struct Position pos, int alpha, int beta, int depth, int ply, unsigned fifty) {
+	bool root = ply == 0;
+	bool pv = beta - alpha > 1;
+
+	if (!root && (fifty >= 100 || is_repetition(t, ply, fifty)))
+		return 0;
+
+	if (depth <= 0 || ply >= MAX_PLY - 1)
+		return quiescence(t, pos, alpha, beta, ply);
+
+	count_node(t);
+
+	if (should_stop(t))
+		return 0;
+
+	uint64_t key = t->path[t->base + ply];
+	struct TTData entry = { .bound = BOUND_NONE };
+	struct TranspositionTable *tt = &t->engine->tt;
+
+	if (probe_tt(tt, key, &entry) && !pv && entry.depth >= depth) {
+		int score = score_from_tt(entry.score, ply);
+
+		if (entry.bound == BOUND_EXACT
+		|| (entry.bound == BOUND_LOWER && score >= beta)
+		|| (entry.bound == BOUND_UPPER && score <= alpha))
+			return score;
+	}
+
+	struct MoveList list = generate_moves(pos);
+	bool in_check = enemy_checks(pos) != 0;
+
+	if (list.length == 0)
+		return in_check ? -MATE_SCORE + ply : 0;
+
+	if (in_check)
+		depth++;
+
+	int scores[MAX_MOVELIST_LENGTH];
+	score_moves(t, pos, &list, entry.move, ply, scores);
+
+	int original_alpha = alpha;
+	int best = -INF_SCORE;
+	struct Move best_move = list.moves[0];
+
+	for (size_t i = 0; i < list.length; i++) {
+		struct Move move = pick_move(&list, scores, i);
+		struct Position child = make_move(pos, move);
+
+		bool quiet = !is_capture(pos, move) && !is_promotion(pos, move);
+		unsigned child_fifty = (quiet && move.piece != Pawn) ? fifty + 1 : 0;
+
+		t->path[t->base + ply + 1] = hash_position(child);
+
+		int score;
+
+		if (i == 0) {
+			score = -negamax(t, child, -beta, -alpha, depth - 1, ply + 1, child_fifty);
+		}
+
+		else {
+			// late move reductions for quiet moves
+			int reduction = (depth >= 3 && i >= 4 && quiet && !in_check) ? 1 + (i >= 12) : 0;
+
+			score = -negamax(t, child, -alpha - 1, -alpha, depth - 1 - reduction, ply + 1, child_fifty);
+
+			if (score > alpha && reduction)
+				score = -negamax(t, child, -alpha - 1, -alpha, depth - 1, ply + 1, child_fifty);
+
+			if (score > alpha && score < beta)
+				score = -negamax(t, child, -beta, -alpha, depth - 1, ply + 1, child_fifty);
+		}
+
+		if (stopped(t->engine))
+			return 0;
+
+		if (score > best) {
+			best = score;
+			best_move = move;
+
+			if (root) {
+				t->best = move;
+				t->score = score;
+			}
+
+			if (score > alpha) {
+				alpha = score;
+
+				if (score >= beta) {
+					if (quiet) {
+						if (!same_move(move, t->killers[ply][0])) {
+							t->killers[ply][1] = t->killers[ply][0];
+							t->killers[ply][0] = move;
+						}
+
+						t->history[move.start][move.end] += depth * depth;
+					}
+
+					break;
+				}
+			}
+		}
+	}
+
+	enum Bound bound = (best >= beta) ? BOUND_LOWER
+	                 : (best > original_alpha) ? BOUND_EXACT : BOUND_UPPER;
+
+	struct TTData data = {
+		.move = (bound == BOUND_UPPER) ? (struct Move){0} : best_move,
+		.score = score_to_tt(best, ply),
+		.depth = depth,
+		.bound = bound,
+	};
+
+	store_tt(tt, key, data);
+	return best;
+}
+
+static
+void print_info(struct Thread *t, struct State root, unsigned depth, int score) {
+	if (t->info == NULL)
+		return;
+
+	double seconds = wall_time() - t->start;
+	uint64_t nodes = total_nodes(t->engine);
+
+	fprintf(t->info, "info depth %u", depth);
+
+	if (score >= MATE_BOUND) {
+		fprintf(t->info, " score mate %d", (MATE_SCORE - score + 1) / 2);
+	} else if (score <= -MATE_BOUND) {
+		fprintf(t->info, " score mate %d", -(MATE_SCORE + score) / 2);
+	} else {
+		fprintf(t->info, " score cp %d", score);
+	}
+
+	fprintf(t->info, " nodes %llu nps %.0f time %.0f pv",
+	        (unsigned long long)nodes, nodes / (seconds + 1e-9), 1000 * seconds);
+
+	// follow the principal variation through the transposition table
+	struct State state = root;
+	struct Move move = t->best;
+
+	for (unsigned i = 0; i < depth; i++) {
+		char buffer[8];
+		buffer[generate_uci(move, state, buffer)] = '\0';
+		fprintf(t->info, " %s", buffer);
+
+		state.pos = make_move(state.pos, move);
+		state.side_to_move = !state.side_to_move;
+
+		struct TTData entry;
+		if (!probe_tt(&t->engine->tt, hash_position(state.pos), &entry))
+			break;
+
+		// verify the move is legal in case of a hash collision
+		struct MoveList list = generate_moves(state.pos);
+		bool legal = false;
+
+		for (size_t j = 0; j < list.length; j++) {
+			legal |= same_move(list.moves[j], entry.move);
+		}
+
+		if (!legal) break;
+		move = entry.move;
+	}
+
+	fprintf(t->info, "\n");
+	fflush(t->info);
+}
+
+static
+void *iterative_deepening(void *arg) {
+	struct Thread *t = arg;
+	unsigned max_depth = t->limits.depth ? t->limits.depth : MAX_PLY - 1;
+	unsigned fifty = t->root.fify_move_clock;
+
+	for (unsigned depth = 1; depth <= max_depth; depth++) {
+		// helper threads diversify by searching ahead of the main thread
+		unsigned search_depth = depth + (t->id & 1);
+		if (t->id && search_depth > max_depth) search_depth = max_depth;
+
+		// note: the root best move only changes once a move is fully
+		// searched, so it remains valid when stopped mid-iteration
+		int score = negamax(t, t->root.pos, -INF_SCORE, INF_SCORE, search_depth, 0, fifty);
+
+		if (stopped(t->engine))
+			break;
+
+		t->depth = search_depth;
+		t->score = score;
+
+		if (t->id == 0) {
+			print_info(t, t->root, search_depth, score);
+
+			// a new iteration is unlikely to finish in the remaining time
+			if (t->limits.time && wall_time() - t->start > 0.5 * t->limits.time)
+				break;
+
+			if (score >= MATE_BOUND || score <= -MATE_BOUND) {
+				if (MATE_SCORE - abs(score) < (int)depth) break;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+struct SearchResult search(struct Engine *engine, struct State root, struct SearchLimits limits, FILE *info) {
+	unsigned count = engine->threads;
+	if (count < 1) count = 1;
+	if (count > MAX_THREADS) count = MAX_THREADS;
+
+	engine->threads = count;
+	engine->tt.generation++;
+
+	struct MoveList list = generate_moves(root.pos);
+	double start = wall_time();
+
+	struct Thread *threads = calloc(count, sizeof *threads);
+	pthread_t handles[MAX_THREADS];
+
+	// without the threads' memory fall back to any legal move
+	if (threads == NULL) {
+		if (info) fprintf(info, "info string failed to allocate search threads\n");
+		__atomic_store_n(&engine->stop, false, __ATOMIC_RELAXED);
+
+		return (struct SearchResult){
+			.best = list.length ? list.moves[0] : (struct Move){0},
+			.seconds = wall_time() - start,
+		};
+	}
+
+	engine->workers = threads;
+
+	for (unsigned i = 0; i < count; i++) {
+		struct Thread *t = &threads[i];
+
+		t->engine = engine;
+		t->limits = limits;
+		t->root = root;
+		t->id = i;
+		t->start = start;
+		t->info = (i == 0) ? info : NULL;
+		t->best = list.length ? list.moves[0] : (struct Move){0};
+
+		memcpy(t->path, engine->history, engine->history_length * sizeof *t->path);
+		t->base = engine->history_length;
+		t->path[t->base] = hash_position(root.pos);
+	}
+
+	// search with the helpers that could be started
+	unsigned started = 1;
+
+	while (started < count && pthread_create(&handles[started], NULL, iterative_deepening, &threads[started]) == 0) {
+		started++;
+	}
+
+	if (started < count && info) {
+		fprintf(info, "info string started %u of %u search threads\n", started, count);
+	}
+
+	if (list.length) {
+		iterative_deepening(&threads[0]);
+	}
+
+	request_stop(engine);
+
+	for (unsigned i = 1; i < started; i++) {
+		pthread_join(handles[i], NULL);
+	}
+
+	// cleared only now, so a stop requested before the search began still counts
+	__atomic_store_n(&engine->stop, false, __ATOMIC_RELAXED);
+
+	struct SearchResult result = {
+		.best = threads[0].best,
+		.score = threads[0].score,
+		.depth = threads[0].depth,
+		.nodes = total_nodes(engine),
+		.seconds = wall_time() - start,
+	};
+
+	free(threads);
+	engine->workers = NULL;
+
+	return result;
+}
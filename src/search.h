@@ -0,0 +1,82 @@
+#ifndef SEARCH_H_
+#define SEARCH_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "movegen.h"
+#include "position.h"
+#include "state.h"
+
+#define MAX_PLY 128
+#define MAX_THREADS 256
+#define MAX_HISTORY 1024
+
+enum {
+	INF_SCORE  = 32001,
+	MATE_SCORE = 32000,
+	MATE_BOUND = MATE_SCORE - MAX_PLY, // scores beyond this are mates
+};
+
+// lockless transposition table shared by all search threads, entries are
+// stored as (key ^ data, data) so torn writes fail the key check
+struct TTEntry {
+	uint64_t key, data;
+};
+
+struct TranspositionTable {
+	struct TTEntry *entries;
+	size_t mask;
+	uint8_t generation;
+};
+
+struct SearchLimits {
+	unsigned depth;  // 0 for no limit
+	uint64_t nodes;  // 0 for no limit
+	double time;     // seconds, 0 for no limit
+};
+
+struct SearchResult {
+	struct Move best;
+	int score;
+	unsigned depth;
+	uint64_t nodes;
+	double seconds;
+};
+
+struct Thread;
+
+struct Engine {
+	struct TranspositionTable tt;
+	unsigned threads;
+	bool stop; // accessed atomically, set through request_stop
+
+	struct Thread *workers; // during a search
+
+	// positions played before the root, for repetition detection
+	uint64_t history[MAX_HISTORY];
+	size_t history_length;
+};
+
+bool init_engine(struct Engine *engine, size_t hash_mb, unsigned threads);
+bool resize_hash(struct Engine *engine, size_t hash_mb);
+void clear_engine(struct Engine *engine);
+void free_engine(struct Engine *engine);
+
+// records a position of the game leading up to the next root, and whether the
+// move played from it was irreversible (a capture or pawn move)
+void push_history(struct Engine *engine, struct Position pos, bool irreversible);
+
+// iterative deepening alpha-beta over `engine->threads` Lazy SMP threads,
+// writing UCI info lines to `info` (may be NULL)
+struct SearchResult search(struct Engine *engine, struct State root, struct SearchLimits limits, FILE *info);
+
+// makes the running or next search return its result, safe to call from any
+// thread; the request is cleared when that search returns
+void request_stop(struct Engine *engine);
+
+int evaluate(struct Position pos);
+
+#endif /*SEARCH_H_*/
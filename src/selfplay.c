@@ -0,0 +1,300 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "selfplay.h"
+
+#include "bits.h"
+#include "history.h"
+#include "movegen.h"
+#include "movetext.h"
+#include "search.h"
+#include "text.h"
+#include "timer.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+enum {
+	HASH_MB = 16,
+	MAX_PLIES = 400,         // longer games are drawn
+	ADJUDICATE_SCORE = 1500, // held for this many plies decides the game
+	ADJUDICATE_PLIES = 8,
+	MAX_PATH = 4096,
+};
+
+// the records of all threads go through one writer
+struct Writer {
+	const struct SelfplayConfig *config;
+	pthread_mutex_t lock;
+	FILE *stream;
+
+	FILE *file;
+	uint64_t file_length;
+
+	struct SelfplayStats stats;
+	bool done, failed;
+};
+
+struct Worker {
+	struct Writer *writer;
+	struct Engine engine;
+	uint64_t seed;
+
+	struct TrainingRecord records[MAX_PLIES];
+	enum Color colors[MAX_PLIES];
+	struct History history;
+};
+
+static inline
+uint64_t next_random(uint64_t *seed) {
+	*seed ^= *seed >> 12, *seed ^= *seed << 25, *seed ^= *seed >> 27;
+	return *seed * 0x2545f4914f6cdd1d;
+}
+
+static
+bool next_file(struct Writer *w) {
+	char path[MAX_PATH];
+
+	if (w->file && fclose(w->file) != 0) {
+		fprintf(w->stream, "failed to write %s.%u.bin\n", w->config->output, w->stats.files - 1);
+		w->file = NULL;
+		return false;
+	}
+
+	snprintf(path, sizeof path, "%s.%u.bin", w->config->output, w->stats.files);
+	w->file = fopen(path, "wb");
+	w->file_length = 0;
+
+	if (!w->file) {
+		fprintf(w->stream, "failed to create %s\n", path);
+		return false;
+	}
+
+	w->stats.files++;
+	return true;
+}
+
+// writes the records of a game, returning false once enough are written
+static
+bool write_game(struct Writer *w, const struct TrainingRecord *records, size_t length, uint64_t nodes) {
+	pthread_mutex_lock(&w->lock);
+
+	if (w->done || w->failed) {
+		pthread_mutex_unlock(&w->lock);
+		return false;
+	}
+
+	uint64_t left = w->config->positions - w->stats.positions;
+	if (length > left) length = left;
+
+	for (size_t i = 0; i < length && w->config->output && !w->failed;) {
+		if (!w->file || w->file_length == w->config->file_records) {
+			w->failed = !next_file(w);
+			continue;
+		}
+
+		size_t chunk = length - i;
+		if (chunk > w->config->file_records - w->file_length) chunk = w->config->file_records - w->file_length;
+
+		w->failed = fwrite(records + i, sizeof *records, chunk, w->file) != chunk;
+		w->file_length += chunk;
+		i += chunk;
+	}
+
+	w->stats.positions += length;
+	w->stats.games++;
+	w->stats.nodes += nodes;
+	w->done = w->stats.positions == w->config->positions;
+
+	bool more = !w->done && !w->failed;
+	pthread_mutex_unlock(&w->lock);
+	return more;
+}
+
+static inline
+bool is_capture(struct Position pos, struct Move move) {
+	bitboard them = occupied(pos) & ~side(pos, turn(pos));
+
+	// en-passant captures are diagonal pawn moves to an empty square
+	return ((them >> move.end) & 1) || (get_piece(pos, move.start) == Pawn && (move.start & 7) != (move.end & 7));
+}
+
+static
+struct State opening(struct Worker *wk) {
+	const struct SelfplayConfig *config = wk->writer->config;
+
+	for (;;) {
+		struct State state;
+
+		if (config->opening_count) {
+			state = config->openings[next_random(&wk->seed) % config->opening_count];
+		}
+
+		else {
+			bool ok;
+			state = parse_fen(STARTPOS, &ok, wk->writer->stream);
+		}
+
+		unsigned ply = 0;
+
+		for (; ply < config->random_plies; ply++) {
+			struct MoveList list = generate_moves(state.pos);
+			if (list.length == 0) break;
+
+			state = play_move(state, list.moves[next_random(&wk->seed) % list.length]);
+		}
+
+		// the random moves may end the game, then try again
+		if (ply == config->random_plies && generate_moves(state.pos).length)
+			return state;
+	}
+}
+
+// plays one game, returning the number of records and the nodes searched
+static
+size_t play_game(struct Worker *wk, uint64_t *nodes) {
+	const struct SelfplayConfig *config = wk->writer->config;
+	struct SearchLimits limits = { .nodes = config->nodes };
+
+	struct State state = opening(wk);
+	unsigned start_ply = 2 * (state.movenumber - 1) + (state.side_to_move == BLACK);
+	unsigned adjudicated = 0;
+	int previous_score = 0;
+	size_t length = 0;
+	int white_result = 0;
+
+	init_history(&wk->history, state);
+	clear_engine(&wk->engine);
+	*nodes = 0;
+
+	for (unsigned ply = 0; ply < MAX_PLIES; ply++) {
+		state = current_state(&wk->history);
+
+		struct MoveList list = generate_moves(state.pos);
+		bool in_check = enemy_checks(state.pos) != 0;
+
+		if (list.length == 0) {
+			white_result = !in_check ? 0 : (state.side_to_move == WHITE) ? -1 : 1;
+			break;
+		}
+
+		if (is_fifty_move_draw(&wk->history) || is_repetition_draw(&wk->history) || insufficient_material(state.pos))
+			break;
+
+		struct SearchResult result = search(&wk->engine, state, limits, NULL);
+		*nodes += result.nodes;
+
+		// both sides agree on the winner for long enough: scores are for the
+		// side to move, so the same winner flips the sign every ply
+		bool decisive = abs(result.score) >= ADJUDICATE_SCORE;
+		bool agreed = adjudicated && (result.score > 0) != (previous_score > 0);
+
+		adjudicated = !decisive ? 0 : agreed ? adjudicated + 1 : 1;
+		previous_score = result.score;
+
+		if (adjudicated == ADJUDICATE_PLIES) {
+			bool winning = result.score > 0;
+			white_result = (winning == (state.side_to_move == WHITE)) ? 1 : -1;
+			break;
+		}
+
+		bool capture = is_capture(state.pos, result.best);
+		bool pawn = get_piece(state.pos, result.best.start) == Pawn;
+		bool promotion = pawn && result.best.piece != Pawn;
+
+		if (!in_check && !capture && !promotion && abs(result.score) < MATE_BOUND) {
+			wk->records[length] = (struct TrainingRecord){
+				.pos = state.pos,
+				.score = result.score,
+				.ply = start_ply + ply,
+			};
+
+			wk->colors[length++] = state.side_to_move;
+		}
+
+		push_history(&wk->engine, state.pos, capture || pawn);
+		history_make_move(&wk->history, result.best);
+	}
+
+	for (size_t i = 0; i < length; i++)
+		wk->records[i].result = (wk->colors[i] == WHITE) ? white_result : -white_result;
+
+	return length;
+}
+
+static
+void *run_worker(void *arg) {
+	struct Worker *wk = arg;
+	uint64_t nodes;
+
+	for (;;) {
+		size_t length = play_game(wk, &nodes);
+
+		if (!write_game(wk->writer, wk->records, length, nodes))
+			break;
+	}
+
+	return NULL;
+}
+
+bool generate_selfplay(const struct SelfplayConfig *config, struct SelfplayStats *stats, FILE *stream) {
+	unsigned threads = (config->threads < 1) ? 1 : (config->threads > MAX_THREADS) ? MAX_THREADS : config->threads;
+
+	struct Writer writer = { .config = config, .stream = stream };
+	struct Worker *workers = calloc(threads, sizeof *workers);
+	pthread_t handles[MAX_THREADS];
+	unsigned started = 0;
+
+	if (!workers || config->positions == 0 || config->file_records == 0) {
+		if (!workers) fprintf(stream, "failed to allocate %u workers\n", threads);
+		free(workers);
+		*stats = writer.stats;
+		return workers != NULL;
+	}
+
+	pthread_mutex_init(&writer.lock, NULL);
+	double start = wall_time();
+
+	for (; started < threads; started++) {
+		struct Worker *wk = &workers[started];
+
+		wk->writer = &writer;
+		wk->seed = (config->seed + started + 1) * 0x9e3779b97f4a7c15;
+
+		if (!init_engine(&wk->engine, HASH_MB, 1)) {
+			fprintf(stream, "failed to allocate the hash table of worker %u\n", started);
+
+			// the workers already started read it under the lock
+			pthread_mutex_lock(&writer.lock);
+			writer.failed = true;
+			pthread_mutex_unlock(&writer.lock);
+			break;
+		}
+
+		if (pthread_create(&handles[started], NULL, run_worker, wk) != 0) {
+			fprintf(stream, "failed to start worker %u\n", started);
+			free_engine(&wk->engine);
+
+			pthread_mutex_lock(&writer.lock);
+			writer.failed = true;
+			pthread_mutex_unlock(&writer.lock);
+			break;
+		}
+	}
+
+	for (unsigned i = 0; i < started; i++) {
+		pthread_join(handles[i], NULL);
+		free_engine(&workers[i].engine);
+	}
+
+	if (writer.file && fclose(writer.file) != 0) {
+		fprintf(stream, "failed to write %s.%u.bin\n", config->output, writer.stats.files - 1);
+		writer.failed = true;
+	}
+
+	writer.stats.seconds = wall_time() - start;
+	*stats = writer.stats;
+
+	pthread_mutex_destroy(&writer.lock);
+	free(workers);
+	return !writer.failed;
+}
@@ -0,0 +1,49 @@
+#ifndef SELFPLAY_H_
+#define SELFPLAY_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "position.h"
+#include "state.h"
+
+// one position of a game, 40 bytes in native byte order
+struct TrainingRecord {
+	struct Position pos;
+	int16_t score;   // of the search, in centipawns for the side to move
+	int8_t result;   // of the game for the side to move: 1, 0 or -1
+	uint8_t reserved;
+	uint32_t ply;    // from the start of the game, openings included
+};
+
+struct SelfplayConfig {
+	const char *output;     // prefix of the files, NULL to discard the records
+	uint64_t positions;     // records to write in total
+	uint64_t file_records;  // records per file before moving on to the next
+	unsigned threads;
+	uint64_t nodes;         // per move
+
+	// openings to start games from, at random, each followed by
+	// `random_plies` random moves
+	const struct State *openings;
+	size_t opening_count;
+	unsigned random_plies;
+
+	uint64_t seed;
+};
+
+struct SelfplayStats {
+	uint64_t positions, games, nodes;
+	unsigned files;
+	double seconds;
+};
+
+// Plays games with a fixed-node search on each thread, keeping the quiet
+// positions: not in check, no capture or promotion as the best move and no
+// mate score. Every finished game is written to `<output>.<n>.bin`, moving
+// on to the next file once it holds `file_records`.
+bool generate_selfplay(const struct SelfplayConfig *config, struct SelfplayStats *stats, FILE *stream);
+
+#endif /*SELFPLAY_H_*/
@@ -0,0 +1,195 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bits.h"
+#include "history.h"
+#include "search.h"
+#include "selfplay.h"
+#include "state.h"
+#include "text.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+enum {
+	MAX_LINE = 4096,
+	FILE_RECORDS = 1 << 20,
+	RANDOM_PLIES = 8,
+	DEFAULT_NODES = 5000,
+	BENCH_POSITIONS = 2000,
+};
+
+static
+unsigned default_threads() {
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return (n < 1) ? 1 : (n > MAX_THREADS) ? MAX_THREADS : n;
+}
+
+// one fen per line, blank lines and invalid fens skipped
+static
+struct State *read_openings(const char *path, size_t *count) {
+	FILE *file = fopen(path, "r");
+
+	if (!file) {
+		fprintf(stderr, "failed to open %s\n", path);
+		return NULL;
+	}
+
+	static char line[MAX_LINE];
+	struct State *openings = NULL;
+	size_t capacity = 0;
+	*count = 0;
+
+	while (fgets(line, sizeof line, file)) {
+		line[strcspn(line, "\r\n")] = '\0';
+		if (!line[0]) continue;
+
+		bool ok;
+		struct State state = parse_fen(line, &ok, stderr);
+		if (!ok) continue;
+
+		if (*count == capacity) {
+			capacity = capacity ? 2 * capacity : 256;
+			struct State *grown = realloc(openings, capacity * sizeof *openings);
+
+			if (!grown) {
+				fprintf(stderr, "failed to allocate %zu openings\n", capacity);
+				free(openings);
+				fclose(file);
+				return NULL;
+			}
+
+			openings = grown;
+		}
+
+		openings[(*count)++] = state;
+	}
+
+	fclose(file);
+
+	if (*count == 0) {
+		fprintf(stderr, "no openings in %s\n", path);
+		free(openings);
+		return NULL;
+	}
+
+	return openings;
+}
+
+static
+void print_stats(const struct SelfplayStats *stats, unsigned threads) {
+	printf("%llu positions from %llu games in %u files, %.3f s\n", (unsigned long long)stats->positions,
+	       (unsigned long long)stats->games, stats->files, stats->seconds);
+
+	printf("%.0f positions/s, %.0f positions/s per thread, %.0f nodes/position\n",
+	       stats->positions / stats->seconds, stats->positions / stats->seconds / threads,
+	       stats->positions ? (double)stats->nodes / stats->positions : 0.0);
+}
+
+// prints the first `count` records of a file
+static
+bool show(const char *path, uint64_t count) {
+	FILE *file = fopen(path, "rb");
+
+	if (!file) {
+		fprintf(stderr, "failed to open %s\n", path);
+		return false;
+	}
+
+	struct TrainingRecord record;
+
+	for (uint64_t i = 0; i < count && fread(&record, sizeof record, 1, file) == 1; i++) {
+		struct State state = {
+			.pos = record.pos,
+			.side_to_move = (record.ply & 1) ? BLACK : WHITE,
+			.movenumber = record.ply / 2 + 1,
+		};
+
+		char fen[MAX_LINE];
+		fen[generate_fen(state, fen)] = '\0';
+
+		printf("%s; score %d; result %d; ply %u\n", fen, record.score, record.result, (unsigned)record.ply);
+	}
+
+	fclose(file);
+	return true;
+}
+
+// positions/sec with the records discarded, for 1, 2, 4, ... and max_threads threads
+static
+void bench(uint64_t nodes, unsigned max_threads) {
+	printf("threads\t| positions\t| games\t\t| seconds\t| positions/s\t| per thread\n");
+
+	// doubling, with max_threads as the last row
+	for (unsigned threads = 1; threads <= max_threads;
+	     threads = (threads < max_threads && 2 * threads > max_threads) ? max_threads : 2 * threads) {
+		struct SelfplayConfig config = {
+			.positions = BENCH_POSITIONS * threads,
+			.file_records = FILE_RECORDS,
+			.threads = threads,
+			.nodes = nodes,
+			.random_plies = RANDOM_PLIES,
+			.seed = 1,
+		};
+
+		struct SelfplayStats stats;
+		if (!generate_selfplay(&config, &stats, stderr)) return;
+
+		printf("%u\t| %-10llu\t| %-10llu\t| %-10.3f\t| %-10.0f\t| %.0f\n", threads,
+		       (unsigned long long)stats.positions, (unsigned long long)stats.games, stats.seconds,
+		       stats.positions / stats.seconds, stats.positions / stats.seconds / threads);
+	}
+}
+
+int main(int argc, char **argv) {
+	init_bitbase();
+	init_zobrist();
+
+	// uchess-selfplay generate <output> <positions> [threads] [nodes] [openings]
+	if (argc > 3 && strcmp(argv[1], "generate") == 0) {
+		struct SelfplayConfig config = {
+			.output = argv[2],
+			.positions = strtoull(argv[3], NULL, 10),
+			.file_records = FILE_RECORDS,
+			.threads = (argc > 4) ? (unsigned)atoi(argv[4]) : default_threads(),
+			.nodes = (argc > 5) ? strtoull(argv[5], NULL, 10) : DEFAULT_NODES,
+			.random_plies = RANDOM_PLIES,
+			.seed = 1,
+		};
+
+		struct State *openings = NULL;
+
+		if (argc > 6) {
+			openings = read_openings(argv[6], &config.opening_count);
+			if (!openings) return 1;
+
+			config.openings = openings;
+		}
+
+		struct SelfplayStats stats;
+		bool ok = generate_selfplay(&config, &stats, stderr);
+
+		if (ok) print_stats(&stats, config.threads ? config.threads : 1);
+		free(openings);
+		return !ok;
+	}
+
+	// uchess-selfplay show <file> [count]
+	if (argc > 2 && strcmp(argv[1], "show") == 0) {
+		return !show(argv[2], (argc > 3) ? strtoull(argv[3], NULL, 10) : UINT64_MAX);
+	}
+
+	// uchess-selfplay bench [nodes] [max threads]
+	if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+		bench((argc > 2) ? strtoull(argv[2], NULL, 10) : DEFAULT_NODES,
+		      (argc > 3) ? (unsigned)atoi(argv[3]) : default_threads());
+		return 0;
+	}
+
+	fprintf(stderr, "usage: uchess-selfplay generate <output> <positions> [threads] [nodes] [openings]\n"
+	                "       uchess-selfplay show <file> [count]\n"
+	                "       uchess-selfplay bench [nodes] [max threads]\n");
+	return 1;
+}
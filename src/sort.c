@@ -0,0 +1,564 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "sort.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+enum { INSERTION_LIMIT = 32, SCATTER_LIMIT = 1 << 12, BUCKETS_PER_THREAD = 16, OVERSAMPLING = 16, MAX_THREADS = 256 };
+enum { PARALLEL_LIMIT = 1 << 16, MERGE_WAYS = 64, RUN_BUFFER = 1 << 16, MAX_PATH = 4096, MIN_CHUNK = 1024 };
+
+// the nth byte of the key, from the most significant byte of the white
+// bitboard to the least significant byte of Z, for little-endian words
+static inline
+unsigned key_byte(const struct Position *pos, unsigned digit) {
+	return ((const uint8_t *)pos)[8 * (digit >> 3) + 7 - (digit & 7)];
+}
+
+static
+void insertion_sort(struct Position *positions, size_t length) {
+	for (size_t i = 1; i < length; i++) {
+		struct Position pos = positions[i];
+		size_t j = i;
+
+		for (; j > 0 && compare_positions(positions[j - 1], pos) > 0; j--)
+			positions[j] = positions[j - 1];
+
+		positions[j] = pos;
+	}
+}
+
+// the first digit, from `digit` on, where the positions are not all equal,
+// found from the bits that differ from the first position in one pass
+static
+unsigned first_difference(const struct Position *positions, size_t length, unsigned digit) {
+	struct Position first = positions[0], difference = {0};
+
+	for (size_t i = 1; i < length; i++) {
+		difference.white |= positions[i].white ^ first.white;
+		difference.X |= positions[i].X ^ first.X;
+		difference.Y |= positions[i].Y ^ first.Y;
+		difference.Z |= positions[i].Z ^ first.Z;
+	}
+
+	while (digit < 32 && key_byte(&difference, digit) == 0)
+		digit++;
+
+	return digit;
+}
+
+// American flag sort: counts the bytes of the first digit that differs,
+// permutes the positions into their buckets by following cycles, then sorts
+// each bucket on the following digits
+static
+void radix_sort(struct Position *positions, struct Position *buffer, size_t length, unsigned digit) {
+	if (length <= INSERTION_LIMIT) {
+		insertion_sort(positions, length);
+		return;
+	}
+
+	if ((digit = first_difference(positions, length, digit)) == 32)
+		return;
+
+	size_t count[256] = {0};
+
+	for (size_t i = 0; i < length; i++)
+		count[key_byte(&positions[i], digit)]++;
+
+	size_t next[256], end[256], sum = 0;
+
+	for (unsigned b = 0; b < 256; b++) {
+		next[b] = sum;
+		sum += count[b];
+		end[b] = sum;
+	}
+
+	if (buffer && length > SCATTER_LIMIT) {
+		for (size_t i = 0; i < length; i++)
+			buffer[next[key_byte(&positions[i], digit)]++] = positions[i];
+
+		memcpy(positions, buffer, length * sizeof *positions);
+	}
+
+	else for (unsigned b = 0; b < 256; b++) {
+		while (next[b] < end[b]) {
+			struct Position pos = positions[next[b]];
+			unsigned d = key_byte(&pos, digit);
+
+			while (d != b) {
+				struct Position swap = positions[next[d]];
+				positions[next[d]++] = pos;
+				pos = swap;
+				d = key_byte(&pos, digit);
+			}
+
+			positions[next[b]++] = pos;
+		}
+	}
+
+	for (unsigned b = 0; b < 256; b++) {
+		if (count[b] > 1)
+			radix_sort(positions + end[b] - count[b], buffer, count[b], digit + 1);
+	}
+}
+
+static
+size_t drop_duplicates(struct Position *positions, size_t length) {
+	size_t unique = 0;
+
+	for (size_t i = 0; i < length; i++) {
+		if (unique == 0 || !same_position(positions[unique - 1], positions[i]))
+			positions[unique++] = positions[i];
+	}
+
+	return unique;
+}
+
+bool find_position(const struct Position *positions, size_t length, struct Position pos) {
+	size_t lo = 0, hi = length;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		int order = compare_positions(positions[mid], pos);
+
+		if (order == 0) return true;
+		if (order < 0)  lo = mid + 1;
+		else            hi = mid;
+	}
+
+	return false;
+}
+
+struct ParallelSort {
+	struct Position *positions;
+	struct Position *buffer;
+	uint16_t *buckets;
+	size_t length;
+	unsigned threads;
+	bool unique;
+
+	struct Position *splitters;
+	size_t bucket_count;
+
+	size_t *counts; // per thread and bucket, then where each thread scatters
+	size_t *start;  // per bucket, in the buffer
+	size_t *size;   // per bucket, after dropping duplicates
+	size_t *output; // per bucket, in the positions
+	size_t next_bucket;
+
+	void (*phase)(struct ParallelSort *sort, unsigned thread);
+};
+
+struct SortWorker {
+	struct ParallelSort *sort;
+	unsigned thread;
+};
+
+// the number of splitters not greater than the position
+static inline
+size_t find_bucket(const struct Position *splitters, size_t count, struct Position pos) {
+	size_t lo = 0, hi = count;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (compare_positions(splitters[mid], pos) <= 0) lo = mid + 1;
+		else                                             hi = mid;
+	}
+
+	return lo;
+}
+
+static
+void classify(struct ParallelSort *sort, unsigned thread) {
+	size_t first = sort->length * thread / sort->threads;
+	size_t last = sort->length * (thread + 1) / sort->threads;
+	size_t *counts = sort->counts + thread * sort->bucket_count;
+
+	for (size_t i = first; i < last; i++) {
+		size_t bucket = find_bucket(sort->splitters, sort->bucket_count - 1, sort->positions[i]);
+
+		sort->buckets[i] = bucket;
+		counts[bucket]++;
+	}
+}
+
+static
+void scatter(struct ParallelSort *sort, unsigned thread) {
+	size_t first = sort->length * thread / sort->threads;
+	size_t last = sort->length * (thread + 1) / sort->threads;
+	size_t *offsets = sort->counts + thread * sort->bucket_count;
+
+	for (size_t i = first; i < last; i++)
+		sort->buffer[offsets[sort->buckets[i]]++] = sort->positions[i];
+}
+
+static
+void sort_buckets(struct ParallelSort *sort, unsigned thread) {
+	(void)thread;
+	size_t bucket;
+
+	while ((bucket = __atomic_fetch_add(&sort->next_bucket, 1, __ATOMIC_RELAXED)) < sort->bucket_count) {
+		struct Position *positions = sort->buffer + sort->start[bucket];
+
+		// the scattered positions are free to use as scratch
+		radix_sort(positions, sort->positions + sort->start[bucket], sort->size[bucket], 0);
+
+		if (sort->unique)
+			sort->size[bucket] = drop_duplicates(positions, sort->size[bucket]);
+	}
+}
+
+static
+void copy_back(struct ParallelSort *sort, unsigned thread) {
+	for (size_t bucket = thread; bucket < sort->bucket_count; bucket += sort->threads) {
+		memcpy(sort->positions + sort->output[bucket], sort->buffer + sort->start[bucket],
+		       sort->size[bucket] * sizeof *sort->buffer);
+	}
+}
+
+static
+void *run_worker(void *arg) {
+	struct SortWorker *w = arg;
+	w->sort->phase(w->sort, w->thread);
+	return NULL;
+}
+
+static
+void run_phase(struct ParallelSort *sort, void (*phase)(struct ParallelSort *, unsigned)) {
+	pthread_t handles[MAX_THREADS];
+	struct SortWorker workers[MAX_THREADS];
+	bool started[MAX_THREADS];
+
+	sort->phase = phase;
+
+	for (unsigned i = 0; i < sort->threads; i++) {
+		workers[i] = (struct SortWorker){ sort, i };
+
+		// the phases need no other thread, so a share without one runs here
+		started[i] = pthread_create(&handles[i], NULL, run_worker, &workers[i]) == 0;
+		if (!started[i]) run_worker(&workers[i]);
+	}
+
+	for (unsigned i = 0; i < sort->threads; i++) {
+		if (started[i]) pthread_join(handles[i], NULL);
+	}
+}
+
+static
+void free_parallel_sort(struct ParallelSort *sort) {
+	free(sort->buffer);
+	free(sort->buckets);
+	free(sort->splitters);
+	free(sort->counts);
+	free(sort->start);
+	free(sort->size);
+	free(sort->output);
+}
+
+// false when the buffers cannot be allocated
+static
+bool parallel_sort(struct ParallelSort *sort) {
+	size_t buckets = sort->bucket_count = (size_t)sort->threads * BUCKETS_PER_THREAD;
+	size_t samples = buckets * OVERSAMPLING;
+
+	sort->buffer = malloc(sort->length * sizeof *sort->buffer);
+	sort->buckets = malloc(sort->length * sizeof *sort->buckets);
+	sort->splitters = malloc(samples * sizeof *sort->splitters);
+	sort->counts = calloc(sort->threads * buckets, sizeof *sort->counts);
+	sort->start = malloc(buckets * sizeof *sort->start);
+	sort->size = malloc(buckets * sizeof *sort->size);
+	sort->output = malloc(buckets * sizeof *sort->output);
+
+	if (!sort->buffer || !sort->buckets || !sort->splitters || !sort->counts
+	    || !sort->start || !sort->size || !sort->output) {
+		free_parallel_sort(sort);
+		return false;
+	}
+
+	// evenly spaced samples, every OVERSAMPLING-th of them sorted is a splitter
+	for (size_t i = 0; i < samples; i++)
+		sort->splitters[i] = sort->positions[i * sort->length / samples];
+
+	radix_sort(sort->splitters, NULL, samples, 0);
+
+	for (size_t i = 0; i + 1 < buckets; i++)
+		sort->splitters[i] = sort->splitters[(i + 1) * OVERSAMPLING];
+
+	run_phase(sort, classify);
+
+	size_t sum = 0;
+
+	for (size_t b = 0; b < buckets; b++) {
+		sort->start[b] = sum;
+
+		for (unsigned t = 0; t < sort->threads; t++) {
+			size_t count = sort->counts[t * buckets + b];
+			sort->counts[t * buckets + b] = sum;
+			sum += count;
+		}
+
+		sort->size[b] = sum - sort->start[b];
+	}
+
+	run_phase(sort, scatter);
+	run_phase(sort, sort_buckets);
+
+	sum = 0;
+
+	for (size_t b = 0; b < buckets; b++) {
+		sort->output[b] = sum;
+		sum += sort->size[b];
+	}
+
+	run_phase(sort, copy_back);
+
+	sort->length = sum;
+	free_parallel_sort(sort);
+	return true;
+}
+
+size_t sort_positions(struct Position *positions, size_t length, unsigned threads, bool unique) {
+	if (threads > MAX_THREADS)
+		threads = MAX_THREADS;
+
+	if (threads > 1 && length >= PARALLEL_LIMIT) {
+		struct ParallelSort sort = {
+			.positions = positions,
+			.length = length,
+			.threads = threads,
+			.unique = unique,
+		};
+
+		if (parallel_sort(&sort))
+			return sort.length;
+	}
+
+	// without a buffer every bucket is permuted in place
+	struct Position *buffer = malloc(length * sizeof *buffer);
+
+	radix_sort(positions, buffer, length, 0);
+	free(buffer);
+
+	return unique ? drop_duplicates(positions, length) : length;
+}
+
+struct RunReader {
+	FILE *file;
+	char *buffer;
+	struct Position pos;
+};
+
+static inline
+bool read_position(struct RunReader *reader) {
+	return fread(&reader->pos, sizeof reader->pos, 1, reader->file) == 1;
+}
+
+static
+void sift_down(struct RunReader **heap, size_t length, size_t i) {
+	for (;;) {
+		size_t least = i, left = 2*i + 1, right = 2*i + 2;
+
+		if (left < length && compare_positions(heap[left]->pos, heap[least]->pos) < 0) least = left;
+		if (right < length && compare_positions(heap[right]->pos, heap[least]->pos) < 0) least = right;
+		if (least == i) return;
+
+		struct RunReader *swap = heap[i];
+		heap[i] = heap[least];
+		heap[least] = swap;
+		i = least;
+	}
+}
+
+static
+void run_path(const char *output, size_t run, char *path) {
+	snprintf(path, MAX_PATH, "%s.run%zu", output, run);
+}
+
+// k-way merge of the runs [first, first + count) into `path` without
+// duplicates, removing the runs
+static
+bool merge_runs(const char *output, size_t first, size_t count, const char *path, FILE *stream) {
+	struct RunReader readers[MERGE_WAYS] = {0};
+	struct RunReader *heap[MERGE_WAYS];
+	size_t length = 0;
+	char run[MAX_PATH];
+
+	FILE *file = fopen(path, "wb");
+	bool ok = file != NULL;
+
+	if (!ok) fprintf(stream, "failed to create %s\n", path);
+
+	for (size_t i = 0; i < count && ok; i++) {
+		run_path(output, first + i, run);
+
+		readers[i].file = fopen(run, "rb");
+		readers[i].buffer = malloc(RUN_BUFFER);
+
+		if (!readers[i].file || !readers[i].buffer) {
+			fprintf(stream, "failed to open %s\n", run);
+			ok = false;
+			break;
+		}
+
+		setvbuf(readers[i].file, readers[i].buffer, _IOFBF, RUN_BUFFER);
+
+		if (read_position(&readers[i]))
+			heap[length++] = &readers[i];
+	}
+
+	for (size_t i = length / 2; i-- > 0;)
+		sift_down(heap, length, i);
+
+	struct Position last;
+	bool written = false;
+
+	while (length > 0 && ok) {
+		if (!written || !same_position(last, heap[0]->pos)) {
+			last = heap[0]->pos;
+			written = true;
+			ok = fwrite(&last, sizeof last, 1, file) == 1;
+		}
+
+		if (!read_position(heap[0]))
+			heap[0] = heap[--length];
+
+		sift_down(heap, length, 0);
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (readers[i].file) fclose(readers[i].file);
+		free(readers[i].buffer);
+
+		run_path(output, first + i, run);
+		remove(run);
+	}
+
+	if (file) ok &= fclose(file) == 0;
+	if (!ok) fprintf(stream, "failed to merge into %s\n", path);
+	return ok;
+}
+
+bool sort_position_file(const char *input, const char *output, size_t memory, unsigned threads, FILE *stream) {
+	struct stat st;
+
+	if (stat(input, &st) != 0 || st.st_size % sizeof(struct Position) != 0) {
+		fprintf(stream, "%s is not a file of positions\n", input);
+		return false;
+	}
+
+	FILE *file = fopen(input, "rb");
+
+	// every sort scatters into a buffer of the chunk's size, the parallel
+	// sort also needs a bucket per position
+	size_t record = 2 * sizeof(struct Position) + ((threads > 1) ? sizeof(uint16_t) : 0);
+	size_t capacity = memory / record;
+
+	if (capacity < MIN_CHUNK)
+		capacity = MIN_CHUNK;
+
+	struct Position *chunk = malloc(capacity * sizeof *chunk);
+
+	if (!file || !chunk) {
+		fprintf(stream, "failed to open %s\n", input);
+		if (file) fclose(file);
+		free(chunk);
+		return false;
+	}
+
+	size_t runs = 0, length;
+	bool ok = true;
+	char path[MAX_PATH];
+
+	while (ok && (length = fread(chunk, sizeof *chunk, capacity, file)) > 0) {
+		length = sort_positions(chunk, length, threads, true);
+		run_path(output, runs++, path);
+
+		FILE *run = fopen(path, "wb");
+		ok = run && fwrite(chunk, sizeof *chunk, length, run) == length;
+		if (run) ok &= fclose(run) == 0;
+
+		if (!ok) fprintf(stream, "failed to write %s\n", path);
+	}
+
+	ok &= !ferror(file);
+	fclose(file);
+	free(chunk);
+
+	size_t first = 0;
+
+	// intermediate passes while there are too many runs to open together
+	while (ok && runs - first > MERGE_WAYS) {
+		run_path(output, runs++, path);
+		ok = merge_runs(output, first, MERGE_WAYS, path, stream);
+		first += MERGE_WAYS;
+	}
+
+	if (ok && runs - first == 1) {
+		run_path(output, first, path);
+		ok = rename(path, output) == 0;
+		first++;
+	}
+
+	else if (ok) {
+		ok = merge_runs(output, first, runs - first, output, stream);
+		first = runs;
+	}
+
+	// runs left behind by a failure
+	for (; first < runs; first++) {
+		run_path(output, first, path);
+		remove(path);
+	}
+
+	return ok;
+}
+
+bool open_position_file(struct PositionFile *file, const char *path, FILE *stream) {
+	*file = (struct PositionFile){0};
+
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+
+	if (fd < 0 || fstat(fd, &st) != 0) {
+		fprintf(stream, "failed to open %s\n", path);
+		if (fd >= 0) close(fd);
+		return false;
+	}
+
+	if (st.st_size % sizeof(struct Position) != 0) {
+		fprintf(stream, "%s is not a file of positions\n", path);
+		close(fd);
+		return false;
+	}
+
+	if (st.st_size > 0) {
+		void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+		if (data == MAP_FAILED) {
+			fprintf(stream, "failed to map %s\n", path);
+			close(fd);
+			return false;
+		}
+
+		file->positions = data;
+		file->length = st.st_size / sizeof(struct Position);
+	}
+
+	// the mapping stays valid without the descriptor
+	close(fd);
+	return true;
+}
+
+void close_position_file(struct PositionFile *file) {
+	if (file->positions)
+		munmap((void *)file->positions, file->length * sizeof(struct Position));
+
+	*file = (struct PositionFile){0};
+}
@@ -0,0 +1,38 @@
+#ifndef SORT_H_
+#define SORT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "position.h"
+
+// Sorts positions as 256-bit keys (see compare_positions) with an MSD radix
+// sort on bytes, where each bucket starts at the first byte its positions do
+// not share. When a buffer of the positions' size can be allocated, large
+// buckets are scattered through it and small ones permuted in place;
+// otherwise every bucket is permuted in place. With more than one thread
+// the positions are first split around sampled splitters into a buffer, so
+// that equal positions share a bucket, and the buckets are sorted in
+// parallel. With `unique` the duplicates are dropped while the
+// buckets are copied back. Returns the new length.
+size_t sort_positions(struct Position *positions, size_t length, unsigned threads, bool unique);
+
+// Sorts a file of raw positions (32 bytes each, in memory order) into a file
+// of unique positions, through sorted runs next to the output merged
+// afterwards, each sorted within `memory` bytes including the buffers.
+bool sort_position_file(const char *input, const char *output, size_t memory, unsigned threads, FILE *stream);
+
+// a sorted file of positions mapped read-only
+struct PositionFile {
+	const struct Position *positions;
+	size_t length;
+};
+
+bool open_position_file(struct PositionFile *file, const char *path, FILE *stream);
+void close_position_file(struct PositionFile *file);
+
+// binary search of a sorted array
+bool find_position(const struct Position *positions, size_t length, struct Position pos);
+
+#endif /*SORT_H_*/
@@ -0,0 +1,228 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bits.h"
+#include "movegen.h"
+#include "position.h"
+#include "sort.h"
+#include "state.h"
+#include "text.h"
+#include "timer.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+enum { DEFAULT_MEMORY = 1024, DEFAULT_POSITIONS = 1 << 24, MAX_LINE = 4096, MAX_PLIES = 200 };
+
+// in MiB, ru_maxrss is in KiB on linux
+static
+double peak_memory() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss / 1024.0;
+}
+
+// writes the positions of one fen per line as raw records
+static
+bool pack(const char *path) {
+	static char line[MAX_LINE];
+	FILE *file = fopen(path, "wb");
+	size_t count = 0;
+
+	if (!file) {
+		fprintf(stderr, "failed to create %s\n", path);
+		return false;
+	}
+
+	while (fgets(line, sizeof line, stdin)) {
+		line[strcspn(line, "\r\n")] = '\0';
+
+		bool ok;
+		struct State state = parse_fen(line, &ok, stderr);
+
+		if (line[0] && ok && fwrite(&state.pos, sizeof state.pos, 1, file) == 1)
+			count++;
+	}
+
+	if (fclose(file) != 0) {
+		fprintf(stderr, "failed to write %s\n", path);
+		return false;
+	}
+
+	printf("%zu positions\n", count);
+	return true;
+}
+
+static
+bool sort_file(const char *input, const char *output, size_t memory, unsigned threads) {
+	struct stat st;
+	double start = wall_time();
+
+	if (stat(input, &st) != 0) {
+		fprintf(stderr, "failed to open %s\n", input);
+		return false;
+	}
+
+	if (!sort_position_file(input, output, memory << 20, threads, stderr))
+		return false;
+
+	double seconds = wall_time() - start;
+	struct PositionFile file;
+
+	if (!open_position_file(&file, output, stderr))
+		return false;
+
+	printf("%llu positions, %zu unique, %.3fs, %.3f GB/s, peak memory %.1f MiB\n",
+	       (unsigned long long)st.st_size / sizeof(struct Position), file.length, seconds,
+	       st.st_size / seconds / 1e9, peak_memory());
+
+	close_position_file(&file);
+	return true;
+}
+
+static
+void find(const struct PositionFile *file, const char *fen) {
+	bool ok;
+	struct State state = parse_fen(fen, &ok, stderr);
+	if (!ok) return;
+
+	printf("%s; %s\n", fen, find_position(file->positions, file->length, state.pos) ? "found" : "missing");
+}
+
+// positions of random games from the starting position, so that the early
+// ones repeat often
+static
+void random_positions(struct Position *positions, size_t count) {
+	uint64_t seed = 0x9e3779b97f4a7c15;
+	bool ok;
+
+	struct State start = parse_fen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", &ok, stderr);
+	struct Position pos = start.pos;
+	unsigned ply = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		positions[i] = pos;
+
+		struct MoveList list = generate_moves(pos);
+
+		if (list.length == 0 || ++ply == MAX_PLIES) {
+			pos = start.pos;
+			ply = 0;
+			continue;
+		}
+
+		seed ^= seed >> 12, seed ^= seed << 25, seed ^= seed >> 27;
+		pos = make_move(pos, list.moves[(seed * 0x2545f4914f6cdd1d >> 32) % list.length]);
+	}
+}
+
+static
+bool is_sorted(const struct Position *positions, size_t length, bool unique) {
+	for (size_t i = 1; i < length; i++) {
+		if (compare_positions(positions[i - 1], positions[i]) >= !unique)
+			return false;
+	}
+
+	return true;
+}
+
+// sorts random game positions in memory, with and without dropping
+// duplicates, for 1, 2, 4, ... and max_threads threads
+static
+bool bench(size_t count, unsigned max_threads) {
+	struct Position *positions = malloc(count * sizeof *positions);
+	struct Position *copy = malloc(count * sizeof *copy);
+
+	if (!positions || !copy) {
+		fprintf(stderr, "failed to allocate %zu positions\n", count);
+		free(positions);
+		free(copy);
+		return false;
+	}
+
+	random_positions(positions, count);
+
+	printf("threads\t| unique\t| positions\t| output\t| ms\t\t| GB/s\n");
+
+	// doubling, with max_threads as the last row
+	for (unsigned threads = 1; threads <= max_threads;
+	     threads = (threads < max_threads && 2 * threads > max_threads) ? max_threads : 2 * threads) {
+		for (int unique = 0; unique < 2; unique++) {
+			memcpy(copy, positions, count * sizeof *copy);
+
+			double start = wall_time();
+			size_t length = sort_positions(copy, count, threads, unique);
+			double seconds = wall_time() - start;
+
+			printf("%u\t| %s\t\t| %zu\t| %zu\t| %-10.3f\t| %.3f%s\n", threads, unique ? "yes" : "no", count,
+			       length, seconds * 1e3, count * sizeof *copy / seconds / 1e9,
+			       is_sorted(copy, length, unique) ? "" : "\t(not sorted)");
+		}
+	}
+
+	free(positions);
+	free(copy);
+	return true;
+}
+
+int main(int argc, char **argv) {
+	init_bitbase();
+
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned default_threads = (cores > 0) ? cores : 1;
+
+	// uchess-sort pack <positions>, reading one fen per line from stdin
+	if (argc > 2 && strcmp(argv[1], "pack") == 0) {
+		return !pack(argv[2]);
+	}
+
+	// uchess-sort sort <positions> <sorted> [memory MiB] [threads]
+	else if (argc > 3 && strcmp(argv[1], "sort") == 0) {
+		return !sort_file(argv[2], argv[3], (argc > 4) ? strtoull(argv[4], NULL, 10) : DEFAULT_MEMORY,
+		                  (argc > 5) ? (unsigned)atoi(argv[5]) : default_threads);
+	}
+
+	// uchess-sort find <sorted> [fen | -], reading one fen per line from
+	// stdin for -
+	else if (argc > 2 && strcmp(argv[1], "find") == 0) {
+		struct PositionFile file;
+
+		if (!open_position_file(&file, argv[2], stderr))
+			return 1;
+
+		if (argc > 3 && strcmp(argv[3], "-") != 0) {
+			find(&file, argv[3]);
+		}
+
+		else {
+			static char line[MAX_LINE];
+
+			while (fgets(line, sizeof line, stdin)) {
+				line[strcspn(line, "\r\n")] = '\0';
+				if (line[0]) find(&file, line);
+			}
+		}
+
+		close_position_file(&file);
+	}
+
+	// uchess-sort bench [positions] [max threads]
+	else if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+		return !bench((argc > 2) ? strtoull(argv[2], NULL, 10) : DEFAULT_POSITIONS,
+		              (argc > 3) ? (unsigned)atoi(argv[3]) : default_threads);
+	}
+
+	else {
+		fprintf(stderr, "usage: uchess-sort pack <positions> < fens\n"
+		                "       uchess-sort sort <positions> <sorted> [memory MiB] [threads]\n"
+		                "       uchess-sort find <sorted> [fen | -]\n"
+		                "       uchess-sort bench [positions] [max threads]\n");
+		return 1;
+	}
+
+	return 0;
+}
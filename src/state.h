@@ -3,8 +3,6 @@
 
 #include "position.h"
 
-enum Color { WHITE, BLACK };
-
 struct State {
 	struct Position pos;
 	enum Color side_to_move;
@@ -13,4 +11,15 @@ struct State {
 	unsigned movenumber;
 };
 
+// converts between absolute squares (as written in FEN, SAN and UCI) and the
+// squares of the stored board, which is rotated when black is to move
+static inline int board_square(struct State state, int sq) {
+#ifdef ABSOLUTE_COLORS
+	(void)state;
+	return sq;
+#else
+	return (state.side_to_move == BLACK) ? sq ^ 56 : sq;
+#endif
+}
+
 #endif //STATE_H_
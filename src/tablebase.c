@@ -0,0 +1,897 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "tablebase.h"
+
+#include "bits.h"
+#include "movegen.h"
+#include "position.h"
+#include "retro.h"
+#include "timer.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { KK_PAWNLESS = 462, KK_PAWNS = 1806, CHUNK = 1024, TB_MAX_THREADS = 256 };
+enum Symmetry { FLIP_FILE = 1, FLIP_RANK = 2, TRANSPOSE = 4 };
+
+static const char PIECE_CHARS[] = " PNBRQK";
+
+// king pairs without and with pawns: the king of the side to move lies in
+// a1-d1-d4 (and on or below the diagonal for both kings) or on files a-d
+static int16_t kk_index[2][64][64];
+static uint8_t kk_squares[2][KK_PAWNS][2];
+static const unsigned kk_count[2] = { KK_PAWNLESS, KK_PAWNS };
+
+static
+void init_kings() {
+	for (int pawns = 0; pawns < 2; pawns++) {
+		unsigned count = 0;
+
+		for (square ours = 0; ours < 64; ours++) {
+			for (square theirs = 0; theirs < 64; theirs++) {
+				int file = ours & 7, rank = ours >> 3;
+				kk_index[pawns][ours][theirs] = -1;
+
+				if (ours == theirs || (king_attacks(ours) >> theirs) & 1)
+					continue;
+
+				if (file > 3)
+					continue;
+
+				if (!pawns && (rank > file || (rank == file && (theirs >> 3) > (theirs & 7))))
+					continue;
+
+				kk_squares[pawns][count][0] = ours;
+				kk_squares[pawns][count][1] = theirs;
+				kk_index[pawns][ours][theirs] = count++;
+			}
+		}
+
+		assert(count == kk_count[pawns]);
+	}
+}
+
+static inline
+square transform(square sq, unsigned symmetry) {
+	if (symmetry & FLIP_FILE) sq ^= 7;
+	if (symmetry & FLIP_RANK) sq ^= 56;
+	if (symmetry & TRANSPOSE) sq = ((sq & 7) << 3) | (sq >> 3);
+	return sq;
+}
+
+// the symmetry taking the kings to their canonical squares
+static inline
+unsigned symmetry(const struct Table *table, square ours, square theirs) {
+	unsigned s = 0;
+
+	if ((ours & 7) > 3) {
+		s |= FLIP_FILE;
+		ours ^= 7, theirs ^= 7;
+	}
+
+	if (table->pawns)
+		return s;
+
+	if ((ours >> 3) > 3) {
+		s |= FLIP_RANK;
+		ours ^= 56, theirs ^= 56;
+	}
+
+	if ((ours >> 3) > (ours & 7) || ((ours >> 3) == (ours & 7) && (theirs >> 3) > (theirs & 7)))
+		s |= TRANSPOSE;
+
+	return s;
+}
+
+// the side to move plays up the board as WHITE, other info bits are ignored
+static inline
+struct Position normalize(struct Position pos) {
+#ifdef ABSOLUTE_COLORS
+	if (turn(pos) == BLACK) {
+		bitboard occ = occupied(pos);
+
+		return (struct Position){
+			rotate(occ & ~pos.white), rotate(pos.X & occ), rotate(pos.Y & occ), rotate(pos.Z & occ)
+		};
+	}
+#endif
+
+	return pos;
+}
+
+static
+uint64_t transformed_index(const struct Table *table, struct Position pos, unsigned s) {
+	bitboard occ = occupied(pos);
+	bitboard us = pos.white, them = occ & ~pos.white;
+	bitboard kings = extract(pos, King);
+
+	uint64_t index = kk_index[table->pawns][transform(lsb(kings & us), s)][transform(lsb(kings & them), s)];
+	assert(index < kk_count[table->pawns]);
+
+	for (size_t i = 0; i < table->pieces;) {
+		enum PieceType T = table->types[i];
+		bitboard pieces = extract(pos, T) & (table->theirs[i] ? them : us);
+
+		// identical pieces by ascending square
+		square squares[MAX_TB_PIECES];
+		size_t n = 0;
+
+		for (; pieces; pieces &= pieces - 1) {
+			square sq = transform(lsb(pieces), s);
+			size_t j = n++;
+
+			for (; j > 0 && squares[j - 1] > sq; j--)
+				squares[j] = squares[j - 1];
+
+			squares[j] = sq;
+		}
+
+		for (size_t j = 0; j < n; j++, i++) {
+			index = (T == Pawn) ? index * 48 + squares[j] - 8 : index * 64 + squares[j];
+		}
+	}
+
+	return index;
+}
+
+// index of a normalized position of the table's material
+static
+uint64_t position_index(const struct Table *table, struct Position pos) {
+	bitboard kings = extract(pos, King);
+	square ours = lsb(kings & pos.white), theirs = lsb(kings & ~pos.white);
+
+	unsigned s = symmetry(table, ours, theirs);
+	uint64_t index = transformed_index(table, pos, s);
+
+	// with both kings on the diagonal, the lower index of the two reflections
+	const bitboard diagonal = 0x8040201008040201;
+
+	if (!table->pawns && ((diagonal >> transform(ours, s)) & (diagonal >> transform(theirs, s)) & 1)) {
+		uint64_t reflected = transformed_index(table, pos, s ^ TRANSPOSE);
+		if (reflected < index) index = reflected;
+	}
+
+	return index;
+}
+
+static inline
+void place(struct Position *pos, square sq, enum PieceType T, bool theirs) {
+	pos->X |= (bitboard)((T >> 0) & 1) << sq;
+	pos->Y |= (bitboard)((T >> 1) & 1) << sq;
+	pos->Z |= (bitboard)((T >> 2) & 1) << sq;
+
+	if (!theirs) pos->white |= 1ULL << sq;
+}
+
+// whether the side not to move is in check
+static
+bool opponent_in_check(struct Position pos) {
+	bitboard occ = occupied(pos);
+	bitboard us = pos.white;
+	square ksq = lsb(extract(pos, King) & ~us);
+
+	bitboard bishops = (extract(pos, Bishop) | extract(pos, Queen)) & us;
+	bitboard rooks   = (extract(pos, Rook)   | extract(pos, Queen)) & us;
+
+	return (pawn_attacks(BLACK, 1ULL << ksq) & extract(pos, Pawn) & us)
+	     | (knight_attacks(ksq) & extract(pos, Knight) & us)
+	     | (bishop_attacks(ksq, occ) & bishops)
+	     | (rook_attacks(ksq, occ) & rooks);
+}
+
+bool tablebase_position(const struct Table *table, uint64_t index, struct Position *pos) {
+	const uint64_t original = index;
+	square squares[MAX_TB_PIECES];
+
+	for (size_t i = table->pieces; i-- > 0;) {
+		unsigned size = (table->types[i] == Pawn) ? 48 : 64;
+		squares[i] = index % size + ((size == 48) ? 8 : 0);
+		index /= size;
+	}
+
+	square ours = kk_squares[table->pawns][index][0];
+	square theirs = kk_squares[table->pawns][index][1];
+
+	*pos = (struct Position){0};
+	place(pos, ours, King, false);
+	place(pos, theirs, King, true);
+
+	bitboard occ = (1ULL << ours) | (1ULL << theirs);
+
+	for (size_t i = 0; i < table->pieces; i++) {
+		if ((occ >> squares[i]) & 1)
+			return false;
+
+		occ |= 1ULL << squares[i];
+		place(pos, squares[i], table->types[i], table->theirs[i]);
+	}
+
+	return !opponent_in_check(*pos) && position_index(table, *pos) == original;
+}
+
+static
+void init_table(struct Table *table, uint8_t counts[2][7]) {
+	memset(table, 0, sizeof *table);
+	char *name = table->name;
+
+	for (int theirs = 0; theirs < 2; theirs++) {
+		*name++ = 'K';
+
+		for (enum PieceType T = Queen; T >= Pawn; T--) {
+			for (unsigned n = 0; n < counts[theirs][T]; n++) {
+				*name++ = PIECE_CHARS[T];
+
+				table->types[table->pieces] = T;
+				table->theirs[table->pieces++] = theirs;
+				table->pawns |= T == Pawn;
+			}
+
+			table->material |= (uint64_t)counts[theirs][T] << (4 * (T - Pawn) + 20 * theirs);
+		}
+
+		if (!theirs) *name++ = 'v';
+	}
+
+	table->size = kk_count[table->pawns];
+
+	for (size_t i = 0; i < table->pieces; i++) {
+		table->size *= (table->types[i] == Pawn) ? 48 : 64;
+	}
+}
+
+static
+bool parse_signature(const char *signature, uint8_t counts[2][7], FILE *stream) {
+	memset(counts, 0, 2 * 7);
+
+	int theirs = 0;
+	size_t pieces = 0;
+
+	for (const char *c = signature; *c; c++) {
+		const char *piece = (*c != ' ') ? strchr(PIECE_CHARS, *c) : NULL;
+
+		if ((*c == 'v' || *c == 'V') && !theirs) {
+			theirs = 1;
+		}
+
+		else if (piece) {
+			counts[theirs][piece - PIECE_CHARS]++;
+			pieces++;
+		}
+
+		else {
+			fprintf(stream, "invalid material signature: %s\n", signature);
+			return false;
+		}
+	}
+
+	if (counts[0][King] != 1 || counts[1][King] != 1 || pieces > MAX_TB_PIECES) {
+		fprintf(stream, "material signature needs one king per side and at most %d pieces: %s\n",
+		        MAX_TB_PIECES, signature);
+		return false;
+	}
+
+	// positions don't keep an en-passant file, which only matters with a pawn
+	// of each side, so the results of those tables would be wrong
+	if (counts[0][Pawn] && counts[1][Pawn]) {
+		fprintf(stream, "material signature has pawns on both sides, en passant isn't covered: %s\n", signature);
+		return false;
+	}
+
+	return true;
+}
+
+static inline
+size_t slot_of(uint64_t material) {
+	return (material * 0x9e3779b97f4a7c15) >> (64 - TB_SLOT_BITS);
+}
+
+static
+const struct Table *find_table(const struct Tablebases *tb, uint64_t material) {
+	for (size_t slot = slot_of(material);; slot = (slot + 1) & ((1 << TB_SLOT_BITS) - 1)) {
+		uint16_t entry = tb->slots[slot];
+
+		if (entry == 0)
+			return NULL;
+
+		if (tb->tables[entry - 1].material == material)
+			return &tb->tables[entry - 1];
+	}
+}
+
+static
+void add_table(struct Tablebases *tb, const struct Table *table) {
+	assert(tb->count < MAX_TABLES);
+
+	size_t slot = slot_of(table->material);
+
+	while (tb->slots[slot])
+		slot = (slot + 1) & ((1 << TB_SLOT_BITS) - 1);
+
+	tb->tables[tb->count] = *table;
+	tb->slots[slot] = ++tb->count;
+}
+
+void init_tablebases(struct Tablebases *tb, const char *directory, unsigned threads) {
+	init_kings();
+
+	memset(tb, 0, sizeof *tb);
+	tb->directory = directory;
+	tb->threads = threads;
+}
+
+void free_tablebases(struct Tablebases *tb) {
+	for (size_t i = 0; i < tb->count; i++) {
+		free(tb->tables[i].wdl);
+		free(tb->tables[i].dtm);
+	}
+
+	tb->count = 0;
+	memset(tb->slots, 0, sizeof tb->slots);
+}
+
+// Results while generating, from the point of view of the side to move:
+// the WDL in the low two bits and plies to mate above them. Unresolved
+// positions are draws once nothing changes anymore.
+
+enum { BROKEN = TB_BROKEN, UNKNOWN = TB_DRAW };
+
+static inline uint16_t win_in(unsigned plies)  { return plies << 2 | TB_WIN; }
+static inline uint16_t loss_in(unsigned plies) { return plies << 2 | TB_LOSS; }
+
+static inline
+uint16_t table_value(const struct Table *table, uint64_t index) {
+	enum WDL wdl = (table->wdl[index >> 2] >> (2 * (index & 3))) & 3;
+	unsigned moves = table->dtm[index];
+
+	switch (wdl) {
+		case TB_WIN:  return win_in(2 * moves - 1);
+		case TB_LOSS: return loss_in(2 * moves);
+		default:      return wdl;
+	}
+}
+
+// Generation is retrograde by levels of plies to mate: at level k, each
+// position lost in k plies makes its predecessors won in k + 1, and each
+// position won in k plies checks whether its predecessors now lose, going
+// forward over their moves. Both sides to move are generated together.
+//
+// Conversions (captures and promotions) are probed from the finished smaller
+// tables up front, so a position may start out won in more plies than it
+// turns out to be. Values only ever settle at or above the current level,
+// so threads never race on results of the level they are reading.
+struct Generator {
+	const struct Tablebases *tb;
+	const struct Table *tables[2];
+	uint16_t *values[2];
+
+	unsigned level;
+	unsigned deepest; // most plies assigned so far
+	bool truncated;   // a position had more unmoves than the list holds
+};
+
+static inline
+void raise_deepest(struct Generator *g, unsigned plies) {
+	unsigned deepest = __atomic_load_n(&g->deepest, __ATOMIC_RELAXED);
+
+	while (plies > deepest && !__atomic_compare_exchange_n(&g->deepest, &deepest, plies, true,
+	                                                       __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+// value of a position converted to a smaller table
+static inline
+uint16_t converted_value(const struct Generator *g, struct Position child, uint64_t material) {
+	const struct Table *table = find_table(g->tb, material);
+	assert(table && "missing conversion table");
+
+	return table_value(table, position_index(table, child));
+}
+
+// value of a position of the other table, or of a converted position
+static inline
+uint16_t child_value(const struct Generator *g, int t, struct Position child, bool *converted) {
+	child = normalize(child);
+	uint64_t material = material_key(child);
+
+	const struct Table *table = g->tables[!t];
+	*converted = material != table->material;
+
+	if (*converted)
+		return converted_value(g, child, material);
+
+	return __atomic_load_n(&g->values[!t][position_index(table, child)], __ATOMIC_RELAXED);
+}
+
+// mates, stalemates and conversions
+static
+void init_position(struct Generator *g, int t, uint64_t index) {
+	struct Position pos;
+	uint16_t *value = &g->values[t][index];
+
+	if (!tablebase_position(g->tables[t], index, &pos)) {
+		*value = BROKEN;
+		return;
+	}
+
+	struct MoveList moves = generate_moves(pos);
+
+	if (moves.length == 0) {
+		*value = enemy_checks(pos) ? loss_in(0) : UNKNOWN;
+		return;
+	}
+
+	unsigned best_win = 0, worst_loss = 0;
+	bool losing = true;
+
+	for (size_t i = 0; i < moves.length; i++) {
+		struct Position next = normalize(make_move(pos, moves.moves[i]));
+		uint64_t material = material_key(next);
+
+		// the other table is still unknown
+		if (material == g->tables[!t]->material) {
+			losing = false;
+			continue;
+		}
+
+		uint16_t child = converted_value(g, next, material);
+		unsigned plies = (child >> 2) + 1;
+
+		if ((child & 3) == TB_LOSS && (best_win == 0 || plies < best_win)) best_win = plies;
+		if ((child & 3) == TB_WIN && plies > worst_loss) worst_loss = plies;
+
+		losing &= (child & 3) == TB_WIN;
+	}
+
+	if (best_win) {
+		*value = win_in(best_win);
+		raise_deepest(g, best_win);
+	}
+
+	else if (losing) {
+		*value = loss_in(worst_loss);
+		raise_deepest(g, worst_loss);
+	}
+
+	else {
+		*value = UNKNOWN;
+	}
+}
+
+static inline
+void set_win(struct Generator *g, uint16_t *value, unsigned plies) {
+	uint16_t current = __atomic_load_n(value, __ATOMIC_RELAXED);
+
+	while (current == UNKNOWN || ((current & 3) == TB_WIN && (current >> 2) > plies)) {
+		if (__atomic_compare_exchange_n(value, &current, win_in(plies), true,
+		                                __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+			raise_deepest(g, plies);
+			return;
+		}
+	}
+}
+
+// a predecessor loses once every move leads to a settled win, that is one
+// won at most a ply after the current level
+static inline
+void check_loss(struct Generator *g, int t, struct Position pos, uint16_t *value) {
+	if (__atomic_load_n(value, __ATOMIC_RELAXED) != UNKNOWN)
+		return;
+
+	struct MoveList moves = generate_moves(pos);
+	unsigned worst = 0;
+
+	for (size_t i = 0; i < moves.length; i++) {
+		bool converted;
+		uint16_t child = child_value(g, t, make_move(pos, moves.moves[i]), &converted);
+		unsigned plies = child >> 2;
+
+		if ((child & 3) != TB_WIN || (!converted && plies > g->level + 1))
+			return;
+
+		if (plies > worst) worst = plies;
+	}
+
+	uint16_t expected = UNKNOWN;
+
+	if (__atomic_compare_exchange_n(value, &expected, loss_in(worst + 1), false,
+	                                __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+		raise_deepest(g, worst + 1);
+	}
+}
+
+// predecessors that keep the material: quiet moves, including double pushes
+static
+void update_predecessors(struct Generator *g, int t, struct Position pos, uint16_t result) {
+	const struct Table *table = g->tables[!t];
+	bitboard occ = occupied(pos);
+
+	// a double push leaves an en-passant file, which tables don't keep, as
+	// the other side has no pawn to take it
+	struct Position sources[9] = { pos };
+	size_t count = 1;
+
+	bitboard pushed = extract(pos, Pawn) & ~pos.white & 0x000000ff00000000;
+	pushed &= ~shift(S, occ) & ~shift(S, S, occ);
+
+	for (; pushed; pushed &= pushed - 1) {
+		bitboard info = pdep(1ULL << (lsb(pushed) & 7), ~occ);
+
+		sources[count] = pos;
+		sources[count].X |= info;
+		sources[count].Y |= info;
+		sources[count].Z |= info;
+		count++;
+	}
+
+	struct UnmoveList list;
+
+	for (size_t s = 0; s < count; s++) {
+		if (!generate_unmoves(sources[s], &list))
+			__atomic_store_n(&g->truncated, true, __ATOMIC_RELAXED);
+
+		for (size_t i = 0; i < list.length; i++) {
+			struct Position before = list.unmoves[i].pos;
+			struct Move move = list.unmoves[i].move;
+
+			if (popcount(occupied(before)) != popcount(occ)
+			 || get_piece(before, move.start) != move.piece
+			 || (extract_info(before) & (EP_MASK | CA_MASK)))
+				continue;
+
+			before = normalize(before);
+			uint16_t *value = &g->values[!t][position_index(table, before)];
+
+			if ((result & 3) == TB_LOSS)
+				set_win(g, value, g->level + 1);
+			else
+				check_loss(g, !t, before, value);
+		}
+	}
+}
+
+static
+void retro_position(struct Generator *g, int t, uint64_t index) {
+	uint16_t value = __atomic_load_n(&g->values[t][index], __ATOMIC_RELAXED);
+
+	if ((value >> 2) != g->level || ((value & 3) != TB_WIN && (value & 3) != TB_LOSS))
+		return;
+
+	struct Position pos;
+	tablebase_position(g->tables[t], index, &pos);
+
+	update_predecessors(g, t, pos, value);
+}
+
+struct Pass {
+	struct Generator *g;
+	int t;
+	void (*visit)(struct Generator *, int, uint64_t);
+	uint64_t next;
+};
+
+static
+void *run_pass(void *arg) {
+	struct Pass *pass = arg;
+	uint64_t size = pass->g->tables[pass->t]->size;
+
+	for (;;) {
+		uint64_t begin = __atomic_fetch_add(&pass->next, CHUNK, __ATOMIC_RELAXED);
+		if (begin >= size) break;
+
+		uint64_t end = (begin + CHUNK < size) ? begin + CHUNK : size;
+
+		for (uint64_t index = begin; index < end; index++) {
+			pass->visit(pass->g, pass->t, index);
+		}
+	}
+
+	return NULL;
+}
+
+static
+void parallel_pass(struct Generator *g, int t, void (*visit)(struct Generator *, int, uint64_t)) {
+	unsigned threads = g->tb->threads;
+	if (threads < 1) threads = 1;
+	if (threads > TB_MAX_THREADS) threads = TB_MAX_THREADS;
+
+	struct Pass pass = { g, t, visit, 0 };
+	pthread_t handles[TB_MAX_THREADS];
+
+	// the chunks are shared, so the threads that started do them all
+	unsigned started = 1;
+
+	while (started < threads && pthread_create(&handles[started], NULL, run_pass, &pass) == 0) {
+		started++;
+	}
+
+	run_pass(&pass);
+
+	for (unsigned i = 1; i < started; i++) {
+		pthread_join(handles[i], NULL);
+	}
+}
+
+static
+bool generate_tables(const struct Tablebases *tb, struct Table tables[2], FILE *info, FILE *stream) {
+	double start = wall_time();
+
+	// a symmetric signature is a single table
+	int count = (tables[0].material == tables[1].material) ? 1 : 2;
+	struct Generator g = { .tb = tb, .tables = { &tables[0], &tables[count - 1] } };
+
+	for (int t = 0; t < count; t++) {
+		g.values[t] = malloc(tables[t].size * sizeof *g.values[t]);
+		tables[t].wdl = calloc((tables[t].size + 3) / 4, 1);
+		tables[t].dtm = malloc(tables[t].size);
+
+		if (!g.values[t] || !tables[t].wdl || !tables[t].dtm) {
+			for (int i = 0; i <= t; i++) {
+				free(g.values[i]);
+				free(tables[i].wdl);
+				free(tables[i].dtm);
+			}
+
+			fprintf(stream, "failed to allocate %s\n", tables[0].name);
+			return false;
+		}
+	}
+
+	if (count == 1) g.values[1] = g.values[0];
+
+	for (int t = 0; t < count; t++) {
+		parallel_pass(&g, t, init_position);
+	}
+
+	for (g.level = 0; g.level <= g.deepest; g.level++) {
+		for (int t = 0; t < count; t++) {
+			parallel_pass(&g, t, retro_position);
+		}
+	}
+
+	// a missed predecessor would leave wrong values, so the tables are dropped
+	if (g.truncated) {
+		for (int t = 0; t < count; t++) {
+			free(g.values[t]);
+			free(tables[t].wdl);
+			free(tables[t].dtm);
+		}
+
+		fprintf(stream, "too many unmoves for %s\n", tables[0].name);
+		return false;
+	}
+
+	for (int t = 0; t < count; t++) {
+		uint64_t results[4] = {0};
+		unsigned longest = 0;
+
+		for (uint64_t i = 0; i < tables[t].size; i++) {
+			uint16_t value = g.values[t][i];
+			unsigned moves = ((value >> 2) + 1) / 2;
+
+			tables[t].wdl[i >> 2] |= (value & 3) << (2 * (i & 3));
+			tables[t].dtm[i] = ((value & 3) == TB_DRAW) ? 0 : moves;
+
+			results[value & 3]++;
+			if ((value & 3) == TB_WIN && moves > longest) longest = moves;
+		}
+
+		if (info) {
+			fprintf(info, "%s: %llu positions, %llu won, %llu drawn, %llu lost, longest mate in %u, %.3fs\n",
+			        tables[t].name, (unsigned long long)(tables[t].size - results[TB_BROKEN]),
+			        (unsigned long long)results[TB_WIN], (unsigned long long)results[TB_DRAW],
+			        (unsigned long long)results[TB_LOSS], longest, wall_time() - start);
+		}
+
+		free(g.values[t]);
+	}
+
+	if (count == 1) {
+		tables[1].wdl = NULL;
+		tables[1].dtm = NULL;
+	}
+
+	return true;
+}
+
+// files start with a magic, then the number of positions
+
+static const char WDL_MAGIC[8] = "uctbwdl1";
+static const char DTM_MAGIC[8] = "uctbdtm1";
+
+static
+bool write_file(const struct Tablebases *tb, const struct Table *table, const char *extension,
+                const char magic[8], const uint8_t *data, uint64_t bytes, FILE *stream) {
+	char path[4096];
+	snprintf(path, sizeof path, "%s/%s.%s", tb->directory, table->name, extension);
+
+	FILE *file = fopen(path, "wb");
+
+	if (!file) {
+		fprintf(stream, "failed to create %s\n", path);
+		return false;
+	}
+
+	bool ok = fwrite(magic, 8, 1, file) == 1
+	       && fwrite(&table->size, sizeof table->size, 1, file) == 1
+	       && fwrite(data, 1, bytes, file) == bytes;
+
+	ok &= fclose(file) == 0;
+	if (!ok) fprintf(stream, "failed to write %s\n", path);
+
+	return ok;
+}
+
+static
+uint8_t *read_file(const struct Tablebases *tb, const struct Table *table, const char *extension,
+                   const char magic[8], uint64_t bytes) {
+	char path[4096];
+	snprintf(path, sizeof path, "%s/%s.%s", tb->directory, table->name, extension);
+
+	FILE *file = fopen(path, "rb");
+	if (!file) return NULL;
+
+	char header[8];
+	uint64_t size;
+	uint8_t *data = malloc(bytes);
+
+	bool ok = data
+	       && fread(header, 8, 1, file) == 1 && memcmp(header, magic, 8) == 0
+	       && fread(&size, sizeof size, 1, file) == 1 && size == table->size
+	       && fread(data, 1, bytes, file) == bytes;
+
+	fclose(file);
+
+	if (!ok) {
+		free(data);
+		return NULL;
+	}
+
+	return data;
+}
+
+static
+bool read_table(const struct Tablebases *tb, struct Table *table) {
+	if (!tb->directory)
+		return false;
+
+	table->wdl = read_file(tb, table, "wdl", WDL_MAGIC, (table->size + 3) / 4);
+	table->dtm = read_file(tb, table, "dtm", DTM_MAGIC, table->size);
+
+	if (!table->wdl || !table->dtm) {
+		free(table->wdl);
+		free(table->dtm);
+		table->wdl = table->dtm = NULL;
+		return false;
+	}
+
+	return true;
+}
+
+static
+bool load_counts(struct Tablebases *tb, uint8_t counts[2][7], FILE *info, FILE *stream) {
+	uint8_t swapped[2][7];
+	memcpy(swapped[0], counts[1], 7);
+	memcpy(swapped[1], counts[0], 7);
+
+	struct Table tables[2];
+	init_table(&tables[0], counts);
+	init_table(&tables[1], swapped);
+
+	if (find_table(tb, tables[0].material))
+		return true;
+
+	// each capture and promotion, further conversions follow recursively
+	for (int theirs = 0; theirs < 2; theirs++) {
+		for (enum PieceType T = Pawn; T <= Queen; T++) {
+			if (!counts[theirs][T])
+				continue;
+
+			uint8_t converted[2][7];
+			memcpy(converted, counts, sizeof converted);
+			converted[theirs][T]--;
+
+			if (!load_counts(tb, converted, info, stream))
+				return false;
+
+			for (enum PieceType P = Knight; P <= Queen && T == Pawn; P++) {
+				converted[theirs][P]++;
+
+				if (!load_counts(tb, converted, info, stream))
+					return false;
+
+				converted[theirs][P]--;
+			}
+		}
+	}
+
+	int count = (tables[0].material == tables[1].material) ? 1 : 2;
+
+	if (!read_table(tb, &tables[0]) || (count == 2 && !read_table(tb, &tables[1]))) {
+		if (count == 2) {
+			free(tables[0].wdl);
+			free(tables[0].dtm);
+		}
+
+		if (!generate_tables(tb, tables, info, stream))
+			return false;
+
+		for (int t = 0; t < count && tb->directory; t++) {
+			uint64_t size = tables[t].size;
+
+			if (!write_file(tb, &tables[t], "wdl", WDL_MAGIC, tables[t].wdl, (size + 3) / 4, stream)
+			 || !write_file(tb, &tables[t], "dtm", DTM_MAGIC, tables[t].dtm, size, stream))
+				return false;
+		}
+	}
+
+	for (int t = 0; t < count; t++) {
+		add_table(tb, &tables[t]);
+	}
+
+	return true;
+}
+
+bool load_tablebase(struct Tablebases *tb, const char *signature, FILE *info, FILE *stream) {
+	uint8_t counts[2][7];
+	return parse_signature(signature, counts, stream) && load_counts(tb, counts, info, stream);
+}
+
+// orders results for the side to move, preferring quick wins and slow losses
+static inline
+int result_score(struct ProbeResult result) {
+	switch (result.wdl) {
+		case TB_WIN:  return  100000 - (int)result.dtm;
+		case TB_LOSS: return -100000 + (int)result.dtm;
+		default:      return 0;
+	}
+}
+
+bool probe_tablebase(const struct Tablebases *tb, struct Position pos, struct ProbeResult *result) {
+	bitboard info = extract_info(pos);
+
+	if (info & CA_MASK)
+		return false;
+
+	// tables assume no en passant, so search one ply when it is possible
+	if (info & EP_MASK) {
+		struct MoveList moves = generate_moves(pos);
+		bitboard occ = occupied(pos);
+		bool en_passant = false;
+
+		for (size_t i = 0; i < moves.length; i++) {
+			struct Move move = moves.moves[i];
+			en_passant |= move.piece == Pawn && (move.start & 7) != (move.end & 7) && !((occ >> move.end) & 1);
+		}
+
+		if (en_passant) {
+			struct ProbeResult best = { TB_LOSS, 0 };
+
+			for (size_t i = 0; i < moves.length; i++) {
+				struct ProbeResult child;
+
+				if (!probe_tablebase(tb, make_move(pos, moves.moves[i]), &child))
+					return false;
+
+				enum WDL wdl = (child.wdl == TB_WIN) ? TB_LOSS : (child.wdl == TB_LOSS) ? TB_WIN : TB_DRAW;
+				struct ProbeResult ours = { wdl, (wdl == TB_DRAW) ? 0 : child.dtm + 1 };
+
+				if (result_score(ours) > result_score(best))
+					best = ours;
+			}
+
+			*result = best;
+			return true;
+		}
+	}
+
+	pos = normalize(pos);
+
+	const struct Table *table = find_table(tb, material_key(pos));
+	if (!table) return false;
+
+	uint16_t value = table_value(table, position_index(table, pos));
+	if ((value & 3) == TB_BROKEN) return false;
+
+	*result = (struct ProbeResult){ value & 3, ((value & 3) == TB_DRAW) ? 0 : value >> 2 };
+	return true;
+}
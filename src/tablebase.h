@@ -0,0 +1,74 @@
+#ifndef TABLEBASE_H_
+#define TABLEBASE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "position.h"
+
+#define MAX_TB_PIECES 5
+#define MAX_TABLES 256
+#define TB_SLOT_BITS 10
+
+// Endgame tables of every position of a material signature with the side to
+// move first, e.g. "KRvK" (the side with the rook to move) and "KvKR".
+//
+// Positions are indexed by the pair of kings, reduced by the symmetries of
+// the board (8 without pawns, left-right with pawns), followed by the square
+// of every other piece. Indices that aren't canonical, overlap or leave the
+// side not to move in check are broken and never probed.
+//
+// Each table is stored as 2-bit win/draw/loss in a .wdl file and moves to
+// mate in a separate .dtm file. Positions with castling rights aren't
+// covered, en passant is resolved by the probe. Tables don't keep an
+// en-passant file, so signatures with pawns on both sides aren't supported.
+struct Table {
+	char name[2 * MAX_TB_PIECES + 2];
+	uint64_t material;
+
+	// non-king pieces, ours then theirs, each by descending piece type
+	uint8_t types[MAX_TB_PIECES - 2];
+	uint8_t theirs[MAX_TB_PIECES - 2];
+	size_t pieces;
+	bool pawns;
+
+	uint64_t size;
+	uint8_t *wdl; // 4 positions per byte
+	uint8_t *dtm; // moves to mate (or to be mated)
+};
+
+struct Tablebases {
+	struct Table tables[MAX_TABLES];
+	size_t count;
+
+	// open addressing by material key, table index + 1
+	uint16_t slots[1 << TB_SLOT_BITS];
+
+	const char *directory; // NULL to keep generated tables in memory only
+	unsigned threads;
+};
+
+enum WDL { TB_BROKEN, TB_LOSS, TB_DRAW, TB_WIN };
+
+struct ProbeResult {
+	enum WDL wdl; // for the side to move
+	unsigned dtm; // plies to mate for wins and losses, else 0
+};
+
+void init_tablebases(struct Tablebases *tb, const char *directory, unsigned threads);
+void free_tablebases(struct Tablebases *tb);
+
+// loads the tables of a signature (both sides to move) and every table it
+// converts to, generating and writing out the missing ones; writes progress
+// to `info` (may be NULL)
+bool load_tablebase(struct Tablebases *tb, const char *signature, FILE *info, FILE *stream);
+
+// false if no loaded table covers the position
+bool probe_tablebase(const struct Tablebases *tb, struct Position pos, struct ProbeResult *result);
+
+// position of a table index, false for broken indices
+bool tablebase_position(const struct Table *table, uint64_t index, struct Position *pos);
+
+#endif /*TABLEBASE_H_*/
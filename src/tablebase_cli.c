@@ -0,0 +1,125 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "bits.h"
+#include "position.h"
+#include "state.h"
+#include "tablebase.h"
+#include "text.h"
+#include "timer.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { DEFAULT_PROBES = 10000000, BENCH_POSITIONS = 1 << 16, MAX_LINE = 4096 };
+
+static
+void probe(const struct Tablebases *tb, const char *fen) {
+	bool ok;
+	struct State state = parse_fen(fen, &ok, stderr);
+	if (!ok) return;
+
+	struct ProbeResult result;
+
+	if (!probe_tablebase(tb, state.pos, &result))
+		printf("%s; unknown\n", fen);
+	else if (result.wdl == TB_WIN)
+		printf("%s; win, mate in %u\n", fen, (result.dtm + 1) / 2);
+	else if (result.wdl == TB_LOSS)
+		printf("%s; loss, mated in %u\n", fen, result.dtm / 2);
+	else
+		printf("%s; draw\n", fen);
+}
+
+// probes random positions of every loaded table
+static
+void bench(const struct Tablebases *tb, uint64_t probes) {
+	static struct Position positions[BENCH_POSITIONS];
+	uint64_t seed = 0x9e3779b97f4a7c15;
+
+	for (size_t i = 0; i < BENCH_POSITIONS;) {
+		seed ^= seed >> 12, seed ^= seed << 25, seed ^= seed >> 27;
+		uint64_t random = seed * 0x2545f4914f6cdd1d;
+
+		const struct Table *table = &tb->tables[random % tb->count];
+
+		if (tablebase_position(table, (random >> 16) % table->size, &positions[i]))
+			i++;
+	}
+
+	uint64_t found = 0;
+	double start = wall_time();
+
+	for (uint64_t i = 0; i < probes; i++) {
+		struct ProbeResult result;
+		found += probe_tablebase(tb, positions[i % BENCH_POSITIONS], &result);
+	}
+
+	double seconds = wall_time() - start;
+
+	printf("tables\t| probes\t| found\t\t| ms\t\t| probes/s\n");
+	printf("%zu\t| %llu\t| %llu\t| %-10.3f\t| %.0f\n", tb->count, (unsigned long long)probes,
+	       (unsigned long long)found, seconds * 1e3, probes / seconds);
+}
+
+int main(int argc, char **argv) {
+	init_bitbase();
+
+	if (argc < 4) {
+		fprintf(stderr, "usage: uchess-tb generate <directory> <threads> <signature>...\n"
+		                "       uchess-tb probe <directory> <signature> [fen | -]\n"
+		                "       uchess-tb bench <directory> <signature> [probes]\n");
+		return 1;
+	}
+
+	struct Tablebases *tb = malloc(sizeof *tb);
+
+	if (!tb) {
+		fprintf(stderr, "failed to allocate tablebases\n");
+		return 1;
+	}
+
+	bool generate = strcmp(argv[1], "generate") == 0, ok = true;
+	init_tablebases(tb, argv[2], generate ? atoi(argv[3]) : 1);
+
+	// uchess-tb generate <directory> <threads> <signature>...
+	if (generate) {
+		for (int i = 4; i < argc && ok; i++) {
+			double start = wall_time();
+			ok = load_tablebase(tb, argv[i], stdout, stderr);
+
+			if (ok) printf("%s done in %.3fs\n", argv[i], wall_time() - start);
+		}
+	}
+
+	else if (!load_tablebase(tb, argv[3], stdout, stderr)) {
+		ok = false;
+	}
+
+	// uchess-tb probe <directory> <signature> [fen | -], reading one fen per
+	// line from stdin for -
+	else if (strcmp(argv[1], "probe") == 0) {
+		if (argc > 4 && strcmp(argv[4], "-") != 0) {
+			probe(tb, argv[4]);
+		}
+
+		else {
+			static char line[MAX_LINE];
+
+			while (fgets(line, sizeof line, stdin)) {
+				line[strcspn(line, "\r\n")] = '\0';
+				if (line[0]) probe(tb, line);
+			}
+		}
+	}
+
+	// uchess-tb bench <directory> <signature> [probes]
+	else if (strcmp(argv[1], "bench") == 0) {
+		bench(tb, (argc > 4) ? strtoull(argv[4], NULL, 10) : DEFAULT_PROBES);
+	}
+
+	free_tablebases(tb);
+	free(tb);
+	return !ok;
+}
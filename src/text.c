@@ -18,6 +18,15 @@
 #define PRINTF(fmt, args)
 #endif
 
+const char *const perft_positions[PERFT_POSITIONS] = {
+	STARTPOS,
+	"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -",
+	"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -",
+	"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+	"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+	"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+};
+
 #define RED	"\033[31;1m"
 #define RESET	"\033[0m"
 
@@ -122,6 +131,17 @@ enum PieceType get_square(struct Position pos, int sq) {
 	return T;
 }
 
+// converts a square relative to the side to move into a board square
+static inline
+int relative_board_square(struct State state, int sq) {
+	return board_square(state, relative_square(state.side_to_move, sq));
+}
+
+static inline
+unsigned board_rank(struct State state, unsigned rank) {
+	return board_square(state, 8*rank) >> 3;
+}
+
 struct State parse_fen(const char *fen, bool *ok, FILE *stream) {
 	struct Parser parser = {
 		.in = fen,
@@ -225,10 +245,12 @@ struct State parse_fen(const char *fen, bool *ok, FILE *stream) {
 		}
 	}
 
+#ifndef ABSOLUTE_COLORS
 	if (state.side_to_move == BLACK) {
 		// swap castling sides
 		info = ((info << 2) | (info >> 2)) & CA_MASK;
 	}
+#endif
 
 	if (chop_next(&parser) != ' ') {
 		log_error(&parser, "expected space before en-passant square");
@@ -294,6 +316,11 @@ struct State parse_fen(const char *fen, bool *ok, FILE *stream) {
 		goto error;
 	}
 
+#ifdef ABSOLUTE_COLORS
+	if (state.side_to_move == BLACK) {
+		info |= STM_MASK;
+	}
+#else
 	// rotate boards if necessary
 	if (state.side_to_move == BLACK) {
 		white = rotate(white);
@@ -304,6 +331,7 @@ struct State parse_fen(const char *fen, bool *ok, FILE *stream) {
 		pos.Y = rotate(pos.Y);
 		pos.Z = rotate(pos.Z);
 	}
+#endif
 
 	// write info bits
 	bitboard occ = white | black;
@@ -358,6 +386,9 @@ struct Move parse_san(const char *san, struct State state, bool *ok, FILE *strea
 		else {
 			move.end = G1;
 		}
+
+		move.start = relative_board_square(state, move.start);
+		move.end = relative_board_square(state, move.end);
 	}
 
 	// pawn move
@@ -430,7 +461,7 @@ struct Move parse_san(const char *san, struct State state, bool *ok, FILE *strea
 			// check if double move
 			bitboard occ = occupied(state.pos);
 
-			if (rank == 3 && (~occ >> move.start) & 1) {
+			if (rank == 3 && (~occ >> relative_board_square(state, move.start)) & 1) {
 				move.start += S;
 			}
 		}
@@ -459,6 +490,9 @@ struct Move parse_san(const char *san, struct State state, bool *ok, FILE *strea
 
 			move.piece = piece;
 		}
+
+		move.start = relative_board_square(state, move.start);
+		move.end = relative_board_square(state, move.end);
 	}
 
 	// piece move
@@ -478,9 +512,7 @@ struct Move parse_san(const char *san, struct State state, bool *ok, FILE *strea
 
 		// rank specifier
 		if ('1' <= peek_next(&parser) && peek_next(&parser) <= '8') {
-			unsigned rank = chop_next(&parser) - '1';
-			if (state.side_to_move == BLACK) rank ^= 7;
-
+			unsigned rank = board_rank(state, chop_next(&parser) - '1');
 			mask &= RANK1 << (8 * rank);
 
 			if (peek_next(&parser) == 'x') {
@@ -508,14 +540,13 @@ struct Move parse_san(const char *san, struct State state, bool *ok, FILE *strea
 		}
 
 		unsigned rank = chop_next(&parser) - '1';
-		if (state.side_to_move == BLACK) rank ^= 7;
 
 		if (rank >= 8) {
 			log_error(&parser, "invalid rank");
 			goto error;
 		}
 
-		move.end = 8*rank + file;
+		move.end = board_square(state, 8*rank + file);
 
 		// file and rank specifier (very rare)
 		if (('a' <= peek_next(&parser) && peek_next(&parser) <= 'h') || peek_next(&parser) == 'x') {
@@ -533,18 +564,14 @@ struct Move parse_san(const char *san, struct State state, bool *ok, FILE *strea
 				log_error(&parser, "invalid rank");
 			}
 
-			if (state.side_to_move == BLACK) {
-				rank ^= 7;
-			}
-
-			move.end = 8*rank + file;
+			move.end = board_square(state, 8*rank + file);
 		}
 
 		// TODO: handle pins (extreme pain)
 		else {
 			bitboard occ = occupied(state.pos);
 			bitboard possible = generic_attacks(move.piece, move.end, occ);
-			possible &= pieces & mask & state.pos.white;
+			possible &= pieces & mask & side(state.pos, turn(state.pos));
 
 			if (!possible) {
 				log_error(&parser, "no pieces match the specified destination square");
@@ -599,9 +626,8 @@ struct Move parse_uci(const char *uci, struct State state, bool *ok, FILE *strea
 	move.end = 8*end_rank + end_file;
 
 	// rotate board for black
-	if (state.side_to_move == BLACK) {
-		move.start ^= 56, move.end ^= 56;
-	}
+	move.start = board_square(state, move.start);
+	move.end = board_square(state, move.end);
 
 	// promotion
 	if (peek_next(&parser)) {
@@ -613,14 +639,15 @@ struct Move parse_uci(const char *uci, struct State state, bool *ok, FILE *strea
 	}
 
 	else {
-		get_square(state.pos, move.start);
+		move.piece = get_square(state.pos, move.start);
 	}
 
 	enum { C1 = 2, E1 = 4, G1 = 6 };
+	enum Color c = turn(state.pos);
 
 	// set castling flag (if needed)
-	if (move.piece == King && move.start == E1) {
-		if (move.end == C1 || move.end == G1) {
+	if (move.piece == King && move.start == relative_square(c, E1)) {
+		if (move.end == relative_square(c, C1) || move.end == relative_square(c, G1)) {
 			move.castling = true;
 		}
 	}
@@ -681,15 +708,11 @@ size_t generate_fen(struct State state, char *buffer) {
 	size_t count = 0;
 
 	bitboard occ = occupied(state.pos);
-	bitboard white, black;
-
-	if (state.side_to_move == WHITE) {
-		white = state.pos.white;
-		black = occ & ~white;
-	} else {
-		black = state.pos.white;
-		white = occ & ~black;
-	}
+#ifdef ABSOLUTE_COLORS
+	bitboard black = side(state.pos, BLACK);
+#else
+	bitboard black = side(state.pos, state.side_to_move == WHITE ? BLACK : WHITE);
+#endif
 
 	bitboard info = extract(state.pos, Info);
 	info = pext(info, ~occ);
@@ -702,7 +725,7 @@ size_t generate_fen(struct State state, char *buffer) {
 			int square = 8*rank + file;
 
 			// flip square if reversed
-			if (state.side_to_move == BLACK) square ^= 56;
+			square = board_square(state, square);
 
 			enum PieceType piece = get_square(state.pos, square);
 			bitboard mask = 1ULL << square;
@@ -747,10 +770,12 @@ size_t generate_fen(struct State state, char *buffer) {
 	else {
 		bitboard castling = info & CA_MASK;
 
+#ifndef ABSOLUTE_COLORS
 		if (state.side_to_move == BLACK) {
 			// flip castling rights
 			castling = ((castling << 2) | (castling >> 2)) & CA_MASK;
 		}
+#endif
 
 		if (castling & WK_MASK) write_char(&buffer, &count, 'K');
 		if (castling & WQ_MASK) write_char(&buffer, &count, 'Q');
@@ -799,25 +824,23 @@ size_t generate_san(struct Move move, struct State state, char *buffer, bool che
 
 	else {
 		enum PieceType piece = get_square(state.pos, move.start);
-		bool capture = get_square(state.pos, move.end) != None;
+		bool capture = (occupied(state.pos) >> move.end) & 1;
 
 		// flip squares
-		if (state.side_to_move == BLACK) {
-			move.start ^= 56;
-			move.end ^= 56;
-		}
+		int start = board_square(state, move.start);
+		int end = board_square(state, move.end);
 
 		if (piece == Pawn) {
 			// capture
-			if ((move.start & 7) != (move.end & 7)) {
-				char file = move.start & 7;
+			if ((start & 7) != (end & 7)) {
+				char file = start & 7;
 
 				write_char(&buffer, &count, file + 'a');
 				write_char(&buffer, &count, 'x');
 			}
 
-			char file = move.end & 7;
-			char rank = move.end >> 3;
+			char file = end & 7;
+			char rank = end >> 3;
 
 			write_char(&buffer, &count, file + 'a');
 			write_char(&buffer, &count, rank + '1');
@@ -838,24 +861,25 @@ size_t generate_san(struct Move move, struct State state, char *buffer, bool che
 			bitboard occ = occupied(state.pos);
 
 			bitboard possible = generic_attacks(piece, move.end, occ);
-			possible &= pieces & state.pos.white;
+			possible &= pieces & side(state.pos, turn(state.pos));
 
 			// more than two possible pieces
 			if (more_than_one(possible)) {
-				int file = move.start & 7;
-				int rank = move.start >> 3;
+				int file = start & 7;
+				int rank = start >> 3;
 
-				bitboard file_mask = AFILE << file;
-				bitboard rank_mask = RANK1 << rank;
+				bitboard file_mask = AFILE << (move.start & 7);
+				bitboard rank_mask = RANK1 << (move.start & 56);
 
-				// check if differentiators needed
-				// note: some moves need both rank and file differentiators
+				// the file if it tells the pieces apart, else the rank, else both
+				bool same_file = more_than_one(possible & file_mask);
+				bool same_rank = more_than_one(possible & rank_mask);
 
-				if (more_than_one(possible & rank_mask)) {
+				if (!same_file || same_rank) {
 					write_char(&buffer, &count, file + 'a');
 				}
 
-				if (more_than_one(possible & file_mask)) {
+				if (same_file) {
 					write_char(&buffer, &count, rank + '1');
 				}
 			}
@@ -864,8 +888,8 @@ size_t generate_san(struct Move move, struct State state, char *buffer, bool che
 				write_char(&buffer, &count, 'x');
 			}
 
-			int file = move.end & 7;
-			int rank = move.end >> 3;
+			int file = end & 7;
+			int rank = end >> 3;
 
 			write_char(&buffer, &count, file + 'a');
 			write_char(&buffer, &count, rank + '1');
@@ -897,10 +921,8 @@ size_t generate_uci(struct Move move, struct State state, char *buffer) {
 	bool promotion = get_square(state.pos, move.start) == Pawn
 	              && move.piece != Pawn;
 
-	if (state.side_to_move == BLACK) {
-		move.start ^= 56;
-		move.end ^= 56;
-	}
+	move.start = board_square(state, move.start);
+	move.end = board_square(state, move.end);
 
 	write_char(&buffer, &count, (move.start & 7)  + 'a');
 	write_char(&buffer, &count, (move.start >> 3) + '1');
@@ -12,6 +12,13 @@
 struct State parse_fen(const char *fen, bool *ok, FILE *stream);
 size_t generate_fen(struct State state, char *buffer);
 
+#define STARTPOS "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+// the six perft positions of the chess programming wiki, starting with
+// STARTPOS, used by the tools' benchmarks
+enum { PERFT_POSITIONS = 6 };
+extern const char *const perft_positions[PERFT_POSITIONS];
+
 // standard algebraic notation and uci notation
 
 struct Move parse_san(const char *san, struct State, bool *ok, FILE *stream);
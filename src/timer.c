@@ -0,0 +1,11 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "timer.h"
+
+#include <time.h>
+
+double wall_time() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
@@ -0,0 +1,7 @@
+#ifndef TIMER_H_
+#define TIMER_H_
+
+// seconds on the monotonic clock, for timing searches and benchmarks
+double wall_time();
+
+#endif //TIMER_H_
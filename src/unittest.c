@@ -2,10 +2,15 @@
 #include <stdio.h>
 #include <time.h>
 
+#include "attackmap.h"
 #include "bits.h"
+#include "history.h"
 #include "movegen.h"
+#include "movetext.h"
 #include "position.h"
+#include "retro.h"
 #include "text.h"
+#include "timer.h"
 
 // Unit Tests:
 // https://www.chessprogramming.org/Perft_Results
@@ -56,6 +61,494 @@ size_t perft(struct Position pos, size_t depth) {
 	return total;
 }
 
+// census of the specialised move generators, sampled from the perft trees
+enum { CENSUS_SAMPLES = 4096, CENSUS_REPEATS = 256 };
+
+static const char *variant_names[MOVEGEN_VARIANTS] = {
+	[DOUBLE_CHECK_MOVES]         = "double check",
+	[SINGLE_CHECK_MOVES]         = "single check",
+	[SINGLE_CHECK_EP_MOVES]      = "single check, ep",
+	[NO_CHECK_MOVES]             = "no check",
+	[NO_CHECK_CASTLING_MOVES]    = "no check, castling",
+	[NO_CHECK_EP_MOVES]          = "no check, ep",
+	[NO_CHECK_EP_CASTLING_MOVES] = "no check, ep, castling",
+};
+
+static size_t census_calls[MOVEGEN_VARIANTS];
+static size_t census_length[MOVEGEN_VARIANTS];
+static struct Position census_samples[MOVEGEN_VARIANTS][CENSUS_SAMPLES];
+
+static
+void census(struct Position pos, size_t depth) {
+	enum MovegenVariant variant = movegen_variant(pos);
+	census_calls[variant]++;
+
+	if (census_length[variant] < CENSUS_SAMPLES) {
+		census_samples[variant][census_length[variant]++] = pos;
+	}
+
+	if (depth <= 1) return;
+
+	struct MoveList list = generate_moves(pos);
+
+	for (size_t i = 0; i < list.length; i++) {
+		census(make_move(pos, list.moves[i]), depth - 1);
+	}
+}
+
+// time per call of a generator over the samples of one variant, and the
+// number of moves it found
+static
+double time_census(struct MoveList (*generate)(struct Position), int variant, size_t *moves) {
+	size_t length = census_length[variant];
+	size_t found = 0;
+
+	clock_t start = clock();
+
+	for (int r = 0; r < CENSUS_REPEATS; r++) {
+		for (size_t j = 0; j < length; j++) {
+			found += generate(census_samples[variant][j]).length;
+		}
+	}
+
+	clock_t end = clock();
+	*moves = found;
+
+	double seconds = (double)(end - start) / CLOCKS_PER_SEC;
+	return length ? 1e9 * seconds / (length * CENSUS_REPEATS) : 0;
+}
+
+// compares each variant against the generic generator on the same samples
+static
+void print_census() {
+	size_t total = 0;
+
+	for (int i = 0; i < MOVEGEN_VARIANTS; i++) {
+		total += census_calls[i];
+	}
+
+	printf("\n%-24s| %-8s| %-12s| %-12s| %s\n", "variant", "share", "ns/call", "generic", "gain");
+
+	for (int i = 0; i < MOVEGEN_VARIANTS; i++) {
+		size_t moves, generic_moves;
+
+		double ns = time_census(generate_moves, i, &moves);
+		double generic_ns = time_census(generate_generic_moves, i, &generic_moves);
+
+		assert(moves == generic_moves);
+
+		double share = 100.0 * census_calls[i] / total;
+		double gain = ns ? 100.0 * (generic_ns / ns - 1) : 0;
+
+		printf("%-24s| %5.2f%%  | %-12.1f| %-12.1f| %+.1f%%%s\n", variant_names[i], share, ns, generic_ns, gain,
+		       (moves == generic_moves) ? "" : " MISMATCH");
+	}
+}
+
+// compares attack_info against the attacks of each piece taken one at a time
+static
+size_t attack_info_walk(struct Position pos, size_t depth) {
+	struct AttackInfo info, expected;
+	bitboard occ = occupied(pos);
+
+	// cleared so the padding compares equal
+	memset(&info, 0, sizeof info);
+	memset(&expected, 0, sizeof expected);
+	attack_info(pos, &info);
+
+	for (square sq = 0; sq < 64; sq++) {
+		enum PieceType T = get_piece(pos, sq);
+		if (T == None || T == Info) continue;
+
+		enum Color c = ((pos.white >> sq) & 1) ? WHITE : BLACK;
+		bitboard attacks = (T == Pawn) ? pawn_attacks(c, 1ULL << sq) : generic_attacks(T, sq, occ);
+
+		expected.twice[c] |= expected.by_type[c][None] & attacks;
+		expected.by_type[c][None] |= attacks;
+		expected.by_type[c][T] |= attacks;
+		expected.mobility[c][T] += popcount(attacks & ~side(pos, c));
+	}
+
+	size_t errors = memcmp(&info, &expected, sizeof info) != 0;
+	if (depth == 0) return errors;
+
+	struct MoveList list = generate_moves(pos);
+
+	for (size_t i = 0; i < list.length; i++) {
+		errors += attack_info_walk(make_move(pos, list.moves[i]), depth - 1);
+	}
+
+	return errors;
+}
+
+// evaluation attack info over the sampled positions
+static
+void bench_attack_info() {
+	struct AttackInfo info;
+	volatile unsigned sink = 0;
+	size_t positions = 0;
+
+	clock_t start = clock();
+
+	for (int r = 0; r < CENSUS_REPEATS; r++) {
+		for (int i = 0; i < MOVEGEN_VARIANTS; i++) {
+			for (size_t j = 0; j < census_length[i]; j++) {
+				attack_info(census_samples[i][j], &info);
+				sink += info.mobility[WHITE][Queen] + popcount(info.twice[BLACK]);
+				positions++;
+			}
+		}
+	}
+
+	clock_t end = clock();
+
+	double seconds = (double)(end - start) / CLOCKS_PER_SEC;
+	printf("\nattack info\t| %zu\t| %.3f Mpos/s\n", positions, positions / seconds / 1e6);
+}
+
+// compares generate_checks against the legal moves that give check
+static
+size_t check_walk(struct Position pos, size_t depth) {
+	struct MoveList list = generate_moves(pos);
+	struct MoveList checks = generate_checks(pos);
+	size_t expected = 0, errors = 0;
+
+	for (size_t i = 0; i < list.length; i++) {
+		expected += enemy_checks(make_move(pos, list.moves[i])) != 0;
+	}
+
+	for (size_t i = 0; i < checks.length; i++) {
+		struct Move check = checks.moves[i];
+		bool legal = false;
+
+		for (size_t j = 0; j < list.length; j++) {
+			struct Move move = list.moves[j];
+			legal |= move.start == check.start && move.end == check.end && move.piece == check.piece;
+		}
+
+		errors += !legal || !enemy_checks(make_move(pos, check));
+	}
+
+	errors += checks.length != expected;
+	if (depth == 0) return errors;
+
+	for (size_t i = 0; i < list.length; i++) {
+		errors += check_walk(make_move(pos, list.moves[i]), depth - 1);
+	}
+
+	return errors;
+}
+
+static
+struct Position without_en_passant(struct Position pos) {
+	bitboard occ = occupied(pos);
+	bitboard info = pdep(extract_info(pos) & ~EP_MASK, ~occ);
+
+	return (struct Position){ pos.white, (pos.X & occ) | info, (pos.Y & occ) | info, (pos.Z & occ) | info };
+}
+
+static inline
+bool same_move(struct Move a, struct Move b) {
+	return a.start == b.start && a.end == b.end && a.piece == b.piece && a.castling == b.castling;
+}
+
+// at most 16 pieces and 8 pawns a side
+static inline
+bool legal_material(struct Position pos) {
+	for (enum Color c = WHITE; c <= BLACK; c++) {
+		if (popcount(side(pos, c)) > 16 || popcount(extract(pos, Pawn) & side(pos, c)) > 8)
+			return false;
+	}
+
+	return true;
+}
+
+// un-promotions by a side with 8 pawns would give it a ninth
+static
+void test_unpromotions() {
+	static const struct {
+		const char *fen;
+		bool unpromotions;
+	} cases[] = {
+		{ "Q3k3/8/8/8/8/8/PPPPPPPP/4K3 b - - 0 1", false },
+		{ "Q3k3/8/8/8/8/8/1PPPPPPP/4K3 b - - 0 1", true },
+	};
+
+	size_t errors = 0;
+
+	for (size_t i = 0; i < sizeof cases / sizeof cases[0]; i++) {
+		bool ok;
+		struct State state = parse_fen(cases[i].fen, &ok, stderr);
+		struct UnmoveList list;
+		bool found = false;
+
+		errors += !generate_unmoves(state.pos, &list);
+
+		for (size_t j = 0; j < list.length; j++) {
+			struct Unmove unmove = list.unmoves[j];
+
+			found |= unmove.move.piece == Queen && get_piece(unmove.pos, unmove.move.start) == Pawn;
+			errors += !legal_material(unmove.pos);
+		}
+
+		errors += found != cases[i].unpromotions;
+	}
+
+	assert(errors == 0);
+	printf("unpromotions %s\n", errors ? "MISMATCH" : "ok");
+}
+
+// checks that every unmove is a legal move back to the position, and that
+// every move of the tree (except castling) is found as an unmove of its child
+static
+size_t unmove_walk(struct Position pos, size_t depth, size_t *unmoves) {
+	struct UnmoveList list;
+	size_t errors = !generate_unmoves(pos, &list);
+
+	*unmoves += list.length;
+
+	for (size_t i = 0; i < list.length; i++) {
+		struct Unmove unmove = list.unmoves[i];
+		struct MoveList moves = generate_moves(unmove.pos);
+		bool legal = false;
+
+		for (size_t j = 0; j < moves.length; j++) {
+			legal |= same_move(moves.moves[j], unmove.move);
+		}
+
+		errors += !legal || !same_position(make_move(unmove.pos, unmove.move), pos);
+		errors += !legal_material(unmove.pos);
+	}
+
+	if (depth == 0) return errors;
+
+	struct MoveList moves = generate_moves(pos);
+
+	for (size_t i = 0; i < moves.length; i++) {
+		struct Move move = moves.moves[i];
+		struct Position child = make_move(pos, move);
+
+		if (!move.castling) {
+			// predecessors only keep en-passant files needed by the move
+			bool en_passant = get_piece(pos, move.start) == Pawn && (move.start & 7) != (move.end & 7)
+			               && !((occupied(pos) >> move.end) & 1);
+
+			struct Position expected = en_passant ? pos : without_en_passant(pos);
+			struct UnmoveList back;
+			bool found = false;
+
+			errors += !generate_unmoves(child, &back);
+
+			for (size_t j = 0; j < back.length; j++) {
+				found |= same_move(back.unmoves[j].move, move) && same_position(back.unmoves[j].pos, expected);
+			}
+
+			errors += !found;
+		}
+
+		errors += unmove_walk(child, depth - 1, unmoves);
+	}
+
+	return errors;
+}
+
+// perft using move sets, counting leaf moves without writing them out
+static
+size_t perft_move_sets(struct Position pos, size_t depth) {
+	if (depth == 0) return 1;
+
+	struct MoveSet set = generate_move_set(pos);
+	if (depth == 1) return count_moves(&set);
+
+	size_t total = 0;
+	struct Move move;
+
+	while (pop_move(&set, &move)) {
+		total += perft_move_sets(make_move(pos, move), depth - 1);
+	}
+
+	return total;
+}
+
+// walks the tree making every move on a copy of the state, as a baseline
+static
+size_t state_walk(struct State state, size_t depth) {
+	if (depth == 0) return 1;
+
+	struct MoveList list = generate_moves(state.pos);
+	size_t total = 0;
+
+	for (size_t i = 0; i < list.length; i++) {
+		total += state_walk(play_move(state, list.moves[i]), depth - 1);
+	}
+
+	return total;
+}
+
+// the same walk through the game history, looking for repetitions and the
+// fifty-move rule at every node
+static
+size_t history_walk(struct History *history, size_t depth, size_t *repeated) {
+	*repeated += repetitions(history) + is_fifty_move_draw(history);
+	if (depth == 0) return 1;
+
+	struct MoveList list = generate_moves(current_state(history).pos);
+	size_t total = 0;
+
+	for (size_t i = 0; i < list.length; i++) {
+		history_make_move(history, list.moves[i]);
+		total += history_walk(history, depth - 1, repeated);
+		history_unmake_move(history);
+	}
+
+	return total;
+}
+
+// checks the incremental keys, and that every legal reversible move back to
+// an earlier position is found by the cuckoo table
+static
+size_t upcoming_walk(struct History *history, size_t depth, size_t *upcoming) {
+	struct MoveList list = generate_moves(current_state(history).pos);
+	size_t errors = history->keys[history->ply & (HISTORY_PLIES - 1)] != zobrist_key(current_state(history));
+	bool found = false;
+
+	for (size_t i = 0; i < list.length; i++) {
+		history_make_move(history, list.moves[i]);
+		found |= current_state(history).fify_move_clock != 0 && repetitions(history) != 0;
+		history_unmake_move(history);
+	}
+
+	*upcoming += found;
+	errors += found && !has_upcoming_repetition(history);
+	if (depth == 0) return errors;
+
+	for (size_t i = 0; i < list.length; i++) {
+		history_make_move(history, list.moves[i]);
+		errors += upcoming_walk(history, depth - 1, upcoming);
+		history_unmake_move(history);
+	}
+
+	return errors;
+}
+
+enum { QUERY_REPEATS = 64 };
+
+// times the upcoming repetition queries alone at every node of the walk,
+// repeated so reading the clock is a small part of each measurement
+static
+void query_walk(struct History *history, size_t depth, double *seconds, size_t *calls) {
+	size_t found = 0;
+	double start = wall_time();
+
+	for (int i = 0; i < QUERY_REPEATS; i++) {
+		__asm__ volatile ("" ::: "memory"); // keeps the calls from being merged
+		found += has_upcoming_repetition(history);
+	}
+
+	*seconds += wall_time() - start;
+	*calls += QUERY_REPEATS;
+	assert(found % QUERY_REPEATS == 0);
+
+	if (depth == 0) return;
+
+	struct MoveList list = generate_moves(current_state(history).pos);
+
+	for (size_t i = 0; i < list.length; i++) {
+		history_make_move(history, list.moves[i]);
+		query_walk(history, depth - 1, seconds, calls);
+		history_unmake_move(history);
+	}
+}
+
+static
+void test_history_walk(struct UnitTest test, struct State state) {
+	static struct History history;
+	size_t depth = test.depth - 2, repeated = 0, upcoming = 0, queries = 0;
+	double query_seconds = 0;
+
+	init_history(&history, state);
+
+	size_t errors = upcoming_walk(&history, test.depth - 3, &upcoming);
+	assert(errors == 0);
+
+	clock_t start = clock();
+	size_t nodes = state_walk(state, depth);
+	clock_t mid = clock();
+	size_t result = history_walk(&history, depth, &repeated);
+	clock_t end = clock();
+	query_walk(&history, depth - 1, &query_seconds, &queries);
+
+	assert(result == nodes && history.ply == 0);
+
+	double copy_mnps = nodes / ((double)(mid - start) / CLOCKS_PER_SEC) / 1e6;
+	double history_mnps = nodes / ((double)(end - mid) / CLOCKS_PER_SEC) / 1e6;
+	double query_ns = 1e9 * query_seconds / queries;
+
+	printf("%s\t| history %s\t| copy %.3f Mnps\t| history %.3f Mnps\t| %zu repetitions\n", test.name,
+	       result == nodes ? "ok" : "MISMATCH", copy_mnps, history_mnps, repeated);
+
+	printf("%s\t| upcoming %s\t| %.1f ns/query\t| %zu nodes with one\n", test.name,
+	       errors ? "MISMATCH" : "ok", query_ns, upcoming);
+}
+
+static
+void play_uci(struct History *history, const char *moves) {
+	char uci[8];
+	int length;
+
+	while (sscanf(moves, "%7s%n", uci, &length) == 1) {
+		bool ok;
+		struct Move move = parse_uci(uci, current_state(history), &ok, stderr);
+		assert(ok);
+
+		history_make_move(history, move);
+		moves += length;
+	}
+}
+
+// knights shuffling back and forth, then the clocks around a pawn move
+static
+void test_repetitions() {
+	static struct History history;
+	bool ok, passed = true;
+
+	init_history(&history, parse_fen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", &ok, stderr));
+
+	play_uci(&history, "g1f3 g8f6");
+	passed &= !has_upcoming_repetition(&history);
+
+	play_uci(&history, "f3g1");
+	passed &= has_upcoming_repetition(&history);
+
+	play_uci(&history, "f6g8");
+	passed &= repetitions(&history) == 1 && !is_repetition_draw(&history);
+
+	play_uci(&history, "g1f3 g8f6 f3g1");
+	passed &= repetitions(&history) == 1;
+
+	play_uci(&history, "f6g8");
+	passed &= repetitions(&history) == 2 && is_repetition_draw(&history);
+
+	history_unmake_move(&history);
+	passed &= !is_repetition_draw(&history) && current_state(&history).fify_move_clock == 7;
+
+	play_uci(&history, "e7e5");
+	struct State state = current_state(&history);
+	passed &= state.fify_move_clock == 0 && state.movenumber == 5 && state.side_to_move == WHITE;
+
+	// checkmate on the hundredth reversible ply is not a draw
+	init_history(&history, parse_fen("7k/5Q2/6K1/8/8/8/8/8 w - - 99 80", &ok, stderr));
+	play_uci(&history, "f7g7");
+	passed &= !is_fifty_move_draw(&history);
+
+	history_unmake_move(&history);
+	play_uci(&history, "f7e7");
+	passed &= is_fifty_move_draw(&history);
+
+	assert(passed);
+	printf("\nrepetitions %s\n", passed ? "ok" : "MISMATCH");
+}
+
 static
 void run_test(struct UnitTest test) {
 	// test reading fen
@@ -81,14 +574,54 @@ void run_test(struct UnitTest test) {
 	double mnps = (result / seconds) / 1e6;
 
 	printf("%s\t| %zu\t| %.3f Mnps\n", test.name, result, mnps);
+
+	// test move sets
+	start = clock();
+	result = perft_move_sets(state.pos, test.depth);
+	end = clock();
+
+	assert(result == test.result);
+
+	seconds = (double)(end - start) / CLOCKS_PER_SEC;
+	mnps = (result / seconds) / 1e6;
+
+	printf("%s\t| move sets %s\t| %.3f Mnps\n", test.name,
+	       result == test.result ? "ok" : "MISMATCH", mnps);
+
+	// sample positions for the per-variant timings
+	census(state.pos, test.depth - 1);
+
+	size_t errors = attack_info_walk(state.pos, test.depth - 2);
+	assert(errors == 0);
+
+	printf("%s\t| attack info %s\n", test.name, errors ? "MISMATCH" : "ok");
+
+	errors = check_walk(state.pos, test.depth - 2);
+	assert(errors == 0);
+
+	printf("%s\t| checks %s\n", test.name, errors ? "MISMATCH" : "ok");
+
+	size_t unmoves = 0;
+	errors = unmove_walk(state.pos, test.depth - 3, &unmoves);
+	assert(errors == 0);
+
+	printf("%s\t| unmoves %s\t| %zu predecessors\n", test.name, errors ? "MISMATCH" : "ok", unmoves);
+
+	test_history_walk(test, state);
 }
 
 int main() {
 	init_bitbase();
+	init_zobrist();
 
 	int count = sizeof tests / sizeof tests[0];
 
 	for (int i = 0; i < count; i++) {
 		run_test(tests[i]);
 	}
+
+	print_census();
+	bench_attack_info();
+	test_repetitions();
+	test_unpromotions();
 }
@@ -21,6 +21,9 @@ enum PositionInfo {
 	WQ_MASK = 0x200,
 	BK_MASK = 0x400,
 	BQ_MASK = 0x800,
+#ifdef ABSOLUTE_COLORS
+	STM_MASK = 0x1000, // set when black is to move
+#endif
 };
 
 struct Position {